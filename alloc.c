@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <stdint.h>
 #include <stdbool.h>
 
 #define CHECK_RETURN(pre, op)\
@@ -11,19 +12,103 @@
     assert(res && #op);\
     return res
 
+static void *default_allocate(void *context, size_t size)
+{
+    return malloc(size);
+}
+
+static void *default_reallocate(void *context, void *ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void default_deallocate(void *context, void *ptr)
+{
+    free(ptr);
+}
+
+static const Allocator DEFAULT_ALLOCATOR = { default_allocate, default_reallocate, default_deallocate, NULL };
+
+static LU_THREAD_LOCAL Allocator current = { default_allocate, default_reallocate, default_deallocate, NULL };
+
+Allocator alloc_set_allocator(const Allocator *allocator)
+{
+    Allocator previous = current;
+
+    if (allocator)
+    {
+        assert(allocator->allocate && allocator->reallocate && allocator->deallocate);
+        current = *allocator;
+    }
+    else
+    {
+        current = DEFAULT_ALLOCATOR;
+    }
+    return previous;
+}
+
+Allocator alloc_get_allocator(void)
+{
+    return current;
+}
+
+static void *zeroed(const Allocator *allocator, size_t nmemb, size_t size)
+{
+    if (allocator->allocate == default_allocate)
+    {
+        return calloc(nmemb, size);
+    }
+
+    if (size > SIZE_MAX / nmemb)
+    {
+        return NULL;
+    }
+    void *ptr = allocator->allocate(allocator->context, nmemb * size);
+    if (ptr)
+    {
+        memset(ptr, 0, nmemb * size);
+    }
+    return ptr;
+}
+
+void *alloc_calloc(const Allocator *allocator, size_t nmemb, size_t size)
+{
+    CHECK_RETURN(nmemb > 0 && size > 0, zeroed(allocator, nmemb, size));
+}
+
+void *alloc_malloc(const Allocator *allocator, size_t size)
+{
+    CHECK_RETURN(size > 0, allocator->allocate(allocator->context, size));
+}
+
+void *alloc_realloc(const Allocator *allocator, void *ptr, size_t size)
+{
+    CHECK_RETURN(size > 0, allocator->reallocate(allocator->context, ptr, size));
+}
+
+void alloc_free(const Allocator *allocator, void *ptr)
+{
+    allocator->deallocate(allocator->context, ptr);
+}
+
 void *xcalloc(size_t nmemb, size_t size)
 {
-    CHECK_RETURN(nmemb > 0 && size > 0, calloc(nmemb, size));
+    return alloc_calloc(&current, nmemb, size);
 }
 
 void *xmalloc(size_t size)
 {
-    CHECK_RETURN(size > 0, malloc(size));
+    return alloc_malloc(&current, size);
 }
 
 void *xrealloc(void *ptr, size_t size)
 {
-    CHECK_RETURN(size > 0, realloc(ptr, size));
+    return alloc_realloc(&current, ptr, size);
+}
+
+void xfree(void *ptr)
+{
+    alloc_free(&current, ptr);
 }
 
 void *xmemdup(const void *ptr, size_t size)
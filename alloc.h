@@ -4,9 +4,49 @@
 #include <stddef.h>
 #include <stdarg.h>
 
+// C99 has no thread-local storage, so take the C11 keyword or the GNU one
+#if defined(__cplusplus) && __cplusplus >= 201103L
+#define LU_THREAD_LOCAL thread_local
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define LU_THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__)
+#define LU_THREAD_LOCAL __thread
+#else
+#error "libutils needs thread-local storage: C11 or GNU C"
+#endif
+
+/**
+ * Backing allocator for every x*() call. reallocate() must accept a NULL ptr,
+ * and deallocate() a NULL ptr, just like realloc() and free().
+ */
+typedef struct
+{
+    void *(*allocate)(void *context, size_t size);
+    void *(*reallocate)(void *context, void *ptr, size_t size);
+    void (*deallocate)(void *context, void *ptr);
+    void *context;
+} Allocator;
+
+/**
+ * Installs allocator for the calling thread, or restores malloc/free if NULL,
+ * and returns the one it replaces. Containers keep the allocator current
+ * when they are created and release their own memory through it, but blocks
+ * from the x*() calls below must still be freed on a thread and in a scope
+ * using the same allocator.
+ */
+Allocator alloc_set_allocator(const Allocator *allocator);
+Allocator alloc_get_allocator(void);
+
+// Go through allocator rather than the calling thread's one
+void *alloc_calloc(const Allocator *allocator, size_t nmemb, size_t size);
+void *alloc_malloc(const Allocator *allocator, size_t size);
+void *alloc_realloc(const Allocator *allocator, void *ptr, size_t size);
+void alloc_free(const Allocator *allocator, void *ptr);
+
 void *xcalloc(size_t nmemb, size_t size);
 void *xmalloc(size_t size);
 void *xrealloc(void *ptr, size_t size);
+void xfree(void *ptr);
 
 void *xmemdup(const void *ptr, size_t size);
 void *xmemcpy(void *dst, const void *src, size_t size);
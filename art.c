@@ -0,0 +1,1000 @@
+#include "art.h"
+
+#include "alloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define MAX_PREFIX 10
+
+// children are either inner nodes or leaves tagged in the low bit
+#define IS_LEAF(p) (((uintptr_t)(p)) & 1)
+#define TAG_LEAF(l) ((void *)(((uintptr_t)(l)) | 1))
+#define UNTAG_LEAF(p) ((Leaf *)(((uintptr_t)(p)) & ~(uintptr_t)1))
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+typedef enum
+{
+    NODE4,
+    NODE16,
+    NODE48,
+    NODE256
+} NodeType;
+
+typedef struct
+{
+    void *value;
+    size_t key_size;
+    unsigned char key[];
+} Leaf;
+
+/*
+ * Common header of the inner nodes. The compressed path is stored up to
+ * MAX_PREFIX bytes; longer prefixes are checked against a leaf below. The
+ * leaf of a key ending exactly at this node, if any, sits in leaf.
+ */
+typedef struct
+{
+    NodeType type;
+    unsigned int num_children;
+    size_t prefix_len;
+    unsigned char prefix[MAX_PREFIX];
+    Leaf *leaf;
+} Node;
+
+typedef struct
+{
+    Node n;
+    unsigned char keys[4];
+    void *children[4];
+} Node4;
+
+typedef struct
+{
+    Node n;
+    unsigned char keys[16];
+    void *children[16];
+} Node16;
+
+// index holds the child slot + 1 for each byte, 0 when absent
+typedef struct
+{
+    Node n;
+    unsigned char index[256];
+    void *children[48];
+} Node48;
+
+typedef struct
+{
+    Node n;
+    void *children[256];
+} Node256;
+
+struct _ARTree
+{
+    void *(*value_copy)(const void *value);
+    void (*value_destroy)(void *value);
+
+    void *root;
+    size_t size;
+    Allocator allocator;
+};
+
+struct _ARTreeIterator
+{
+    const ARTree *tree;
+    void **stack;
+    size_t length;
+    size_t capacity;
+};
+
+static void noop_destroy(void *a)
+{
+    return;
+}
+
+static void *noop_copy(const void *a)
+{
+    return (void *)a;
+}
+
+ARTree *art_new(void *(*value_copy)(const void *value),
+                void (*value_destroy)(void *value))
+{
+    Allocator allocator = alloc_get_allocator();
+    ARTree *tree = alloc_malloc(&allocator, sizeof(ARTree));
+    tree->allocator = allocator;
+
+    tree->value_copy = value_copy ? value_copy : noop_copy;
+    tree->value_destroy = value_destroy ? value_destroy : noop_destroy;
+    tree->root = NULL;
+    tree->size = 0;
+
+    return tree;
+}
+
+static Leaf *leaf_new(ARTree *tree, const unsigned char *key, size_t key_size, const void *value)
+{
+    Leaf *leaf = alloc_malloc(&tree->allocator, sizeof(Leaf) + key_size + 1);
+
+    leaf->value = tree->value_copy(value);
+    leaf->key_size = key_size;
+    if (key_size > 0)
+    {
+        memcpy(leaf->key, key, key_size);
+    }
+
+    return leaf;
+}
+
+static void leaf_destroy(ARTree *tree, Leaf *leaf)
+{
+    tree->value_destroy(leaf->value);
+    alloc_free(&tree->allocator, leaf);
+}
+
+static bool leaf_matches(const Leaf *leaf, const unsigned char *key, size_t key_size)
+{
+    return leaf->key_size == key_size && memcmp(leaf->key, key, key_size) == 0;
+}
+
+static Node *node_new(ARTree *tree, NodeType type)
+{
+    static const size_t sizes[] = { sizeof(Node4), sizeof(Node16), sizeof(Node48), sizeof(Node256) };
+
+    Node *node = alloc_calloc(&tree->allocator, 1, sizes[type]);
+    node->type = type;
+
+    return node;
+}
+
+static void node_copy_header(Node *dst, const Node *src)
+{
+    dst->num_children = src->num_children;
+    dst->prefix_len = src->prefix_len;
+    memcpy(dst->prefix, src->prefix, MIN(src->prefix_len, MAX_PREFIX));
+    dst->leaf = src->leaf;
+}
+
+static void tree_destroy(ARTree *tree, void *n)
+{
+    if (!n)
+    {
+        return;
+    }
+
+    if (IS_LEAF(n))
+    {
+        leaf_destroy(tree, UNTAG_LEAF(n));
+        return;
+    }
+
+    Node *node = n;
+    switch (node->type)
+    {
+    case NODE4:
+        for (unsigned int i = 0; i < node->num_children; i++)
+        {
+            tree_destroy(tree, ((Node4 *)node)->children[i]);
+        }
+        break;
+    case NODE16:
+        for (unsigned int i = 0; i < node->num_children; i++)
+        {
+            tree_destroy(tree, ((Node16 *)node)->children[i]);
+        }
+        break;
+    case NODE48:
+        for (int i = 0; i < 48; i++)
+        {
+            tree_destroy(tree, ((Node48 *)node)->children[i]);
+        }
+        break;
+    case NODE256:
+        for (int i = 0; i < 256; i++)
+        {
+            tree_destroy(tree, ((Node256 *)node)->children[i]);
+        }
+        break;
+    }
+
+    if (node->leaf)
+    {
+        leaf_destroy(tree, node->leaf);
+    }
+    alloc_free(&tree->allocator, node);
+}
+
+void art_destroy(void *_tree)
+{
+    ARTree *tree = _tree;
+    if (tree)
+    {
+        tree_destroy(tree, tree->root);
+        alloc_free(&tree->allocator, tree);
+    }
+}
+
+size_t art_size(const ARTree *tree)
+{
+    return tree->size;
+}
+
+void art_key_u64(uint64_t value, unsigned char key[ART_KEY_U64_SIZE])
+{
+    for (int i = ART_KEY_U64_SIZE - 1; i >= 0; i--)
+    {
+        key[i] = value & 0xff;
+        value >>= 8;
+    }
+}
+
+static int node16_position(const Node16 *node, unsigned char byte)
+{
+#if defined(__SSE2__)
+    __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char)byte),
+                                 _mm_loadu_si128((const __m128i *)node->keys));
+    int mask = _mm_movemask_epi8(cmp) & ((1 << node->n.num_children) - 1);
+    return mask ? __builtin_ctz(mask) : -1;
+#else
+    for (unsigned int i = 0; i < node->n.num_children; i++)
+    {
+        if (node->keys[i] == byte)
+        {
+            return i;
+        }
+    }
+    return -1;
+#endif
+}
+
+static void **find_child(Node *node, unsigned char byte)
+{
+    switch (node->type)
+    {
+    case NODE4:
+    {
+        Node4 *n = (Node4 *)node;
+        for (unsigned int i = 0; i < node->num_children; i++)
+        {
+            if (n->keys[i] == byte)
+            {
+                return &n->children[i];
+            }
+        }
+        return NULL;
+    }
+    case NODE16:
+    {
+        Node16 *n = (Node16 *)node;
+        int i = node16_position(n, byte);
+        return i >= 0 ? &n->children[i] : NULL;
+    }
+    case NODE48:
+    {
+        Node48 *n = (Node48 *)node;
+        return n->index[byte] ? &n->children[n->index[byte] - 1] : NULL;
+    }
+    case NODE256:
+    {
+        Node256 *n = (Node256 *)node;
+        return n->children[byte] ? &n->children[byte] : NULL;
+    }
+    }
+
+    return NULL;
+}
+
+// leftmost leaf under n, which has the smallest key
+static Leaf *minimum(const void *n)
+{
+    while (!IS_LEAF(n))
+    {
+        const Node *node = n;
+        if (node->leaf)
+        {
+            return node->leaf;
+        }
+
+        switch (node->type)
+        {
+        case NODE4:
+            n = ((const Node4 *)node)->children[0];
+            break;
+        case NODE16:
+            n = ((const Node16 *)node)->children[0];
+            break;
+        case NODE48:
+        {
+            const Node48 *n48 = (const Node48 *)node;
+            int i = 0;
+            while (!n48->index[i])
+            {
+                i++;
+            }
+            n = n48->children[n48->index[i] - 1];
+            break;
+        }
+        case NODE256:
+        {
+            const Node256 *n256 = (const Node256 *)node;
+            int i = 0;
+            while (!n256->children[i])
+            {
+                i++;
+            }
+            n = n256->children[i];
+            break;
+        }
+        }
+    }
+
+    return UNTAG_LEAF(n);
+}
+
+// number of stored prefix bytes matching key at depth, optimistic past MAX_PREFIX
+static size_t check_prefix(const Node *node, const unsigned char *key, size_t key_size, size_t depth)
+{
+    size_t max = MIN(MIN(node->prefix_len, MAX_PREFIX), key_size - depth);
+    size_t i;
+
+    for (i = 0; i < max; i++)
+    {
+        if (node->prefix[i] != key[depth + i])
+        {
+            break;
+        }
+    }
+
+    return i;
+}
+
+// exact length of the match between the node's prefix and key at depth
+static size_t prefix_mismatch(const Node *node, const unsigned char *key, size_t key_size, size_t depth)
+{
+    size_t i = check_prefix(node, key, key_size, depth);
+
+    if (i == MAX_PREFIX && node->prefix_len > MAX_PREFIX)
+    {
+        const Leaf *leaf = minimum(node);
+        size_t max = MIN(MIN(leaf->key_size, key_size) - depth, node->prefix_len);
+        for (; i < max; i++)
+        {
+            if (leaf->key[depth + i] != key[depth + i])
+            {
+                break;
+            }
+        }
+    }
+
+    return i;
+}
+
+void *art_get(const ARTree *tree, const void *_key, size_t key_size)
+{
+    const unsigned char *key = _key;
+    void *n = tree->root;
+    size_t depth = 0;
+
+    while (n)
+    {
+        if (IS_LEAF(n))
+        {
+            Leaf *leaf = UNTAG_LEAF(n);
+            return leaf_matches(leaf, key, key_size) ? leaf->value : NULL;
+        }
+
+        Node *node = n;
+        if (node->prefix_len > 0)
+        {
+            if (depth + node->prefix_len > key_size
+                || check_prefix(node, key, key_size, depth) != MIN(node->prefix_len, MAX_PREFIX))
+            {
+                return NULL;
+            }
+
+            // bytes past MAX_PREFIX are verified against the leaf
+            depth += node->prefix_len;
+        }
+
+        if (depth == key_size)
+        {
+            return (node->leaf && leaf_matches(node->leaf, key, key_size)) ? node->leaf->value : NULL;
+        }
+
+        void **child = find_child(node, key[depth]);
+        n = child ? *child : NULL;
+        depth++;
+    }
+
+    return NULL;
+}
+
+static void add_child(ARTree *tree, void **ref, Node *node, unsigned char byte, void *child);
+
+static void add_child4(ARTree *tree, void **ref, Node4 *node, unsigned char byte, void *child)
+{
+    if (node->n.num_children < 4)
+    {
+        unsigned int i;
+        for (i = 0; i < node->n.num_children && node->keys[i] < byte; i++);
+
+        memmove(node->keys + i + 1, node->keys + i, node->n.num_children - i);
+        memmove(node->children + i + 1, node->children + i, sizeof(void *) * (node->n.num_children - i));
+        node->keys[i] = byte;
+        node->children[i] = child;
+        node->n.num_children++;
+        return;
+    }
+
+    Node16 *grown = (Node16 *)node_new(tree, NODE16);
+    node_copy_header(&grown->n, &node->n);
+    memcpy(grown->keys, node->keys, 4);
+    memcpy(grown->children, node->children, sizeof(void *) * 4);
+    *ref = &grown->n;
+    alloc_free(&tree->allocator, node);
+
+    add_child(tree, ref, &grown->n, byte, child);
+}
+
+static void add_child16(ARTree *tree, void **ref, Node16 *node, unsigned char byte, void *child)
+{
+    if (node->n.num_children < 16)
+    {
+        unsigned int i;
+        for (i = 0; i < node->n.num_children && node->keys[i] < byte; i++);
+
+        memmove(node->keys + i + 1, node->keys + i, node->n.num_children - i);
+        memmove(node->children + i + 1, node->children + i, sizeof(void *) * (node->n.num_children - i));
+        node->keys[i] = byte;
+        node->children[i] = child;
+        node->n.num_children++;
+        return;
+    }
+
+    Node48 *grown = (Node48 *)node_new(tree, NODE48);
+    node_copy_header(&grown->n, &node->n);
+    for (int i = 0; i < 16; i++)
+    {
+        grown->children[i] = node->children[i];
+        grown->index[node->keys[i]] = i + 1;
+    }
+    *ref = &grown->n;
+    alloc_free(&tree->allocator, node);
+
+    add_child(tree, ref, &grown->n, byte, child);
+}
+
+static void add_child48(ARTree *tree, void **ref, Node48 *node, unsigned char byte, void *child)
+{
+    if (node->n.num_children < 48)
+    {
+        int slot = 0;
+        while (node->children[slot])
+        {
+            slot++;
+        }
+
+        node->children[slot] = child;
+        node->index[byte] = slot + 1;
+        node->n.num_children++;
+        return;
+    }
+
+    Node256 *grown = (Node256 *)node_new(tree, NODE256);
+    node_copy_header(&grown->n, &node->n);
+    for (int i = 0; i < 256; i++)
+    {
+        if (node->index[i])
+        {
+            grown->children[i] = node->children[node->index[i] - 1];
+        }
+    }
+    *ref = &grown->n;
+    alloc_free(&tree->allocator, node);
+
+    add_child(tree, ref, &grown->n, byte, child);
+}
+
+static void add_child(ARTree *tree, void **ref, Node *node, unsigned char byte, void *child)
+{
+    switch (node->type)
+    {
+    case NODE4:
+        add_child4(tree, ref, (Node4 *)node, byte, child);
+        break;
+    case NODE16:
+        add_child16(tree, ref, (Node16 *)node, byte, child);
+        break;
+    case NODE48:
+        add_child48(tree, ref, (Node48 *)node, byte, child);
+        break;
+    case NODE256:
+    {
+        Node256 *n = (Node256 *)node;
+        n->children[byte] = child;
+        node->num_children++;
+        break;
+    }
+    }
+}
+
+// hangs leaf below node, whose path ends at depth
+static void attach_leaf(ARTree *tree, void **ref, Node *node, Leaf *leaf, size_t depth)
+{
+    if (leaf->key_size == depth)
+    {
+        assert(!node->leaf);
+        node->leaf = leaf;
+    }
+    else
+    {
+        add_child(tree, ref, node, leaf->key[depth], TAG_LEAF(leaf));
+    }
+}
+
+static bool insert_recursive(ARTree *tree, void **ref, const unsigned char *key, size_t key_size,
+                             size_t depth, const void *value)
+{
+    void *n = *ref;
+
+    if (!n)
+    {
+        *ref = TAG_LEAF(leaf_new(tree, key, key_size, value));
+        return false;
+    }
+
+    if (IS_LEAF(n))
+    {
+        Leaf *leaf = UNTAG_LEAF(n);
+        if (leaf_matches(leaf, key, key_size))
+        {
+            tree->value_destroy(leaf->value);
+            leaf->value = tree->value_copy(value);
+            return true;
+        }
+
+        // lazy expansion: split the leaf only now that the keys diverge
+        size_t max = MIN(leaf->key_size, key_size);
+        size_t lcp = depth;
+        while (lcp < max && leaf->key[lcp] == key[lcp])
+        {
+            lcp++;
+        }
+
+        Node *node = node_new(tree, NODE4);
+        node->prefix_len = lcp - depth;
+        memcpy(node->prefix, key + depth, MIN(node->prefix_len, MAX_PREFIX));
+
+        *ref = node;
+        attach_leaf(tree, ref, node, leaf, lcp);
+        attach_leaf(tree, ref, node, leaf_new(tree, key, key_size, value), lcp);
+        return false;
+    }
+
+    Node *node = n;
+    if (node->prefix_len > 0)
+    {
+        size_t mismatch = prefix_mismatch(node, key, key_size, depth);
+        if (mismatch < node->prefix_len)
+        {
+            Node *parent = node_new(tree, NODE4);
+            parent->prefix_len = mismatch;
+            memcpy(parent->prefix, node->prefix, MIN(mismatch, MAX_PREFIX));
+
+            unsigned char byte;
+            if (node->prefix_len <= MAX_PREFIX)
+            {
+                byte = node->prefix[mismatch];
+                node->prefix_len -= mismatch + 1;
+                memmove(node->prefix, node->prefix + mismatch + 1, node->prefix_len);
+            }
+            else
+            {
+                const Leaf *min = minimum(node);
+                byte = min->key[depth + mismatch];
+                node->prefix_len -= mismatch + 1;
+                memcpy(node->prefix, min->key + depth + mismatch + 1, MIN(node->prefix_len, MAX_PREFIX));
+            }
+
+            *ref = parent;
+            add_child(tree, ref, parent, byte, node);
+            attach_leaf(tree, ref, *ref, leaf_new(tree, key, key_size, value), depth + mismatch);
+            return false;
+        }
+
+        depth += node->prefix_len;
+    }
+
+    if (depth == key_size)
+    {
+        if (node->leaf)
+        {
+            tree->value_destroy(node->leaf->value);
+            node->leaf->value = tree->value_copy(value);
+            return true;
+        }
+
+        node->leaf = leaf_new(tree, key, key_size, value);
+        return false;
+    }
+
+    void **child = find_child(node, key[depth]);
+    if (child)
+    {
+        return insert_recursive(tree, child, key, key_size, depth + 1, value);
+    }
+
+    add_child(tree, ref, node, key[depth], TAG_LEAF(leaf_new(tree, key, key_size, value)));
+    return false;
+}
+
+bool art_put(ARTree *tree, const void *key, size_t key_size, const void *value)
+{
+    bool replaced = insert_recursive(tree, &tree->root, key, key_size, 0, value);
+    if (!replaced)
+    {
+        tree->size++;
+    }
+
+    return replaced;
+}
+
+static void remove_child(Node *node, unsigned char byte, void **slot)
+{
+    switch (node->type)
+    {
+    case NODE4:
+    {
+        Node4 *n = (Node4 *)node;
+        size_t i = slot - n->children;
+        memmove(n->keys + i, n->keys + i + 1, node->num_children - i - 1);
+        memmove(n->children + i, n->children + i + 1, sizeof(void *) * (node->num_children - i - 1));
+        break;
+    }
+    case NODE16:
+    {
+        Node16 *n = (Node16 *)node;
+        size_t i = slot - n->children;
+        memmove(n->keys + i, n->keys + i + 1, node->num_children - i - 1);
+        memmove(n->children + i, n->children + i + 1, sizeof(void *) * (node->num_children - i - 1));
+        break;
+    }
+    case NODE48:
+    {
+        Node48 *n = (Node48 *)node;
+        n->children[n->index[byte] - 1] = NULL;
+        n->index[byte] = 0;
+        break;
+    }
+    case NODE256:
+        ((Node256 *)node)->children[byte] = NULL;
+        break;
+    }
+
+    node->num_children--;
+}
+
+// replaces node with a smaller one, or collapses it, once it has emptied out
+static void shrink(ARTree *tree, void **ref, Node *node)
+{
+    switch (node->type)
+    {
+    case NODE4:
+    {
+        Node4 *n = (Node4 *)node;
+        if (node->num_children == 0)
+        {
+            *ref = node->leaf ? TAG_LEAF(node->leaf) : NULL;
+            alloc_free(&tree->allocator, node);
+        }
+        else if (node->num_children == 1 && !node->leaf)
+        {
+            void *child = n->children[0];
+            if (!IS_LEAF(child))
+            {
+                // concatenate the prefixes into the child
+                Node *c = child;
+                unsigned char prefix[MAX_PREFIX];
+                size_t len = MIN(node->prefix_len, MAX_PREFIX);
+                memcpy(prefix, node->prefix, len);
+                if (len < MAX_PREFIX)
+                {
+                    prefix[len++] = n->keys[0];
+                }
+                if (len < MAX_PREFIX)
+                {
+                    size_t extra = MIN(MIN(c->prefix_len, MAX_PREFIX), MAX_PREFIX - len);
+                    memcpy(prefix + len, c->prefix, extra);
+                    len += extra;
+                }
+
+                c->prefix_len += node->prefix_len + 1;
+                memcpy(c->prefix, prefix, MIN(c->prefix_len, MAX_PREFIX));
+            }
+
+            *ref = child;
+            alloc_free(&tree->allocator, node);
+        }
+        break;
+    }
+    case NODE16:
+        if (node->num_children <= 3)
+        {
+            Node16 *n = (Node16 *)node;
+            Node4 *shrunk = (Node4 *)node_new(tree, NODE4);
+            node_copy_header(&shrunk->n, node);
+            memcpy(shrunk->keys, n->keys, node->num_children);
+            memcpy(shrunk->children, n->children, sizeof(void *) * node->num_children);
+            *ref = shrunk;
+            alloc_free(&tree->allocator, node);
+        }
+        break;
+    case NODE48:
+        if (node->num_children <= 12)
+        {
+            Node48 *n = (Node48 *)node;
+            Node16 *shrunk = (Node16 *)node_new(tree, NODE16);
+            node_copy_header(&shrunk->n, node);
+            unsigned int j = 0;
+            for (int i = 0; i < 256; i++)
+            {
+                if (n->index[i])
+                {
+                    shrunk->keys[j] = i;
+                    shrunk->children[j] = n->children[n->index[i] - 1];
+                    j++;
+                }
+            }
+            *ref = shrunk;
+            alloc_free(&tree->allocator, node);
+        }
+        break;
+    case NODE256:
+        if (node->num_children <= 37)
+        {
+            Node256 *n = (Node256 *)node;
+            Node48 *shrunk = (Node48 *)node_new(tree, NODE48);
+            node_copy_header(&shrunk->n, node);
+            int j = 0;
+            for (int i = 0; i < 256; i++)
+            {
+                if (n->children[i])
+                {
+                    shrunk->children[j] = n->children[i];
+                    shrunk->index[i] = ++j;
+                }
+            }
+            *ref = shrunk;
+            alloc_free(&tree->allocator, node);
+        }
+        break;
+    }
+}
+
+static bool remove_recursive(ARTree *tree, void **ref, const unsigned char *key, size_t key_size, size_t depth)
+{
+    void *n = *ref;
+
+    if (!n)
+    {
+        return false;
+    }
+
+    if (IS_LEAF(n))
+    {
+        Leaf *leaf = UNTAG_LEAF(n);
+        if (!leaf_matches(leaf, key, key_size))
+        {
+            return false;
+        }
+
+        leaf_destroy(tree, leaf);
+        *ref = NULL;
+        return true;
+    }
+
+    Node *node = n;
+    if (node->prefix_len > 0)
+    {
+        if (depth + node->prefix_len > key_size
+            || check_prefix(node, key, key_size, depth) != MIN(node->prefix_len, MAX_PREFIX))
+        {
+            return false;
+        }
+        depth += node->prefix_len;
+    }
+
+    if (depth == key_size)
+    {
+        if (!node->leaf || !leaf_matches(node->leaf, key, key_size))
+        {
+            return false;
+        }
+
+        leaf_destroy(tree, node->leaf);
+        node->leaf = NULL;
+        shrink(tree, ref, node);
+        return true;
+    }
+
+    void **child = find_child(node, key[depth]);
+    if (!child || !remove_recursive(tree, child, key, key_size, depth + 1))
+    {
+        return false;
+    }
+
+    if (!*child)
+    {
+        remove_child(node, key[depth], child);
+        shrink(tree, ref, node);
+    }
+
+    return true;
+}
+
+bool art_remove(ARTree *tree, const void *key, size_t key_size)
+{
+    if (remove_recursive(tree, &tree->root, key, key_size, 0))
+    {
+        tree->size--;
+        return true;
+    }
+
+    return false;
+}
+
+static void iterator_push(ARTreeIterator *iter, void *n)
+{
+    if (iter->length == iter->capacity)
+    {
+        iter->capacity = iter->capacity ? iter->capacity * 2 : 64;
+        iter->stack = alloc_realloc(&iter->tree->allocator, iter->stack, sizeof(void *) * iter->capacity);
+    }
+
+    iter->stack[iter->length++] = n;
+}
+
+ARTreeIterator *art_iterator_new(const ARTree *tree)
+{
+    return art_iterator_new_prefix(tree, NULL, 0);
+}
+
+ARTreeIterator *art_iterator_new_prefix(const ARTree *tree, const void *_prefix, size_t prefix_size)
+{
+    const unsigned char *prefix = _prefix;
+    ARTreeIterator *iter = alloc_calloc(&tree->allocator, 1, sizeof(ARTreeIterator));
+    iter->tree = tree;
+
+    void *n = tree->root;
+    size_t depth = 0;
+
+    while (n)
+    {
+        if (IS_LEAF(n))
+        {
+            const Leaf *leaf = UNTAG_LEAF(n);
+            if (leaf->key_size >= prefix_size && memcmp(leaf->key, prefix, prefix_size) == 0)
+            {
+                iterator_push(iter, n);
+            }
+            break;
+        }
+
+        Node *node = n;
+        if (node->prefix_len > 0)
+        {
+            size_t mismatch = prefix_mismatch(node, prefix, prefix_size, depth);
+            if (depth + mismatch == prefix_size)
+            {
+                iterator_push(iter, n);
+                break;
+            }
+            if (mismatch < node->prefix_len)
+            {
+                break;
+            }
+            depth += node->prefix_len;
+        }
+
+        if (depth == prefix_size)
+        {
+            iterator_push(iter, n);
+            break;
+        }
+
+        void **child = find_child(node, prefix[depth]);
+        n = child ? *child : NULL;
+        depth++;
+    }
+
+    return iter;
+}
+
+bool art_iterator_next(ARTreeIterator *iter, const void **key, size_t *key_size, void **value)
+{
+    while (iter->length > 0)
+    {
+        void *n = iter->stack[--iter->length];
+
+        if (IS_LEAF(n))
+        {
+            const Leaf *leaf = UNTAG_LEAF(n);
+            if (key)
+            {
+                *key = leaf->key;
+            }
+            if (key_size)
+            {
+                *key_size = leaf->key_size;
+            }
+            if (value)
+            {
+                *value = leaf->value;
+            }
+            return true;
+        }
+
+        // push children largest first, then the node's own leaf on top
+        Node *node = n;
+        switch (node->type)
+        {
+        case NODE4:
+            for (unsigned int i = node->num_children; i > 0; i--)
+            {
+                iterator_push(iter, ((Node4 *)node)->children[i - 1]);
+            }
+            break;
+        case NODE16:
+            for (unsigned int i = node->num_children; i > 0; i--)
+            {
+                iterator_push(iter, ((Node16 *)node)->children[i - 1]);
+            }
+            break;
+        case NODE48:
+        {
+            Node48 *n48 = (Node48 *)node;
+            for (int i = 255; i >= 0; i--)
+            {
+                if (n48->index[i])
+                {
+                    iterator_push(iter, n48->children[n48->index[i] - 1]);
+                }
+            }
+            break;
+        }
+        case NODE256:
+            for (int i = 255; i >= 0; i--)
+            {
+                if (((Node256 *)node)->children[i])
+                {
+                    iterator_push(iter, ((Node256 *)node)->children[i]);
+                }
+            }
+            break;
+        }
+
+        if (node->leaf)
+        {
+            iterator_push(iter, TAG_LEAF(node->leaf));
+        }
+    }
+
+    return false;
+}
+
+void art_iterator_destroy(void *_iter)
+{
+    ARTreeIterator *iter = _iter;
+    if (iter)
+    {
+        alloc_free(&iter->tree->allocator, iter->stack);
+        alloc_free(&iter->tree->allocator, iter);
+    }
+}
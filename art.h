@@ -0,0 +1,36 @@
+#ifndef LIBUTILS_ART_H
+#define LIBUTILS_ART_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Adaptive radix tree over byte-string keys, ordered bytewise with a key
+ * sorting before its extensions. Lookups cost O(key length) rather than
+ * O(log n) comparisons. Integer keys should be stored big-endian, see
+ * art_key_u64, to keep numeric order.
+ */
+
+typedef struct _ARTree ARTree;
+typedef struct _ARTreeIterator ARTreeIterator;
+
+#define ART_KEY_U64_SIZE 8
+
+ARTree *art_new(void *(*value_copy)(const void *value),
+                void (*value_destroy)(void *value));
+void art_destroy(void *tree);
+
+bool art_put(ARTree *tree, const void *key, size_t key_size, const void *value);
+void *art_get(const ARTree *tree, const void *key, size_t key_size);
+bool art_remove(ARTree *tree, const void *key, size_t key_size);
+size_t art_size(const ARTree *tree);
+
+ARTreeIterator *art_iterator_new(const ARTree *tree);
+ARTreeIterator *art_iterator_new_prefix(const ARTree *tree, const void *prefix, size_t prefix_size);
+bool art_iterator_next(ARTreeIterator *iter, const void **key, size_t *key_size, void **value);
+void art_iterator_destroy(void *iter);
+
+void art_key_u64(uint64_t value, unsigned char key[ART_KEY_U64_SIZE]);
+
+#endif
@@ -0,0 +1,166 @@
+#include "bloom.h"
+
+#include "alloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define BLOCK_WORDS 8
+#define BLOCK_BITS (BLOCK_WORDS * 64)
+#define BLOCK_BYTES (BLOCK_WORDS * sizeof(uint64_t))
+#define MAX_HASHES 16
+
+struct Bloom_
+{
+    uint64_t *blocks;
+    // what was allocated, blocks is aligned to a cache line within it
+    void *memory;
+    size_t block_count;
+    unsigned int hashes;
+    Allocator allocator;
+};
+
+static uint64_t mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t bloom_hash_bytes(const void *data, size_t size)
+{
+    const unsigned char *p = data;
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        h = (h ^ p[i]) * 0x100000001b3ULL;
+    }
+
+    return mix(h);
+}
+
+// log2(x) for x >= 1, to a tenth of a bit, without libm
+static double approx_log2(double x)
+{
+    double n = 0;
+    while (x >= 2)
+    {
+        x /= 2;
+        n++;
+    }
+    return n + (x - 1);
+}
+
+Bloom *bloom_new(size_t expected, double false_positive_rate)
+{
+    assert(false_positive_rate > 0 && false_positive_rate < 1);
+
+    // the optimum for a classic filter, plus a fifth for what confining
+    // each key to one block costs
+    double bits_per_key = 1.44 * approx_log2(1 / false_positive_rate) * 1.2;
+    unsigned int hashes = (unsigned int)(bits_per_key * 0.69 / 1.2 + 0.5);
+    hashes = hashes < 1 ? 1 : hashes > MAX_HASHES ? MAX_HASHES : hashes;
+
+    size_t bits = (size_t)(bits_per_key * (expected > 0 ? expected : 1)) + 1;
+
+    Allocator allocator = alloc_get_allocator();
+    Bloom *bloom = alloc_malloc(&allocator, sizeof(Bloom));
+    bloom->allocator = allocator;
+    bloom->block_count = (bits + BLOCK_BITS - 1) / BLOCK_BITS;
+    bloom->hashes = hashes;
+    bloom->memory = alloc_malloc(&allocator, bloom->block_count * BLOCK_BYTES + BLOCK_BYTES - 1);
+    bloom->blocks = (uint64_t *)(((uintptr_t)bloom->memory + BLOCK_BYTES - 1) & ~(uintptr_t)(BLOCK_BYTES - 1));
+    bloom_clear(bloom);
+
+    return bloom;
+}
+
+void bloom_destroy(Bloom *bloom)
+{
+    if (bloom)
+    {
+        Allocator allocator = bloom->allocator;
+        alloc_free(&allocator, bloom->memory);
+        alloc_free(&allocator, bloom);
+    }
+}
+
+void bloom_clear(Bloom *bloom)
+{
+    memset(bloom->blocks, 0, bloom->block_count * BLOCK_BYTES);
+}
+
+size_t bloom_memory(const Bloom *bloom)
+{
+    return sizeof(Bloom) + bloom->block_count * BLOCK_BYTES + BLOCK_BYTES - 1;
+}
+
+/*
+ * Picks the block from the high half of the hash and builds the key's
+ * pattern within it from 9-bit slices of remixed hashes. Testing the
+ * pattern word by word without branches lets the compiler vectorize it.
+ */
+static const uint64_t *key_pattern(const Bloom *bloom, uint64_t hash, uint64_t pattern[BLOCK_WORDS])
+{
+    hash = mix(hash);
+    size_t block = (size_t)(((hash >> 32) * (uint64_t)bloom->block_count) >> 32);
+
+    memset(pattern, 0, sizeof(uint64_t) * BLOCK_WORDS);
+    uint64_t bits = hash;
+    for (unsigned int i = 0; i < bloom->hashes; i++)
+    {
+        if (i % 7 == 0)
+        {
+            bits = mix(hash + i);
+        }
+        unsigned int bit = bits & (BLOCK_BITS - 1);
+        bits >>= 9;
+        pattern[bit / 64] |= UINT64_C(1) << (bit % 64);
+    }
+
+    return bloom->blocks + block * BLOCK_WORDS;
+}
+
+void bloom_add(Bloom *bloom, uint64_t hash)
+{
+    uint64_t pattern[BLOCK_WORDS];
+    uint64_t *block = (uint64_t *)key_pattern(bloom, hash, pattern);
+
+    for (unsigned int w = 0; w < BLOCK_WORDS; w++)
+    {
+        block[w] |= pattern[w];
+    }
+}
+
+bool bloom_may_contain(const Bloom *bloom, uint64_t hash)
+{
+    uint64_t pattern[BLOCK_WORDS];
+    const uint64_t *block = key_pattern(bloom, hash, pattern);
+
+    uint64_t missing = 0;
+    for (unsigned int w = 0; w < BLOCK_WORDS; w++)
+    {
+        missing |= pattern[w] & ~block[w];
+    }
+    return missing == 0;
+}
+
+bool bloom_merge(Bloom *into, const Bloom *other)
+{
+    if (into->block_count != other->block_count || into->hashes != other->hashes)
+    {
+        return false;
+    }
+
+    size_t words = into->block_count * BLOCK_WORDS;
+    for (size_t i = 0; i < words; i++)
+    {
+        into->blocks[i] |= other->blocks[i];
+    }
+    return true;
+}
@@ -0,0 +1,29 @@
+#ifndef LIBUTILS_BLOOM_H
+#define LIBUTILS_BLOOM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A blocked Bloom filter: each key sets and tests bits within a single
+ * 64-byte block, so a lookup touches one cache line. Keys are given as
+ * 64-bit hashes, which the filter mixes again before use.
+ */
+
+typedef struct Bloom_ Bloom;
+
+// Sized so that expected keys give about false_positive_rate
+Bloom *bloom_new(size_t expected, double false_positive_rate);
+void bloom_destroy(Bloom *bloom);
+
+void bloom_add(Bloom *bloom, uint64_t hash);
+bool bloom_may_contain(const Bloom *bloom, uint64_t hash);
+void bloom_clear(Bloom *bloom);
+// Adds other's keys to into; both must have been made with the same sizes
+bool bloom_merge(Bloom *into, const Bloom *other);
+size_t bloom_memory(const Bloom *bloom);
+
+uint64_t bloom_hash_bytes(const void *data, size_t size);
+
+#endif
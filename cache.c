@@ -0,0 +1,694 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "cache.h"
+
+#include "alloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CACHE_LINE 64
+#define INITIAL_BUCKETS 16
+
+// four levels of 64 slots cover 2^24 ms, about 4.7 hours, at 1 ms resolution
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN (UINT64_C(1) << (WHEEL_BITS * WHEEL_LEVELS))
+
+typedef struct Link_
+{
+    struct Link_ *prev;
+    struct Link_ *next;
+} Link;
+
+typedef struct Entry_
+{
+    struct Entry_ *chain;
+    // position on the LRU list or CLOCK ring
+    Link order;
+    // position in a timing wheel slot, next is NULL without a TTL
+    Link timer;
+    void *key;
+    void *value;
+    size_t weight;
+    uint64_t expires;
+    uint32_t hash;
+    bool referenced;
+} Entry;
+
+typedef struct
+{
+    // the last millisecond processed
+    uint64_t now;
+    size_t timers;
+    Link slots[WHEEL_LEVELS][WHEEL_SLOTS];
+} Wheel;
+
+struct Cache_
+{
+    CacheCallbacks callbacks;
+    CachePolicy policy;
+    size_t capacity;
+
+    Entry **buckets;
+    size_t bucket_count;
+    size_t size;
+    size_t weight;
+
+    // sentinel; for LRU, order.next is the most recently used entry
+    Link order;
+    // the next entry CLOCK looks at, or the sentinel
+    Link *hand;
+
+    Wheel wheel;
+    CacheStats stats;
+    Allocator allocator;
+};
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    Cache *cache;
+    // keeps neighbouring shards' locks off each other's cache lines
+    char padding[CACHE_LINE];
+} Shard;
+
+struct ConcurrentCache_
+{
+    uint64_t (*key_hash)(const void *key);
+    void *(*value_copy)(const void *value);
+    Shard *shards;
+    unsigned int shard_count;
+    Allocator allocator;
+};
+
+static void *noop_copy(const void *p)
+{
+    return (void *)p;
+}
+
+static void noop_destroy(void *p)
+{
+}
+
+static int pointer_compare(const void *a, const void *b)
+{
+    return (a > b) - (a < b);
+}
+
+static uint64_t pointer_hash(const void *p)
+{
+    uint64_t h = (uint64_t)(uintptr_t)p;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static size_t unit_weight(const void *key, const void *value)
+{
+    return 1;
+}
+
+static uint64_t monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static Entry *order_entry(Link *link)
+{
+    return (Entry *)((char *)link - offsetof(Entry, order));
+}
+
+static Entry *timer_entry(Link *link)
+{
+    return (Entry *)((char *)link - offsetof(Entry, timer));
+}
+
+static void link_init(Link *sentinel)
+{
+    sentinel->prev = sentinel->next = sentinel;
+}
+
+static void link_unlink(Link *link)
+{
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+}
+
+static void link_insert_after(Link *position, Link *link)
+{
+    link->prev = position;
+    link->next = position->next;
+    position->next->prev = link;
+    position->next = link;
+}
+
+static void wheel_init(Wheel *wheel, uint64_t now)
+{
+    wheel->now = now;
+    wheel->timers = 0;
+    for (int level = 0; level < WHEEL_LEVELS; level++)
+    {
+        for (int slot = 0; slot < WHEEL_SLOTS; slot++)
+        {
+            link_init(&wheel->slots[level][slot]);
+        }
+    }
+}
+
+/*
+ * Files the entry at the lowest level whose span covers its delay, in the
+ * slot given by its expiry time's digit at that level. Reaching a slot of a
+ * higher level moves its entries down a level, and the level-0 slot of the
+ * current millisecond holds exactly the entries expiring then. Delays past
+ * the wheel's span park in the top level and are filed again from there.
+ */
+static void wheel_link(Wheel *wheel, Entry *entry)
+{
+    uint64_t delay = entry->expires - wheel->now;
+    uint64_t when = delay < WHEEL_SPAN ? entry->expires : wheel->now + WHEEL_SPAN - 1;
+
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delay >= UINT64_C(1) << (WHEEL_BITS * (level + 1)))
+    {
+        level++;
+    }
+
+    Link *slot = &wheel->slots[level][(when >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)];
+    link_insert_after(slot->prev, &entry->timer);
+}
+
+static Entry **bucket_of(const Cache *cache, uint32_t hash)
+{
+    return &cache->buckets[hash & (cache->bucket_count - 1)];
+}
+
+static Entry *find(const Cache *cache, const void *key, uint32_t hash)
+{
+    Entry *entry = *bucket_of(cache, hash);
+    while (entry && (entry->hash != hash || cache->callbacks.key_compare(entry->key, key) != 0))
+    {
+        entry = entry->chain;
+    }
+    return entry;
+}
+
+static void grow(Cache *cache)
+{
+    Entry **old = cache->buckets;
+    size_t old_count = cache->bucket_count;
+
+    cache->bucket_count *= 2;
+    cache->buckets = alloc_calloc(&cache->allocator, cache->bucket_count, sizeof(Entry *));
+
+    for (size_t b = 0; b < old_count; b++)
+    {
+        Entry *entry = old[b];
+        while (entry)
+        {
+            Entry *next = entry->chain;
+            Entry **bucket = bucket_of(cache, entry->hash);
+            entry->chain = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+
+    alloc_free(&cache->allocator, old);
+}
+
+static void timer_unlink(Cache *cache, Entry *entry)
+{
+    if (entry->timer.next)
+    {
+        link_unlink(&entry->timer);
+        entry->timer.next = NULL;
+        cache->wheel.timers--;
+    }
+}
+
+static void entry_remove(Cache *cache, Entry *entry)
+{
+    Entry **link = bucket_of(cache, entry->hash);
+    while (*link != entry)
+    {
+        link = &(*link)->chain;
+    }
+    *link = entry->chain;
+
+    if (cache->hand == &entry->order)
+    {
+        cache->hand = entry->order.next;
+    }
+    link_unlink(&entry->order);
+    timer_unlink(cache, entry);
+
+    cache->size--;
+    cache->weight -= entry->weight;
+    cache->callbacks.key_destroy(entry->key);
+    cache->callbacks.value_destroy(entry->value);
+    alloc_free(&cache->allocator, entry);
+}
+
+/*
+ * The first tick after now that expires entries or cascades a slot: the
+ * next occupied level-0 slot, or the next boundary of a higher level whose
+ * slot is occupied. Every tick before it can be skipped.
+ */
+static uint64_t next_tick(const Wheel *wheel)
+{
+    uint64_t next = UINT64_MAX;
+
+    for (int level = 0; level < WHEEL_LEVELS; level++)
+    {
+        uint64_t base = wheel->now >> (WHEEL_BITS * level);
+        for (uint64_t k = 1; k <= WHEEL_SLOTS; k++)
+        {
+            uint64_t t = (base + k) << (WHEEL_BITS * level);
+            if (t >= next)
+            {
+                break;
+            }
+
+            const Link *slot = &wheel->slots[level][(base + k) & (WHEEL_SLOTS - 1)];
+            if (slot->next != slot)
+            {
+                next = t;
+                break;
+            }
+        }
+    }
+
+    return next;
+}
+
+static size_t advance(Cache *cache, uint64_t now)
+{
+    Wheel *wheel = &cache->wheel;
+    size_t expired = 0;
+
+    while (wheel->now < now)
+    {
+        uint64_t t = wheel->timers > 0 ? next_tick(wheel) : UINT64_MAX;
+        if (t > now)
+        {
+            wheel->now = now;
+            break;
+        }
+        wheel->now = t;
+
+        // the higher levels whose slot boundary t is, highest first
+        int top = 0;
+        while (top < WHEEL_LEVELS - 1 && (t & ((UINT64_C(1) << (WHEEL_BITS * (top + 1))) - 1)) == 0)
+        {
+            top++;
+        }
+        for (int level = top; level >= 1; level--)
+        {
+            Link *slot = &wheel->slots[level][(t >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)];
+            while (slot->next != slot)
+            {
+                Entry *entry = timer_entry(slot->next);
+                link_unlink(&entry->timer);
+                wheel_link(wheel, entry);
+            }
+        }
+
+        Link *slot = &wheel->slots[0][t & (WHEEL_SLOTS - 1)];
+        while (slot->next != slot)
+        {
+            entry_remove(cache, timer_entry(slot->next));
+            cache->stats.expirations++;
+            expired++;
+        }
+    }
+
+    return expired;
+}
+
+// Only reads the clock while some entry has a TTL
+static void sync_clock(Cache *cache)
+{
+    if (cache->wheel.timers > 0)
+    {
+        advance(cache, cache->callbacks.now());
+    }
+}
+
+static void evict(Cache *cache)
+{
+    while (cache->weight > cache->capacity && cache->size > 0)
+    {
+        Link *victim;
+        if (cache->policy == CACHE_LRU)
+        {
+            victim = cache->order.prev;
+        }
+        else
+        {
+            // second chance: clear the bits of hit entries until one was not
+            victim = cache->hand;
+            for (;;)
+            {
+                if (victim == &cache->order)
+                {
+                    victim = victim->next;
+                }
+                Entry *entry = order_entry(victim);
+                if (!entry->referenced)
+                {
+                    break;
+                }
+                entry->referenced = false;
+                victim = victim->next;
+            }
+            cache->hand = victim;
+        }
+
+        entry_remove(cache, order_entry(victim));
+        cache->stats.evictions++;
+    }
+}
+
+static void touch(Cache *cache, Entry *entry)
+{
+    if (cache->policy == CACHE_LRU)
+    {
+        link_unlink(&entry->order);
+        link_insert_after(&cache->order, &entry->order);
+    }
+    else
+    {
+        entry->referenced = true;
+    }
+}
+
+Cache *cache_new(const CacheCallbacks *callbacks, size_t capacity, CachePolicy policy)
+{
+    assert(!(callbacks->key_copy && callbacks->key_destroy) || (callbacks->key_copy && callbacks->key_destroy));
+    assert(!(callbacks->value_copy && callbacks->value_destroy) || (callbacks->value_copy && callbacks->value_destroy));
+    // keys compared by content need a hash of their content
+    assert(!callbacks->key_compare || callbacks->key_hash);
+
+    Allocator allocator = alloc_get_allocator();
+    Cache *cache = alloc_malloc(&allocator, sizeof(Cache));
+    cache->allocator = allocator;
+
+    cache->callbacks.key_copy = callbacks->key_copy ? callbacks->key_copy : noop_copy;
+    cache->callbacks.key_compare = callbacks->key_compare ? callbacks->key_compare : pointer_compare;
+    cache->callbacks.key_hash = callbacks->key_hash ? callbacks->key_hash : pointer_hash;
+    cache->callbacks.key_destroy = callbacks->key_destroy ? callbacks->key_destroy : noop_destroy;
+    cache->callbacks.value_copy = callbacks->value_copy ? callbacks->value_copy : noop_copy;
+    cache->callbacks.value_destroy = callbacks->value_destroy ? callbacks->value_destroy : noop_destroy;
+    cache->callbacks.weight = callbacks->weight ? callbacks->weight : unit_weight;
+    cache->callbacks.now = callbacks->now ? callbacks->now : monotonic_ms;
+
+    cache->policy = policy;
+    cache->capacity = capacity;
+    cache->buckets = alloc_calloc(&allocator, INITIAL_BUCKETS, sizeof(Entry *));
+    cache->bucket_count = INITIAL_BUCKETS;
+    cache->size = 0;
+    cache->weight = 0;
+    link_init(&cache->order);
+    cache->hand = &cache->order;
+    wheel_init(&cache->wheel, cache->callbacks.now());
+    memset(&cache->stats, 0, sizeof(CacheStats));
+
+    return cache;
+}
+
+void cache_destroy(Cache *cache)
+{
+    if (cache)
+    {
+        cache_clear(cache);
+        Allocator allocator = cache->allocator;
+        alloc_free(&allocator, cache->buckets);
+        alloc_free(&allocator, cache);
+    }
+}
+
+static bool put(Cache *cache, const void *key, const void *value, uint64_t ttl)
+{
+    if (ttl > 0 || cache->wheel.timers > 0)
+    {
+        advance(cache, cache->callbacks.now());
+    }
+
+    uint32_t hash = (uint32_t)cache->callbacks.key_hash(key);
+    Entry *entry = find(cache, key, hash);
+    bool existed = entry != NULL;
+
+    if (entry)
+    {
+        cache->callbacks.value_destroy(entry->value);
+        entry->value = cache->callbacks.value_copy(value);
+        cache->weight -= entry->weight;
+        timer_unlink(cache, entry);
+        touch(cache, entry);
+    }
+    else
+    {
+        entry = alloc_malloc(&cache->allocator, sizeof(Entry));
+        entry->key = cache->callbacks.key_copy(key);
+        entry->value = cache->callbacks.value_copy(value);
+        entry->hash = hash;
+        entry->referenced = false;
+        entry->timer.next = NULL;
+
+        Entry **bucket = bucket_of(cache, hash);
+        entry->chain = *bucket;
+        *bucket = entry;
+
+        // new CLOCK entries go just behind the hand, the last it reaches
+        Link *position = cache->policy == CACHE_LRU ? &cache->order : cache->hand->prev;
+        link_insert_after(position, &entry->order);
+
+        if (++cache->size > cache->bucket_count)
+        {
+            grow(cache);
+        }
+    }
+
+    entry->weight = cache->callbacks.weight(entry->key, entry->value);
+    cache->weight += entry->weight;
+
+    entry->expires = 0;
+    if (ttl > 0)
+    {
+        entry->expires = cache->wheel.now + ttl;
+        wheel_link(&cache->wheel, entry);
+        cache->wheel.timers++;
+    }
+
+    evict(cache);
+    return existed;
+}
+
+bool cache_put(Cache *cache, const void *key, const void *value)
+{
+    return put(cache, key, value, 0);
+}
+
+bool cache_put_ttl(Cache *cache, const void *key, const void *value, uint64_t ttl)
+{
+    return put(cache, key, value, ttl > 0 ? ttl : 1);
+}
+
+static Entry *lookup(Cache *cache, const void *key)
+{
+    sync_clock(cache);
+
+    Entry *entry = find(cache, key, (uint32_t)cache->callbacks.key_hash(key));
+    if (!entry)
+    {
+        cache->stats.misses++;
+        return NULL;
+    }
+
+    cache->stats.hits++;
+    touch(cache, entry);
+    return entry;
+}
+
+void *cache_get(Cache *cache, const void *key)
+{
+    Entry *entry = lookup(cache, key);
+    return entry ? entry->value : NULL;
+}
+
+bool cache_remove(Cache *cache, const void *key)
+{
+    Entry *entry = find(cache, key, (uint32_t)cache->callbacks.key_hash(key));
+    if (!entry)
+    {
+        return false;
+    }
+    entry_remove(cache, entry);
+    return true;
+}
+
+void cache_clear(Cache *cache)
+{
+    while (cache->order.next != &cache->order)
+    {
+        entry_remove(cache, order_entry(cache->order.next));
+    }
+    cache->hand = &cache->order;
+}
+
+size_t cache_expire(Cache *cache)
+{
+    return advance(cache, cache->callbacks.now());
+}
+
+size_t cache_size(const Cache *cache)
+{
+    return cache->size;
+}
+
+size_t cache_weight(const Cache *cache)
+{
+    return cache->weight;
+}
+
+void cache_stats(const Cache *cache, CacheStats *stats)
+{
+    *stats = cache->stats;
+}
+
+ConcurrentCache *concurrent_cache_new(const CacheCallbacks *callbacks, size_t capacity,
+                                      CachePolicy policy, unsigned int shards)
+{
+    if (shards == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        shards = 4 * (cpus > 0 ? (unsigned int)cpus : 1);
+    }
+
+    Allocator allocator = alloc_get_allocator();
+    ConcurrentCache *cache = alloc_malloc(&allocator, sizeof(ConcurrentCache));
+    cache->allocator = allocator;
+    cache->key_hash = callbacks->key_hash ? callbacks->key_hash : pointer_hash;
+    cache->value_copy = callbacks->value_copy ? callbacks->value_copy : noop_copy;
+    cache->shard_count = shards;
+    cache->shards = alloc_calloc(&allocator, shards, sizeof(Shard));
+
+    size_t shard_capacity = capacity / shards + (capacity % shards != 0);
+    for (unsigned int i = 0; i < shards; i++)
+    {
+        pthread_mutex_init(&cache->shards[i].lock, NULL);
+        cache->shards[i].cache = cache_new(callbacks, shard_capacity, policy);
+    }
+
+    return cache;
+}
+
+void concurrent_cache_destroy(ConcurrentCache *cache)
+{
+    if (cache)
+    {
+        for (unsigned int i = 0; i < cache->shard_count; i++)
+        {
+            cache_destroy(cache->shards[i].cache);
+            pthread_mutex_destroy(&cache->shards[i].lock);
+        }
+        Allocator allocator = cache->allocator;
+        alloc_free(&allocator, cache->shards);
+        alloc_free(&allocator, cache);
+    }
+}
+
+// The high half of the hash picks the shard, the low half the bucket in it
+static Shard *shard_of(const ConcurrentCache *cache, const void *key)
+{
+    uint64_t hash = cache->key_hash(key);
+    return &cache->shards[((hash >> 32) * cache->shard_count) >> 32];
+}
+
+bool concurrent_cache_put(ConcurrentCache *cache, const void *key, const void *value)
+{
+    Shard *shard = shard_of(cache, key);
+    pthread_mutex_lock(&shard->lock);
+    bool existed = cache_put(shard->cache, key, value);
+    pthread_mutex_unlock(&shard->lock);
+    return existed;
+}
+
+bool concurrent_cache_put_ttl(ConcurrentCache *cache, const void *key, const void *value, uint64_t ttl)
+{
+    Shard *shard = shard_of(cache, key);
+    pthread_mutex_lock(&shard->lock);
+    bool existed = cache_put_ttl(shard->cache, key, value, ttl);
+    pthread_mutex_unlock(&shard->lock);
+    return existed;
+}
+
+bool concurrent_cache_get(ConcurrentCache *cache, const void *key, void **value)
+{
+    Shard *shard = shard_of(cache, key);
+    pthread_mutex_lock(&shard->lock);
+    Entry *entry = lookup(shard->cache, key);
+    if (entry)
+    {
+        *value = cache->value_copy(entry->value);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return entry != NULL;
+}
+
+bool concurrent_cache_remove(ConcurrentCache *cache, const void *key)
+{
+    Shard *shard = shard_of(cache, key);
+    pthread_mutex_lock(&shard->lock);
+    bool removed = cache_remove(shard->cache, key);
+    pthread_mutex_unlock(&shard->lock);
+    return removed;
+}
+
+void concurrent_cache_clear(ConcurrentCache *cache)
+{
+    for (unsigned int i = 0; i < cache->shard_count; i++)
+    {
+        pthread_mutex_lock(&cache->shards[i].lock);
+        cache_clear(cache->shards[i].cache);
+        pthread_mutex_unlock(&cache->shards[i].lock);
+    }
+}
+
+size_t concurrent_cache_size(ConcurrentCache *cache)
+{
+    size_t size = 0;
+    for (unsigned int i = 0; i < cache->shard_count; i++)
+    {
+        pthread_mutex_lock(&cache->shards[i].lock);
+        size += cache_size(cache->shards[i].cache);
+        pthread_mutex_unlock(&cache->shards[i].lock);
+    }
+    return size;
+}
+
+void concurrent_cache_stats(ConcurrentCache *cache, CacheStats *stats)
+{
+    memset(stats, 0, sizeof(CacheStats));
+    for (unsigned int i = 0; i < cache->shard_count; i++)
+    {
+        CacheStats shard;
+        pthread_mutex_lock(&cache->shards[i].lock);
+        cache_stats(cache->shards[i].cache, &shard);
+        pthread_mutex_unlock(&cache->shards[i].lock);
+
+        stats->hits += shard.hits;
+        stats->misses += shard.misses;
+        stats->evictions += shard.evictions;
+        stats->expirations += shard.expirations;
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef LIBUTILS_CACHE_H
+#define LIBUTILS_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A bounded key/value cache: a hash table whose entries sit on an LRU list
+ * or a CLOCK ring, plus a hierarchical timing wheel for entries put with a
+ * time to live. Keys and values are copied in and destroyed on the way out
+ * through callbacks, as with rbtree_new; NULL copy and destroy callbacks
+ * store the pointers as they are.
+ */
+
+typedef struct Cache_ Cache;
+typedef struct ConcurrentCache_ ConcurrentCache;
+
+typedef enum
+{
+    // evicts the least recently used entry, each hit relinks its entry
+    CACHE_LRU,
+    // evicts an entry not hit since the hand last passed, hits only set a bit
+    CACHE_CLOCK
+} CachePolicy;
+
+typedef struct
+{
+    void *(*key_copy)(const void *key);
+    int (*key_compare)(const void *a, const void *b);
+    uint64_t (*key_hash)(const void *key);
+    void (*key_destroy)(void *key);
+    void *(*value_copy)(const void *value);
+    void (*value_destroy)(void *value);
+    // What an entry counts against the capacity, e.g. its bytes; 1 if NULL
+    size_t (*weight)(const void *key, const void *value);
+    // Milliseconds on a monotonic clock; CLOCK_MONOTONIC if NULL
+    uint64_t (*now)(void);
+} CacheCallbacks;
+
+typedef struct
+{
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t expirations;
+} CacheStats;
+
+Cache *cache_new(const CacheCallbacks *callbacks, size_t capacity, CachePolicy policy);
+void cache_destroy(Cache *cache);
+
+// Returns whether key was already cached, in which case its value is replaced
+bool cache_put(Cache *cache, const void *key, const void *value);
+// Like cache_put, but the entry expires ttl milliseconds from now
+bool cache_put_ttl(Cache *cache, const void *key, const void *value, uint64_t ttl);
+// The cached value, valid only until the next call on the cache, as any call may expire it
+void *cache_get(Cache *cache, const void *key);
+bool cache_remove(Cache *cache, const void *key);
+void cache_clear(Cache *cache);
+// Drops expired entries now rather than as later calls come across them
+size_t cache_expire(Cache *cache);
+
+size_t cache_size(const Cache *cache);
+// Sum of the entries' weights
+size_t cache_weight(const Cache *cache);
+void cache_stats(const Cache *cache, CacheStats *stats);
+
+/**
+ * A Cache split into shards by key hash, each behind its own mutex, with
+ * the capacity divided between them. shards == 0 picks four per online CPU.
+ * Lookups hand out copies made with value_copy, which the caller destroys.
+ */
+ConcurrentCache *concurrent_cache_new(const CacheCallbacks *callbacks, size_t capacity,
+                                      CachePolicy policy, unsigned int shards);
+void concurrent_cache_destroy(ConcurrentCache *cache);
+
+bool concurrent_cache_put(ConcurrentCache *cache, const void *key, const void *value);
+bool concurrent_cache_put_ttl(ConcurrentCache *cache, const void *key, const void *value, uint64_t ttl);
+bool concurrent_cache_get(ConcurrentCache *cache, const void *key, void **value);
+bool concurrent_cache_remove(ConcurrentCache *cache, const void *key);
+void concurrent_cache_clear(ConcurrentCache *cache);
+
+size_t concurrent_cache_size(ConcurrentCache *cache);
+void concurrent_cache_stats(ConcurrentCache *cache, CacheStats *stats);
+
+#endif
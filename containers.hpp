@@ -0,0 +1,660 @@
+#ifndef LIBUTILS_CONTAINERS_HPP
+#define LIBUTILS_CONTAINERS_HPP
+
+extern "C"
+{
+#include "rb-tree.h"
+#include "seq.h"
+}
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/*
+ * Header-only C++ wrappers sharing the C RBTree and Seq implementations.
+ *
+ * Map and set entries are constructed in the storage of their RB node, so
+ * an insertion is one descent and one allocation. The nodes come from the
+ * allocator current when the container is created, so ordered_map and set
+ * take no Alloc; use lu::allocator_scope to place them. seq keeps trivially
+ * copyable elements in place and boxes the rest through Alloc, as Seq moves
+ * its elements with memcpy when it grows. Nothing goes through the copy
+ * callbacks. Compare and Alloc are instantiated inside the C callbacks, so
+ * both must be default constructible and stateless.
+ */
+
+namespace lu
+{
+
+namespace detail
+{
+
+template <typename K, typename Compare>
+int compare_thunk(const void *a, const void *b)
+{
+    const K &x = *static_cast<const K *>(a);
+    const K &y = *static_cast<const K *>(b);
+    Compare less;
+
+    if (less(x, y))
+    {
+        return -1;
+    }
+    return less(y, x) ? 1 : 0;
+}
+
+template <typename T, typename Alloc>
+using rebind_traits = typename std::allocator_traits<Alloc>::template rebind_traits<T>;
+
+template <typename T, typename Alloc, typename... Args>
+T *create(Args &&... args)
+{
+    typename rebind_traits<T, Alloc>::allocator_type alloc;
+    T *p = rebind_traits<T, Alloc>::allocate(alloc, 1);
+
+    try
+    {
+        rebind_traits<T, Alloc>::construct(alloc, p, std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        rebind_traits<T, Alloc>::deallocate(alloc, p, 1);
+        throw;
+    }
+
+    return p;
+}
+
+template <typename T, typename Alloc>
+void destroy_thunk(void *_p)
+{
+    typename rebind_traits<T, Alloc>::allocator_type alloc;
+    T *p = static_cast<T *>(_p);
+
+    rebind_traits<T, Alloc>::destroy(alloc, p);
+    rebind_traits<T, Alloc>::deallocate(alloc, p, 1);
+}
+
+// for entries living in RB node storage, which goes with the node
+template <typename T>
+void destruct_thunk(void *p)
+{
+    if (p)
+    {
+        static_cast<T *>(p)->~T();
+    }
+}
+
+/*
+ * Links a node for key and constructs the entry in its storage from args, or
+ * returns the node already holding key. Entry is value_type; KeyOf picks the
+ * key out of a constructed entry. key only needs to outlive the call.
+ */
+template <typename Entry, typename KeyOf, typename Key, typename... Args>
+std::pair<RBNode *, bool> tree_emplace(RBTree *tree, const Key &key, Args &&... args)
+{
+    static_assert(alignof(Entry) <= alignof(std::max_align_t), "RB node storage is aligned like malloc()");
+
+    bool inserted;
+    RBNode *node = rbtree_insert(tree, &key, nullptr, sizeof(Entry), &inserted);
+    if (inserted)
+    {
+        Entry *entry = static_cast<Entry *>(rbtree_node_data(node));
+        try
+        {
+            ::new (static_cast<void *>(entry)) Entry(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            rbtree_node_set(node, nullptr, nullptr);
+            rbtree_remove_node(tree, node);
+            throw;
+        }
+        rbtree_node_set(node, &KeyOf()(*entry), entry);
+    }
+
+    return std::make_pair(node, inserted);
+}
+
+template <typename Pair>
+struct first_of
+{
+    const typename Pair::first_type &operator()(const Pair &pair) const { return pair.first; }
+};
+
+template <typename T>
+struct identity_of
+{
+    const T &operator()(const T &value) const { return value; }
+};
+
+// walks RBTree nodes, yielding the node key (sets) or value (maps)
+template <typename Value, bool FromKey>
+class tree_iterator
+{
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = typename std::remove_const<Value>::type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Value *;
+    using reference = Value &;
+
+    tree_iterator() = default;
+    tree_iterator(const RBTree *tree, RBNode *node) : tree_(tree), node_(node) {}
+
+    template <typename Other, typename = typename std::enable_if<std::is_const<Value>::value
+                                                                 && std::is_same<const Other, Value>::value>::type>
+    tree_iterator(const tree_iterator<Other, FromKey> &other) : tree_(other.tree_), node_(other.node_) {}
+
+    reference operator*() const
+    {
+        return *static_cast<Value *>(FromKey ? rbtree_node_key(node_) : rbtree_node_value(node_));
+    }
+
+    pointer operator->() const
+    {
+        return &**this;
+    }
+
+    tree_iterator &operator++()
+    {
+        node_ = rbtree_next(tree_, node_);
+        return *this;
+    }
+
+    tree_iterator operator++(int)
+    {
+        tree_iterator old = *this;
+        ++*this;
+        return old;
+    }
+
+    tree_iterator &operator--()
+    {
+        node_ = node_ ? rbtree_prev(tree_, node_) : rbtree_last(tree_);
+        return *this;
+    }
+
+    tree_iterator operator--(int)
+    {
+        tree_iterator old = *this;
+        --*this;
+        return old;
+    }
+
+    bool operator==(const tree_iterator &other) const
+    {
+        return node_ == other.node_;
+    }
+
+    bool operator!=(const tree_iterator &other) const
+    {
+        return node_ != other.node_;
+    }
+
+    RBNode *node() const
+    {
+        return node_;
+    }
+
+private:
+    template <typename, bool> friend class tree_iterator;
+
+    const RBTree *tree_ = nullptr;
+    RBNode *node_ = nullptr;
+};
+
+template <typename Value>
+class seq_iterator
+{
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = typename std::remove_const<Value>::type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Value *;
+    using reference = Value &;
+
+    seq_iterator() = default;
+    seq_iterator(const Seq *seq, std::size_t index) : seq_(seq), index_(index) {}
+
+    template <typename Other, typename = typename std::enable_if<std::is_const<Value>::value
+                                                                 && std::is_same<const Other, Value>::value>::type>
+    seq_iterator(const seq_iterator<Other> &other) : seq_(other.seq_), index_(other.index_) {}
+
+    reference operator*() const
+    {
+        return *static_cast<Value *>(seq_at(seq_, index_));
+    }
+
+    pointer operator->() const
+    {
+        return &**this;
+    }
+
+    reference operator[](difference_type n) const
+    {
+        return *(*this + n);
+    }
+
+    seq_iterator &operator++()
+    {
+        ++index_;
+        return *this;
+    }
+
+    seq_iterator operator++(int)
+    {
+        seq_iterator old = *this;
+        ++index_;
+        return old;
+    }
+
+    seq_iterator &operator--()
+    {
+        --index_;
+        return *this;
+    }
+
+    seq_iterator operator--(int)
+    {
+        seq_iterator old = *this;
+        --index_;
+        return old;
+    }
+
+    seq_iterator &operator+=(difference_type n)
+    {
+        index_ += n;
+        return *this;
+    }
+
+    seq_iterator &operator-=(difference_type n)
+    {
+        index_ -= n;
+        return *this;
+    }
+
+    seq_iterator operator+(difference_type n) const
+    {
+        return seq_iterator(seq_, index_ + n);
+    }
+
+    seq_iterator operator-(difference_type n) const
+    {
+        return seq_iterator(seq_, index_ - n);
+    }
+
+    difference_type operator-(const seq_iterator &other) const
+    {
+        return static_cast<difference_type>(index_) - static_cast<difference_type>(other.index_);
+    }
+
+    bool operator==(const seq_iterator &other) const { return index_ == other.index_; }
+    bool operator!=(const seq_iterator &other) const { return index_ != other.index_; }
+    bool operator<(const seq_iterator &other) const { return index_ < other.index_; }
+    bool operator>(const seq_iterator &other) const { return index_ > other.index_; }
+    bool operator<=(const seq_iterator &other) const { return index_ <= other.index_; }
+    bool operator>=(const seq_iterator &other) const { return index_ >= other.index_; }
+
+private:
+    template <typename> friend class seq_iterator;
+
+    const Seq *seq_ = nullptr;
+    std::size_t index_ = 0;
+};
+
+} // namespace detail
+
+template <typename K, typename V, typename Compare = std::less<K>>
+class ordered_map
+{
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<const K, V>;
+    using size_type = std::size_t;
+    using key_compare = Compare;
+    using iterator = detail::tree_iterator<value_type, false>;
+    using const_iterator = detail::tree_iterator<const value_type, false>;
+
+    ordered_map() : tree_(tree_new()) {}
+
+    ordered_map(std::initializer_list<value_type> values) : tree_(tree_new())
+    {
+        for (const value_type &value : values)
+        {
+            insert(value);
+        }
+    }
+
+    ordered_map(const ordered_map &other) : tree_(tree_new())
+    {
+        for (const value_type &value : other)
+        {
+            insert(value);
+        }
+    }
+
+    ordered_map(ordered_map &&other) noexcept : tree_(other.tree_)
+    {
+        other.tree_ = tree_new();
+    }
+
+    ordered_map &operator=(ordered_map other) noexcept
+    {
+        std::swap(tree_, other.tree_);
+        return *this;
+    }
+
+    ~ordered_map()
+    {
+        rbtree_destroy(tree_);
+    }
+
+    size_type size() const { return rbtree_size(tree_); }
+    bool empty() const { return size() == 0; }
+    void clear() { rbtree_clear(tree_); }
+
+    iterator begin() { return iterator(tree_, rbtree_first(tree_)); }
+    iterator end() { return iterator(tree_, nullptr); }
+    const_iterator begin() const { return const_iterator(tree_, rbtree_first(tree_)); }
+    const_iterator end() const { return const_iterator(tree_, nullptr); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    iterator find(const K &key) { return iterator(tree_, rbtree_find(tree_, &key)); }
+    const_iterator find(const K &key) const { return const_iterator(tree_, rbtree_find(tree_, &key)); }
+    size_type count(const K &key) const { return rbtree_find(tree_, &key) ? 1 : 0; }
+    bool contains(const K &key) const { return count(key) != 0; }
+
+    // the key is only known once args are applied, so the entry is built aside and moved into the node
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args &&... args)
+    {
+        std::pair<K, V> value(std::forward<Args>(args)...);
+        return node_emplace(value.first, std::move(value));
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const K &key, Args &&... args)
+    {
+        return node_emplace(key, std::piecewise_construct,
+                            std::forward_as_tuple(key),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(K &&key, Args &&... args)
+    {
+        return node_emplace(key, std::piecewise_construct,
+                            std::forward_as_tuple(std::move(key)),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    std::pair<iterator, bool> insert(const value_type &value) { return node_emplace(value.first, value); }
+    std::pair<iterator, bool> insert(value_type &&value) { return node_emplace(value.first, std::move(value)); }
+
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(const K &key, M &&mapped)
+    {
+        std::pair<iterator, bool> result = try_emplace(key, std::forward<M>(mapped));
+        if (!result.second)
+        {
+            result.first->second = std::forward<M>(mapped);
+        }
+        return result;
+    }
+
+    V &operator[](const K &key) { return try_emplace(key).first->second; }
+    V &operator[](K &&key) { return try_emplace(std::move(key)).first->second; }
+
+    V &at(const K &key)
+    {
+        iterator it = find(key);
+        if (it == end())
+        {
+            throw std::out_of_range("lu::ordered_map::at");
+        }
+        return it->second;
+    }
+
+    const V &at(const K &key) const
+    {
+        const_iterator it = find(key);
+        if (it == end())
+        {
+            throw std::out_of_range("lu::ordered_map::at");
+        }
+        return it->second;
+    }
+
+    size_type erase(const K &key)
+    {
+        return rbtree_remove(tree_, &key) ? 1 : 0;
+    }
+
+    iterator erase(const_iterator pos)
+    {
+        // the successor node survives the removal
+        const_iterator next = std::next(pos);
+        rbtree_remove_node(tree_, pos.node());
+        return iterator(tree_, next.node());
+    }
+
+private:
+    static RBTree *tree_new()
+    {
+        return rbtree_new(nullptr, &detail::compare_thunk<K, Compare>, nullptr,
+                          nullptr, nullptr, &detail::destruct_thunk<value_type>);
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> node_emplace(const K &key, Args &&... args)
+    {
+        std::pair<RBNode *, bool> result =
+            detail::tree_emplace<value_type, detail::first_of<value_type>>(tree_, key, std::forward<Args>(args)...);
+        return std::make_pair(iterator(tree_, result.first), result.second);
+    }
+
+    RBTree *tree_;
+};
+
+template <typename T, typename Compare = std::less<T>>
+class set
+{
+public:
+    using key_type = T;
+    using value_type = T;
+    using size_type = std::size_t;
+    using key_compare = Compare;
+    using const_iterator = detail::tree_iterator<const T, true>;
+    using iterator = const_iterator;
+
+    set() : tree_(tree_new()) {}
+
+    set(std::initializer_list<T> values) : tree_(tree_new())
+    {
+        for (const T &value : values)
+        {
+            insert(value);
+        }
+    }
+
+    set(const set &other) : tree_(tree_new())
+    {
+        for (const T &value : other)
+        {
+            insert(value);
+        }
+    }
+
+    set(set &&other) noexcept : tree_(other.tree_)
+    {
+        other.tree_ = tree_new();
+    }
+
+    set &operator=(set other) noexcept
+    {
+        std::swap(tree_, other.tree_);
+        return *this;
+    }
+
+    ~set()
+    {
+        rbtree_destroy(tree_);
+    }
+
+    size_type size() const { return rbtree_size(tree_); }
+    bool empty() const { return size() == 0; }
+    void clear() { rbtree_clear(tree_); }
+
+    const_iterator begin() const { return const_iterator(tree_, rbtree_first(tree_)); }
+    const_iterator end() const { return const_iterator(tree_, nullptr); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    const_iterator find(const T &value) const { return const_iterator(tree_, rbtree_find(tree_, &value)); }
+    size_type count(const T &value) const { return rbtree_find(tree_, &value) ? 1 : 0; }
+    bool contains(const T &value) const { return count(value) != 0; }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args &&... args)
+    {
+        T value(std::forward<Args>(args)...);
+        return node_emplace(value, std::move(value));
+    }
+
+    std::pair<iterator, bool> insert(const T &value) { return node_emplace(value, value); }
+    std::pair<iterator, bool> insert(T &&value) { return node_emplace(value, std::move(value)); }
+
+    size_type erase(const T &value)
+    {
+        return rbtree_remove(tree_, &value) ? 1 : 0;
+    }
+
+private:
+    static RBTree *tree_new()
+    {
+        return rbtree_new(nullptr, &detail::compare_thunk<T, Compare>, &detail::destruct_thunk<T>,
+                          nullptr, nullptr, nullptr);
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> node_emplace(const T &key, Args &&... args)
+    {
+        std::pair<RBNode *, bool> result =
+            detail::tree_emplace<T, detail::identity_of<T>>(tree_, key, std::forward<Args>(args)...);
+        return std::make_pair(iterator(tree_, result.first), result.second);
+    }
+
+    RBTree *tree_;
+};
+
+template <typename T, typename Alloc = std::allocator<T>>
+class seq
+{
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using allocator_type = Alloc;
+    using iterator = detail::seq_iterator<T>;
+    using const_iterator = detail::seq_iterator<const T>;
+
+    seq() : seq_(seq_new_empty()) {}
+
+    seq(std::initializer_list<T> values) : seq_(seq_new_empty())
+    {
+        for (const T &value : values)
+        {
+            push_back(value);
+        }
+    }
+
+    seq(const seq &other) : seq_(seq_new_empty())
+    {
+        for (const T &value : other)
+        {
+            push_back(value);
+        }
+    }
+
+    seq(seq &&other) noexcept : seq_(other.seq_)
+    {
+        other.seq_ = seq_new_empty();
+    }
+
+    seq &operator=(seq other) noexcept
+    {
+        std::swap(seq_, other.seq_);
+        return *this;
+    }
+
+    ~seq()
+    {
+        seq_destroy(seq_);
+    }
+
+    size_type size() const { return seq_length(seq_); }
+    bool empty() const { return size() == 0; }
+
+    T &operator[](size_type index) { return *static_cast<T *>(seq_at(seq_, index)); }
+    const T &operator[](size_type index) const { return *static_cast<const T *>(seq_at(seq_, index)); }
+    T &front() { return (*this)[0]; }
+    T &back() { return (*this)[size() - 1]; }
+
+    iterator begin() { return iterator(seq_, 0); }
+    iterator end() { return iterator(seq_, size()); }
+    const_iterator begin() const { return const_iterator(seq_, 0); }
+    const_iterator end() const { return const_iterator(seq_, size()); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    template <typename... Args>
+    T &emplace_back(Args &&... args)
+    {
+        if constexpr (in_place)
+        {
+            T value(std::forward<Args>(args)...);
+            seq_append(seq_, &value);
+            return back();
+        }
+        else
+        {
+            T *value = detail::create<T, Alloc>(std::forward<Args>(args)...);
+            seq_append(seq_, value);
+            return *value;
+        }
+    }
+
+    void push_back(const T &value) { emplace_back(value); }
+    void push_back(T &&value) { emplace_back(std::move(value)); }
+
+private:
+    static constexpr bool in_place = std::is_trivially_copyable<T>::value;
+
+    static Seq *seq_new_empty()
+    {
+        if constexpr (in_place)
+        {
+            return seq_new_sized(sizeof(T), 0, nullptr);
+        }
+        else
+        {
+            return seq_new(0, &detail::destroy_thunk<T, Alloc>);
+        }
+    }
+
+    Seq *seq_;
+};
+
+} // namespace lu
+
+#endif
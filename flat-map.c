@@ -0,0 +1,265 @@
+#include "flat-map.h"
+
+#include "alloc.h"
+#include "seq.h"
+#include "seq-sort.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+typedef struct
+{
+    void *key;
+    void *value;
+} FlatEntry;
+
+typedef struct
+{
+    void *key;
+    void *value;
+    size_t order;
+} PendingEntry;
+
+struct FlatMap_
+{
+    Seq *entries;
+    Seq *pending;
+    size_t next_order;
+
+    void *(*key_copy)(const void *key);
+    int (*key_compare)(const void *a, const void *b);
+    void (*key_destroy)(void *key);
+
+    void *(*value_copy)(const void *value);
+    void (*value_destroy)(void *value);
+
+    Allocator allocator;
+};
+
+static void noop_destroy(void *a)
+{
+    return;
+}
+
+static void *noop_copy(const void *a)
+{
+    return (void *)a;
+}
+
+static int pointer_compare(const void *a, const void *b)
+{
+    return (a > b) - (a < b);
+}
+
+FlatMap *flat_map_new(void *(*key_copy)(const void *key),
+                      int (*key_compare)(const void *a, const void *b),
+                      void (*key_destroy)(void *key),
+                      void *(*value_copy)(const void *value),
+                      void (*value_destroy)(void *value))
+{
+    assert(!(key_copy && key_destroy) || (key_copy && key_destroy));
+    assert(!(value_copy && value_destroy) || (value_copy && value_destroy));
+
+    Allocator allocator = alloc_get_allocator();
+    FlatMap *map = alloc_malloc(&allocator, sizeof(FlatMap));
+    map->allocator = allocator;
+
+    map->entries = seq_new_sized(sizeof(FlatEntry), 0, NULL);
+    map->pending = seq_new_sized(sizeof(PendingEntry), 0, NULL);
+    map->next_order = 0;
+
+    map->key_copy = key_copy ? key_copy : noop_copy;
+    map->key_compare = key_compare ? key_compare : pointer_compare;
+    map->key_destroy = key_destroy ? key_destroy : noop_destroy;
+
+    map->value_copy = value_copy ? value_copy : noop_copy;
+    map->value_destroy = value_destroy ? value_destroy : noop_destroy;
+
+    return map;
+}
+
+static void destroy_pending(FlatMap *map)
+{
+    for (size_t i = 0; i < seq_length(map->pending); i++)
+    {
+        PendingEntry *p = seq_at(map->pending, i);
+        map->key_destroy(p->key);
+        map->value_destroy(p->value);
+    }
+    seq_clear(map->pending);
+}
+
+static void destroy_entries(FlatMap *map)
+{
+    for (size_t i = 0; i < seq_length(map->entries); i++)
+    {
+        FlatEntry *e = seq_at(map->entries, i);
+        map->key_destroy(e->key);
+        map->value_destroy(e->value);
+    }
+    seq_clear(map->entries);
+}
+
+void flat_map_destroy(void *_map)
+{
+    FlatMap *map = _map;
+
+    if (map)
+    {
+        destroy_entries(map);
+        destroy_pending(map);
+        seq_destroy(map->entries);
+        seq_destroy(map->pending);
+        alloc_free(&map->allocator, map);
+    }
+}
+
+void flat_map_put(FlatMap *map, const void *key, const void *value)
+{
+    PendingEntry p = { map->key_copy(key), map->value_copy(value), map->next_order++ };
+    seq_append(map->pending, &p);
+}
+
+static int pending_compare(const void *a, const void *b, void *context)
+{
+    const FlatMap *map = context;
+    const PendingEntry *x = a;
+    const PendingEntry *y = b;
+
+    int cmp = map->key_compare(x->key, y->key);
+    if (cmp != 0)
+    {
+        return cmp;
+    }
+    return (x->order > y->order) - (x->order < y->order);
+}
+
+void flat_map_flush(FlatMap *map)
+{
+    size_t pending = seq_length(map->pending);
+    if (pending == 0)
+    {
+        return;
+    }
+
+    seq_sort_r(map->pending, pending_compare, map);
+
+    size_t existing = seq_length(map->entries);
+    // from the map's allocator, whichever one is current now
+    Allocator previous = alloc_set_allocator(&map->allocator);
+    Seq *merged = seq_new_sized(sizeof(FlatEntry), existing + pending, NULL);
+    alloc_set_allocator(&previous);
+    const FlatEntry *a = seq_data(map->entries);
+    const FlatEntry *a_end = a + existing;
+    PendingEntry *b = seq_data(map->pending);
+    PendingEntry *b_end = b + pending;
+
+    while (b < b_end)
+    {
+        // only the latest put of a key survives
+        while (b + 1 < b_end && map->key_compare(b->key, (b + 1)->key) == 0)
+        {
+            map->key_destroy(b->key);
+            map->value_destroy(b->value);
+            b++;
+        }
+
+        while (a < a_end && map->key_compare(a->key, b->key) < 0)
+        {
+            seq_append(merged, (void *)a++);
+        }
+
+        FlatEntry e = { b->key, b->value };
+        if (a < a_end && map->key_compare(a->key, b->key) == 0)
+        {
+            map->key_destroy(b->key);
+            map->value_destroy(a->value);
+            e.key = a->key;
+            a++;
+        }
+        seq_append(merged, &e);
+        b++;
+    }
+    if (a < a_end)
+    {
+        seq_append_n(merged, a, (size_t)(a_end - a));
+    }
+
+    seq_destroy(map->entries);
+    map->entries = merged;
+    seq_clear(map->pending);
+    map->next_order = 0;
+}
+
+static FlatEntry *find(FlatMap *map, const void *key)
+{
+    flat_map_flush(map);
+
+    FlatEntry *base = seq_data(map->entries);
+    size_t n = seq_length(map->entries);
+    if (n == 0)
+    {
+        return NULL;
+    }
+
+    while (n > 1)
+    {
+        size_t half = n / 2;
+        base = map->key_compare(base[half].key, key) <= 0 ? base + half : base;
+        n -= half;
+    }
+
+    return map->key_compare(base->key, key) == 0 ? base : NULL;
+}
+
+void *flat_map_get(FlatMap *map, const void *key)
+{
+    FlatEntry *e = find(map, key);
+    return e ? e->value : NULL;
+}
+
+bool flat_map_contains(FlatMap *map, const void *key)
+{
+    return find(map, key) != NULL;
+}
+
+bool flat_map_remove(FlatMap *map, const void *key)
+{
+    FlatEntry *e = find(map, key);
+    if (!e)
+    {
+        return false;
+    }
+
+    map->key_destroy(e->key);
+    map->value_destroy(e->value);
+    seq_remove_range(map->entries, (size_t)(e - (FlatEntry *)seq_data(map->entries)), 1);
+
+    return true;
+}
+
+void flat_map_clear(FlatMap *map)
+{
+    destroy_entries(map);
+    destroy_pending(map);
+}
+
+size_t flat_map_size(FlatMap *map)
+{
+    flat_map_flush(map);
+    return seq_length(map->entries);
+}
+
+void *flat_map_key_at(FlatMap *map, size_t index)
+{
+    flat_map_flush(map);
+    assert(index < seq_length(map->entries));
+    return ((FlatEntry *)seq_at(map->entries, index))->key;
+}
+
+void *flat_map_value_at(FlatMap *map, size_t index)
+{
+    flat_map_flush(map);
+    assert(index < seq_length(map->entries));
+    return ((FlatEntry *)seq_at(map->entries, index))->value;
+}
@@ -0,0 +1,36 @@
+#ifndef LIBUTILS_FLAT_MAP_H
+#define LIBUTILS_FLAT_MAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * A map kept as one sorted array of key/value pairs. Puts are buffered and
+ * merged in a single sort-and-merge pass by the next call that reads the
+ * map, so build it in batches and query it in between.
+ */
+
+typedef struct FlatMap_ FlatMap;
+
+FlatMap *flat_map_new(void *(*key_copy)(const void *key),
+                      int (*key_compare)(const void *a, const void *b),
+                      void (*key_destroy)(void *key),
+                      void *(*value_copy)(const void *value),
+                      void (*value_destroy)(void *value));
+void flat_map_destroy(void *map);
+
+// a later put of the same key replaces the value
+void flat_map_put(FlatMap *map, const void *key, const void *value);
+void flat_map_flush(FlatMap *map);
+
+void *flat_map_get(FlatMap *map, const void *key);
+bool flat_map_contains(FlatMap *map, const void *key);
+bool flat_map_remove(FlatMap *map, const void *key);
+void flat_map_clear(FlatMap *map);
+size_t flat_map_size(FlatMap *map);
+
+// entries in key order, index < flat_map_size()
+void *flat_map_key_at(FlatMap *map, size_t index);
+void *flat_map_value_at(FlatMap *map, size_t index);
+
+#endif
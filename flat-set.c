@@ -0,0 +1,51 @@
+#include "flat-set.h"
+
+#include "flat-map.h"
+
+#include <assert.h>
+
+FlatSet *flat_set_new(void *(*copy)(const void *), int (*compare)(const void *, const void *), void (*destroy)(void *))
+{
+    return (FlatSet *)flat_map_new(copy, compare, destroy, NULL, NULL);
+}
+
+void flat_set_destroy(void *set)
+{
+    flat_map_destroy(set);
+}
+
+void flat_set_add(FlatSet *set, void *element)
+{
+    assert(element);
+    flat_map_put((FlatMap *)set, element, NULL);
+}
+
+void flat_set_flush(FlatSet *set)
+{
+    flat_map_flush((FlatMap *)set);
+}
+
+bool flat_set_contains(FlatSet *set, const void *element)
+{
+    return flat_map_contains((FlatMap *)set, element);
+}
+
+bool flat_set_remove(FlatSet *set, const void *element)
+{
+    return flat_map_remove((FlatMap *)set, element);
+}
+
+void flat_set_clear(FlatSet *set)
+{
+    flat_map_clear((FlatMap *)set);
+}
+
+size_t flat_set_size(FlatSet *set)
+{
+    return flat_map_size((FlatMap *)set);
+}
+
+void *flat_set_at(FlatSet *set, size_t index)
+{
+    return flat_map_key_at((FlatMap *)set, index);
+}
@@ -0,0 +1,24 @@
+#ifndef LIBUTILS_FLAT_SET_H
+#define LIBUTILS_FLAT_SET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// A Set kept as a sorted array, see flat-map.h for how adds are batched
+typedef struct FlatSet_ FlatSet;
+
+FlatSet *flat_set_new(void *(*copy)(const void *), int (*compare)(const void *, const void *), void (*destroy)(void *));
+void flat_set_destroy(void *set);
+
+void flat_set_add(FlatSet *set, void *element);
+void flat_set_flush(FlatSet *set);
+
+bool flat_set_contains(FlatSet *set, const void *element);
+bool flat_set_remove(FlatSet *set, const void *element);
+void flat_set_clear(FlatSet *set);
+size_t flat_set_size(FlatSet *set);
+
+// elements in order, index < flat_set_size()
+void *flat_set_at(FlatSet *set, size_t index);
+
+#endif
@@ -0,0 +1,229 @@
+#include "frozen-map.h"
+
+#include "alloc.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+#if defined(__GNUC__)
+#define PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define PREFETCH(addr)
+#endif
+
+typedef struct
+{
+    void *key;
+    void *value;
+} FrozenEntry;
+
+/*
+ * Entries are stored in Eytzinger (breadth-first) order, 1-based: the
+ * children of entries[k] are entries[2k] and entries[2k + 1]. The top of
+ * the implicit tree stays hot in cache and the descendants of a node two
+ * levels down share a cache line, so they can be prefetched ahead of the
+ * comparisons.
+ */
+struct FrozenMap_
+{
+    int (*key_compare)(const void *a, const void *b);
+    void (*key_destroy)(void *key);
+    void (*value_destroy)(void *value);
+    Allocator allocator;
+
+    size_t size;
+    FrozenEntry entries[];
+};
+
+struct FrozenMapIterator_
+{
+    const FrozenMap *map;
+    size_t curr;
+    size_t end;
+};
+
+static size_t fill_recursive(FrozenMap *map, void **keys, void **values, size_t i, size_t k)
+{
+    if (k <= map->size)
+    {
+        i = fill_recursive(map, keys, values, i, 2 * k);
+        map->entries[k].key = keys[i];
+        map->entries[k].value = values[i];
+        i++;
+        i = fill_recursive(map, keys, values, i, 2 * k + 1);
+    }
+
+    return i;
+}
+
+FrozenMap *frozen_map_new(void **keys, void **values, size_t size,
+                          int (*key_compare)(const void *a, const void *b),
+                          void (*key_destroy)(void *key),
+                          void (*value_destroy)(void *value))
+{
+    assert(key_compare);
+    assert(size == 0 || (keys && values));
+
+    Allocator allocator = alloc_get_allocator();
+    FrozenMap *map = alloc_malloc(&allocator, sizeof(FrozenMap) + sizeof(FrozenEntry) * (size + 1));
+
+    map->allocator = allocator;
+    map->key_compare = key_compare;
+    map->key_destroy = key_destroy;
+    map->value_destroy = value_destroy;
+    map->size = size;
+    map->entries[0].key = map->entries[0].value = NULL;
+
+    size_t filled = fill_recursive(map, keys, values, 0, 1);
+    assert(filled == size);
+    (void)filled;
+
+    return map;
+}
+
+void frozen_map_destroy(void *_map)
+{
+    FrozenMap *map = _map;
+    if (map)
+    {
+        for (size_t k = 1; k <= map->size; k++)
+        {
+            if (map->key_destroy)
+            {
+                map->key_destroy(map->entries[k].key);
+            }
+            if (map->value_destroy)
+            {
+                map->value_destroy(map->entries[k].value);
+            }
+        }
+
+        alloc_free(&map->allocator, map);
+    }
+}
+
+size_t frozen_map_size(const FrozenMap *map)
+{
+    return map->size;
+}
+
+// index of the first entry not less than key, 0 if there is none
+static size_t lower_bound(const FrozenMap *map, const void *key)
+{
+    size_t k = 1;
+
+    while (k <= map->size)
+    {
+        if (4 * k <= map->size)
+        {
+            PREFETCH(&map->entries[4 * k]);
+        }
+        k = 2 * k + (map->key_compare(map->entries[k].key, key) < 0);
+    }
+
+    // undo the right turns taken after the last left turn
+    while (k & 1)
+    {
+        k >>= 1;
+    }
+
+    return k >> 1;
+}
+
+static size_t entry_next(const FrozenMap *map, size_t k)
+{
+    if (2 * k + 1 <= map->size)
+    {
+        for (k = 2 * k + 1; 2 * k <= map->size; k = 2 * k);
+        return k;
+    }
+
+    while (k & 1)
+    {
+        k >>= 1;
+    }
+
+    return k >> 1;
+}
+
+static size_t entry_first(const FrozenMap *map)
+{
+    if (map->size == 0)
+    {
+        return 0;
+    }
+
+    size_t k;
+    for (k = 1; 2 * k <= map->size; k = 2 * k);
+    return k;
+}
+
+void *frozen_map_get(const FrozenMap *map, const void *key)
+{
+    size_t k = lower_bound(map, key);
+    if (k != 0 && map->key_compare(key, map->entries[k].key) == 0)
+    {
+        return map->entries[k].value;
+    }
+
+    return NULL;
+}
+
+bool frozen_map_contains(const FrozenMap *map, const void *key)
+{
+    size_t k = lower_bound(map, key);
+    return k != 0 && map->key_compare(key, map->entries[k].key) == 0;
+}
+
+FrozenMapIterator *frozen_map_iterator_new(const FrozenMap *map)
+{
+    return frozen_map_iterator_new_range(map, NULL, NULL);
+}
+
+FrozenMapIterator *frozen_map_iterator_new_range(const FrozenMap *map, const void *from, const void *to)
+{
+    FrozenMapIterator *iter = alloc_malloc(&map->allocator, sizeof(FrozenMapIterator));
+
+    iter->map = map;
+    iter->curr = from ? lower_bound(map, from) : entry_first(map);
+    iter->end = to ? lower_bound(map, to) : 0;
+
+    if (from && to && map->key_compare(from, to) >= 0)
+    {
+        iter->curr = 0;
+    }
+
+    return iter;
+}
+
+bool frozen_map_iterator_next(FrozenMapIterator *iter, void **key, void **value)
+{
+    if (iter->curr == 0 || iter->curr == iter->end)
+    {
+        return false;
+    }
+
+    const FrozenEntry *entry = &iter->map->entries[iter->curr];
+
+    if (key)
+    {
+        *key = entry->key;
+    }
+
+    if (value)
+    {
+        *value = entry->value;
+    }
+
+    iter->curr = entry_next(iter->map, iter->curr);
+    return true;
+}
+
+void frozen_map_iterator_destroy(void *_iter)
+{
+    FrozenMapIterator *iter = _iter;
+    if (iter)
+    {
+        alloc_free(&iter->map->allocator, iter);
+    }
+}
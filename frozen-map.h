@@ -0,0 +1,30 @@
+#ifndef LIBUTILS_FROZEN_MAP_H
+#define LIBUTILS_FROZEN_MAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct FrozenMap_ FrozenMap;
+typedef struct FrozenMapIterator_ FrozenMapIterator;
+
+/**
+ * Builds an immutable map from keys sorted in ascending order. The map
+ * takes ownership of the keys and values, but not of the arrays.
+ */
+FrozenMap *frozen_map_new(void **keys, void **values, size_t size,
+                          int (*key_compare)(const void *a, const void *b),
+                          void (*key_destroy)(void *key),
+                          void (*value_destroy)(void *value));
+void frozen_map_destroy(void *map);
+
+size_t frozen_map_size(const FrozenMap *map);
+void *frozen_map_get(const FrozenMap *map, const void *key);
+bool frozen_map_contains(const FrozenMap *map, const void *key);
+
+FrozenMapIterator *frozen_map_iterator_new(const FrozenMap *map);
+// iterates keys in [from, to), a NULL bound is unbounded
+FrozenMapIterator *frozen_map_iterator_new_range(const FrozenMap *map, const void *from, const void *to);
+bool frozen_map_iterator_next(FrozenMapIterator *iter, void **key, void **value);
+void frozen_map_iterator_destroy(void *iter);
+
+#endif
@@ -0,0 +1,346 @@
+#include "id-set.h"
+
+#include "alloc.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// past this size ratio, galloping beats a linear merge
+#define GALLOP_RATIO 32
+
+static size_t intersect_scalar(const uint32_t *a, size_t a_length,
+                               const uint32_t *b, size_t b_length, uint32_t *out)
+{
+    size_t i = 0, j = 0, n = 0;
+
+    while (i < a_length && j < b_length)
+    {
+        uint32_t x = a[i];
+        uint32_t y = b[j];
+        if (x == y)
+        {
+            out[n++] = x;
+        }
+        i += x <= y;
+        j += y <= x;
+    }
+
+    return n;
+}
+
+// Index of the first item of b not less than key, searching from start
+static size_t gallop(const uint32_t *b, size_t b_length, size_t start, uint32_t key)
+{
+    size_t lo = start;
+    size_t step = 1;
+
+    while (lo + step < b_length && b[lo + step] < key)
+    {
+        lo += step;
+        step *= 2;
+    }
+
+    size_t hi = lo + step < b_length ? lo + step : b_length;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (b[mid] < key)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+static size_t intersect_galloping(const uint32_t *a, size_t a_length,
+                                  const uint32_t *b, size_t b_length, uint32_t *out)
+{
+    size_t j = 0, n = 0;
+
+    for (size_t i = 0; i < a_length && j < b_length; i++)
+    {
+        j = gallop(b, b_length, j, a[i]);
+        if (j < b_length && b[j] == a[i])
+        {
+            out[n++] = a[i];
+            j++;
+        }
+    }
+
+    return n;
+}
+
+/*
+ * The block kernels compare every item of a block of a with every item of a
+ * block of b by rotating the b block, then advance whichever block ends
+ * lower. Each ID occurs once per input, so a lane of a matches at most once
+ * and the matches come out in order.
+ */
+#if defined(__AVX2__)
+static size_t intersect_blocks(const uint32_t *a, size_t a_length,
+                               const uint32_t *b, size_t b_length, uint32_t *out, size_t *i_out, size_t *j_out)
+{
+    const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+    size_t i = 0, j = 0, n = 0;
+
+    while (i + 8 <= a_length && j + 8 <= b_length)
+    {
+        __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b + j));
+        __m256i cmp = _mm256_cmpeq_epi32(va, vb);
+
+        for (int r = 1; r < 8; r++)
+        {
+            vb = _mm256_permutevar8x32_epi32(vb, rotate);
+            cmp = _mm256_or_si256(cmp, _mm256_cmpeq_epi32(va, vb));
+        }
+
+        unsigned int mask = _mm256_movemask_ps(_mm256_castsi256_ps(cmp));
+        while (mask)
+        {
+            out[n++] = a[i + __builtin_ctz(mask)];
+            mask &= mask - 1;
+        }
+
+        uint32_t a_max = a[i + 7];
+        uint32_t b_max = b[j + 7];
+        i += a_max <= b_max ? 8 : 0;
+        j += b_max <= a_max ? 8 : 0;
+    }
+
+    *i_out = i;
+    *j_out = j;
+    return n;
+}
+#elif defined(__SSE2__)
+static size_t intersect_blocks(const uint32_t *a, size_t a_length,
+                               const uint32_t *b, size_t b_length, uint32_t *out, size_t *i_out, size_t *j_out)
+{
+    size_t i = 0, j = 0, n = 0;
+
+    while (i + 4 <= a_length && j + 4 <= b_length)
+    {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + j));
+        __m128i cmp = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+
+        unsigned int mask = _mm_movemask_ps(_mm_castsi128_ps(cmp));
+        while (mask)
+        {
+            out[n++] = a[i + __builtin_ctz(mask)];
+            mask &= mask - 1;
+        }
+
+        uint32_t a_max = a[i + 3];
+        uint32_t b_max = b[j + 3];
+        i += a_max <= b_max ? 4 : 0;
+        j += b_max <= a_max ? 4 : 0;
+    }
+
+    *i_out = i;
+    *j_out = j;
+    return n;
+}
+#endif
+
+size_t id_set_intersect(const uint32_t *a, size_t a_length,
+                        const uint32_t *b, size_t b_length, uint32_t *out)
+{
+    if (a_length > b_length)
+    {
+        const uint32_t *t = a;
+        a = b;
+        b = t;
+        size_t l = a_length;
+        a_length = b_length;
+        b_length = l;
+    }
+
+    if (a_length == 0)
+    {
+        return 0;
+    }
+    if (b_length / a_length >= GALLOP_RATIO)
+    {
+        return intersect_galloping(a, a_length, b, b_length, out);
+    }
+
+#if defined(__SSE2__) || defined(__AVX2__)
+    size_t i, j;
+    size_t n = intersect_blocks(a, a_length, b, b_length, out, &i, &j);
+    return n + intersect_scalar(a + i, a_length - i, b + j, b_length - j, out + n);
+#else
+    return intersect_scalar(a, a_length, b, b_length, out);
+#endif
+}
+
+static size_t union_two(const uint32_t *a, size_t a_length,
+                        const uint32_t *b, size_t b_length, uint32_t *out)
+{
+    size_t i = 0, j = 0, n = 0;
+
+    while (i < a_length && j < b_length)
+    {
+        uint32_t x = a[i];
+        uint32_t y = b[j];
+        out[n++] = x < y ? x : y;
+        i += x <= y;
+        j += y <= x;
+    }
+    memcpy(out + n, a + i, sizeof(uint32_t) * (a_length - i));
+    n += a_length - i;
+    memcpy(out + n, b + j, sizeof(uint32_t) * (b_length - j));
+    n += b_length - j;
+
+    return n;
+}
+
+// above any ID, marks an exhausted input
+#define EXHAUSTED UINT64_MAX
+
+size_t id_set_union(const uint32_t *const *sets, const size_t *lengths, size_t count, uint32_t *out)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    if (count == 1)
+    {
+        memcpy(out, sets[0], sizeof(uint32_t) * lengths[0]);
+        return lengths[0];
+    }
+    if (count == 2)
+    {
+        return union_two(sets[0], lengths[0], sets[1], lengths[1], out);
+    }
+
+    size_t leaves = 1;
+    while (leaves < count)
+    {
+        leaves *= 2;
+    }
+
+    // a tournament over the inputs' heads: tree[0] holds the winner, every
+    // internal node the loser of the match played there
+    size_t *cursors = xcalloc(leaves, sizeof(size_t));
+    uint64_t *heads = xmalloc(sizeof(uint64_t) * leaves);
+    size_t *tree = xmalloc(sizeof(size_t) * leaves);
+    size_t *winners = xmalloc(sizeof(size_t) * 2 * leaves);
+
+    for (size_t s = 0; s < leaves; s++)
+    {
+        heads[s] = s < count && lengths[s] > 0 ? sets[s][0] : EXHAUSTED;
+        winners[leaves + s] = s;
+    }
+    for (size_t node = leaves - 1; node >= 1; node--)
+    {
+        size_t l = winners[2 * node];
+        size_t r = winners[2 * node + 1];
+        bool left_wins = heads[l] <= heads[r];
+        winners[node] = left_wins ? l : r;
+        tree[node] = left_wins ? r : l;
+    }
+    tree[0] = winners[1];
+    xfree(winners);
+
+    size_t n = 0;
+    for (;;)
+    {
+        size_t winner = tree[0];
+        uint64_t head = heads[winner];
+        if (head == EXHAUSTED)
+        {
+            break;
+        }
+        if (n == 0 || out[n - 1] != head)
+        {
+            out[n++] = (uint32_t)head;
+        }
+
+        size_t c = ++cursors[winner];
+        heads[winner] = c < lengths[winner] ? sets[winner][c] : EXHAUSTED;
+
+        // replay the winner's path to the root
+        for (size_t node = (leaves + winner) / 2; node >= 1; node /= 2)
+        {
+            if (heads[tree[node]] < heads[winner])
+            {
+                size_t t = tree[node];
+                tree[node] = winner;
+                winner = t;
+            }
+        }
+        tree[0] = winner;
+    }
+
+    xfree(cursors);
+    xfree(heads);
+    xfree(tree);
+    return n;
+}
+
+static void check_ids(const Seq *seq)
+{
+    assert(seq_is_sized(seq) && seq_elem_size(seq) == sizeof(uint32_t));
+    (void)seq;
+}
+
+void id_set_intersect_seq(Seq *out, const Seq *a, const Seq *b)
+{
+    check_ids(out);
+    check_ids(a);
+    check_ids(b);
+
+    size_t a_length = seq_length(a);
+    size_t b_length = seq_length(b);
+    size_t capacity = a_length < b_length ? a_length : b_length;
+    uint32_t *ids = xmalloc(sizeof(uint32_t) * (capacity > 0 ? capacity : 1));
+
+    size_t n = id_set_intersect(seq_data(a), a_length, seq_data(b), b_length, ids);
+    seq_append_n(out, ids, n);
+
+    xfree(ids);
+}
+
+void id_set_union_seq(Seq *out, const Seq *const *seqs, size_t count)
+{
+    check_ids(out);
+
+    const uint32_t **sets = xmalloc(sizeof(uint32_t *) * (count > 0 ? count : 1));
+    size_t *lengths = xmalloc(sizeof(size_t) * (count > 0 ? count : 1));
+    size_t total = 0;
+
+    for (size_t s = 0; s < count; s++)
+    {
+        check_ids(seqs[s]);
+        sets[s] = seq_data(seqs[s]);
+        lengths[s] = seq_length(seqs[s]);
+        total += lengths[s];
+    }
+
+    uint32_t *ids = xmalloc(sizeof(uint32_t) * (total > 0 ? total : 1));
+    size_t n = id_set_union(sets, lengths, count, ids);
+    seq_append_n(out, ids, n);
+
+    xfree(ids);
+    xfree(lengths);
+    xfree(sets);
+}
@@ -0,0 +1,31 @@
+#ifndef LIBUTILS_ID_SET_H
+#define LIBUTILS_ID_SET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "seq.h"
+
+/*
+ * Set operations on strictly increasing arrays of 32-bit IDs. The Seq
+ * variants take sized Seqs of uint32_t and append their result to out.
+ */
+
+/**
+ * Writes the common IDs to out, which must hold the smaller input, and
+ * returns how many. Gallops through the larger input when the sizes are
+ * far apart, otherwise compares blocks with SSE2 or AVX2 where available.
+ */
+size_t id_set_intersect(const uint32_t *a, size_t a_length,
+                        const uint32_t *b, size_t b_length, uint32_t *out);
+
+/**
+ * Merges count inputs with a loser tree, writing each ID once to out,
+ * which must hold all of them, and returns how many.
+ */
+size_t id_set_union(const uint32_t *const *sets, const size_t *lengths, size_t count, uint32_t *out);
+
+void id_set_intersect_seq(Seq *out, const Seq *a, const Seq *b);
+void id_set_union_seq(Seq *out, const Seq *const *seqs, size_t count);
+
+#endif
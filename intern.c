@@ -0,0 +1,261 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "intern.h"
+
+#include "alloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+// a power of two; the top bits of the hash pick the shard
+#define SHARD_BITS 4
+#define SHARDS (1 << SHARD_BITS)
+#define INITIAL_BUCKETS 64
+
+typedef struct Entry_
+{
+    struct Entry_ *next;
+    uint64_t hash;
+    // the first 8 bytes big-endian, zero padded, so that integer order
+    // matches byte order
+    uint64_t prefix;
+    size_t length;
+    size_t refs;
+    char chars[];
+} Entry;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    Entry **buckets;
+    size_t bucket_count;
+    size_t count;
+} Shard;
+
+struct InternPool_
+{
+    bool refcounted;
+    Allocator allocator;
+    Shard shards[SHARDS];
+};
+
+static const Entry *entry_of(const void *handle)
+{
+    return (const Entry *)((const char *)handle - offsetof(Entry, chars));
+}
+
+static uint64_t hash_bytes(const unsigned char *p, size_t length)
+{
+    uint64_t h = 0xcbf29ce484222325ULL ^ length;
+    uint64_t w;
+
+    for (; length >= 8; p += 8, length -= 8)
+    {
+        memcpy(&w, p, 8);
+        h = (h ^ w) * 0x9fb21c651e98df25ULL;
+        h ^= h >> 29;
+    }
+    w = 0;
+    memcpy(&w, p, length);
+    h = (h ^ w) * 0x9fb21c651e98df25ULL;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+InternPool *intern_pool_new(bool refcounted)
+{
+    Allocator allocator = alloc_get_allocator();
+    InternPool *pool = alloc_malloc(&allocator, sizeof(InternPool));
+    pool->refcounted = refcounted;
+    pool->allocator = allocator;
+
+    for (int i = 0; i < SHARDS; i++)
+    {
+        Shard *shard = &pool->shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->buckets = alloc_calloc(&allocator, INITIAL_BUCKETS, sizeof(Entry *));
+        shard->bucket_count = INITIAL_BUCKETS;
+        shard->count = 0;
+    }
+
+    return pool;
+}
+
+void intern_pool_destroy(InternPool *pool)
+{
+    if (pool)
+    {
+        for (int i = 0; i < SHARDS; i++)
+        {
+            Shard *shard = &pool->shards[i];
+            for (size_t b = 0; b < shard->bucket_count; b++)
+            {
+                Entry *entry = shard->buckets[b];
+                while (entry)
+                {
+                    Entry *next = entry->next;
+                    alloc_free(&pool->allocator, entry);
+                    entry = next;
+                }
+            }
+            alloc_free(&pool->allocator, shard->buckets);
+            pthread_mutex_destroy(&shard->lock);
+        }
+        Allocator allocator = pool->allocator;
+        alloc_free(&allocator, pool);
+    }
+}
+
+size_t intern_pool_size(InternPool *pool)
+{
+    size_t size = 0;
+    for (int i = 0; i < SHARDS; i++)
+    {
+        pthread_mutex_lock(&pool->shards[i].lock);
+        size += pool->shards[i].count;
+        pthread_mutex_unlock(&pool->shards[i].lock);
+    }
+    return size;
+}
+
+static void shard_grow(InternPool *pool, Shard *shard)
+{
+    size_t bucket_count = shard->bucket_count * 2;
+    Entry **buckets = alloc_calloc(&pool->allocator, bucket_count, sizeof(Entry *));
+
+    for (size_t b = 0; b < shard->bucket_count; b++)
+    {
+        Entry *entry = shard->buckets[b];
+        while (entry)
+        {
+            Entry *next = entry->next;
+            size_t index = entry->hash & (bucket_count - 1);
+            entry->next = buckets[index];
+            buckets[index] = entry;
+            entry = next;
+        }
+    }
+
+    alloc_free(&pool->allocator, shard->buckets);
+    shard->buckets = buckets;
+    shard->bucket_count = bucket_count;
+}
+
+const char *intern_bytes(InternPool *pool, const void *data, size_t length)
+{
+    uint64_t hash = hash_bytes(data, length);
+    Shard *shard = &pool->shards[hash >> (64 - SHARD_BITS)];
+
+    pthread_mutex_lock(&shard->lock);
+
+    Entry **bucket = &shard->buckets[hash & (shard->bucket_count - 1)];
+    for (Entry *entry = *bucket; entry; entry = entry->next)
+    {
+        if (entry->hash == hash && entry->length == length && memcmp(entry->chars, data, length) == 0)
+        {
+            entry->refs++;
+            pthread_mutex_unlock(&shard->lock);
+            return entry->chars;
+        }
+    }
+
+    Entry *entry = alloc_malloc(&pool->allocator, sizeof(Entry) + length + 1);
+    entry->hash = hash;
+    entry->length = length;
+    entry->refs = 1;
+    memcpy(entry->chars, data, length);
+    entry->chars[length] = '\0';
+
+    entry->prefix = 0;
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < 8; i++)
+    {
+        entry->prefix = (entry->prefix << 8) | (i < length ? bytes[i] : 0);
+    }
+
+    entry->next = *bucket;
+    *bucket = entry;
+    if (++shard->count > shard->bucket_count)
+    {
+        shard_grow(pool, shard);
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+    return entry->chars;
+}
+
+const char *intern_string(InternPool *pool, const char *s)
+{
+    return intern_bytes(pool, s, strlen(s));
+}
+
+void intern_release(InternPool *pool, const char *handle)
+{
+    if (!pool->refcounted)
+    {
+        return;
+    }
+
+    const Entry *target = entry_of(handle);
+    Shard *shard = &pool->shards[target->hash >> (64 - SHARD_BITS)];
+
+    pthread_mutex_lock(&shard->lock);
+
+    Entry **link = &shard->buckets[target->hash & (shard->bucket_count - 1)];
+    while (*link != target)
+    {
+        assert(*link);
+        link = &(*link)->next;
+    }
+
+    Entry *entry = *link;
+    if (--entry->refs == 0)
+    {
+        *link = entry->next;
+        shard->count--;
+        alloc_free(&pool->allocator, entry);
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+}
+
+size_t intern_length(const char *handle)
+{
+    return entry_of(handle)->length;
+}
+
+uint64_t intern_hash(const void *handle)
+{
+    return entry_of(handle)->hash;
+}
+
+int intern_compare(const void *a, const void *b)
+{
+    if (a == b)
+    {
+        return 0;
+    }
+
+    const Entry *x = entry_of(a);
+    const Entry *y = entry_of(b);
+    if (x->prefix != y->prefix)
+    {
+        return x->prefix < y->prefix ? -1 : 1;
+    }
+
+    size_t common = x->length < y->length ? x->length : y->length;
+    if (common > 8)
+    {
+        int cmp = memcmp(x->chars + 8, y->chars + 8, common - 8);
+        if (cmp != 0)
+        {
+            return cmp;
+        }
+    }
+    return (x->length > y->length) - (x->length < y->length);
+}
@@ -0,0 +1,41 @@
+#ifndef LIBUTILS_INTERN_H
+#define LIBUTILS_INTERN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A thread-safe pool of canonical strings. Interning equal bytes twice
+ * gives the same handle, so handles from one pool are equal exactly when
+ * they are the same pointer. A handle is a NUL-terminated const char *
+ * that also carries its length, hash and an ordering key.
+ *
+ * For an RBTree or Set of handles, pass intern_compare as the key compare
+ * and no copy or destroy: the tree then orders by a precomputed key and
+ * only falls back to memcmp for strings sharing their first 8 bytes.
+ */
+
+typedef struct InternPool_ InternPool;
+
+/**
+ * With refcounted set, every intern call takes a reference that
+ * intern_release gives back, and a string is freed with its last one.
+ * Otherwise strings live as long as the pool.
+ */
+InternPool *intern_pool_new(bool refcounted);
+void intern_pool_destroy(InternPool *pool);
+// Distinct strings in the pool
+size_t intern_pool_size(InternPool *pool);
+
+const char *intern_string(InternPool *pool, const char *s);
+const char *intern_bytes(InternPool *pool, const void *data, size_t length);
+void intern_release(InternPool *pool, const char *handle);
+
+size_t intern_length(const char *handle);
+// Takes const void * so it can serve as the hash of set_new_filtered
+uint64_t intern_hash(const void *handle);
+// Bytewise order, a shorter string before any string it prefixes
+int intern_compare(const void *a, const void *b);
+
+#endif
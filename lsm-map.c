@@ -0,0 +1,741 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "lsm-map.h"
+
+#include "alloc.h"
+#include "bloom.h"
+#include "map-file.h"
+#include "rb-tree.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define MAX_RUNS 8
+// approximate memtable bytes per entry beyond the key and value
+#define ENTRY_OVERHEAD 64
+
+#define BLOOM_FALSE_POSITIVE_RATE 0.01
+
+#define TAG_VALUE 0
+#define TAG_TOMBSTONE 1
+
+typedef struct
+{
+    size_t size;
+    bool tombstone;
+    const unsigned char *data;
+} Bytes;
+
+typedef struct
+{
+    uint64_t lo;
+    uint64_t hi;
+    char *path;
+    MapFile *file;
+    Bloom *bloom;
+} Run;
+
+struct LSMMap_
+{
+    char *dir;
+    size_t memtable_limit;
+    RBTree *memtable;
+    size_t memtable_bytes;
+
+    // oldest first
+    Run *runs;
+    size_t run_count;
+    size_t run_capacity;
+    uint64_t next_id;
+
+    unsigned char *scratch;
+    size_t scratch_capacity;
+
+    // installed for every call that allocates, keys and runs included
+    Allocator allocator;
+};
+
+typedef struct
+{
+    RBTreeIterator *memtable;
+    MapFileIterator *run;
+
+    bool valid;
+    const void *key;
+    size_t key_size;
+    const void *value;
+    size_t value_size;
+    bool tombstone;
+} MergeSource;
+
+// sources are ordered newest first, so the first of equal keys wins
+typedef struct
+{
+    MergeSource *sources;
+    size_t count;
+} Merge;
+
+struct LSMMapIterator_
+{
+    const LSMMap *map;
+    Merge merge;
+};
+
+static void *bytes_copy(const void *_b)
+{
+    const Bytes *b = _b;
+    Bytes *copy = xmalloc(sizeof(Bytes) + b->size + 1);
+    unsigned char *data = (unsigned char *)(copy + 1);
+
+    if (b->size > 0)
+    {
+        memcpy(data, b->data, b->size);
+    }
+    copy->size = b->size;
+    copy->tombstone = b->tombstone;
+    copy->data = data;
+
+    return copy;
+}
+
+static int bytes_compare(const void *_a, const void *_b)
+{
+    const Bytes *a = _a, *b = _b;
+    return map_file_key_compare(a->data, a->size, b->data, b->size);
+}
+
+static char *run_path(const LSMMap *map, uint64_t lo, uint64_t hi)
+{
+    size_t size = strlen(map->dir) + 64;
+    char *path = xmalloc(size);
+    snprintf(path, size, "%s/run-%016llx-%016llx.map", map->dir,
+             (unsigned long long)lo, (unsigned long long)hi);
+    return path;
+}
+
+static bool run_open(Run *run, char *path, uint64_t lo, uint64_t hi)
+{
+    run->file = map_file_open(path);
+    if (!run->file)
+    {
+        xfree(path);
+        return false;
+    }
+
+    run->path = path;
+    run->lo = lo;
+    run->hi = hi;
+
+    run->bloom = bloom_new(map_file_size(run->file), BLOOM_FALSE_POSITIVE_RATE);
+
+    MapFileIterator *iter = map_file_iterator_new(run->file);
+    const void *key;
+    size_t key_size;
+    while (map_file_iterator_next(iter, &key, &key_size, NULL, NULL))
+    {
+        bloom_add(run->bloom, bloom_hash_bytes(key, key_size));
+    }
+    map_file_iterator_destroy(iter);
+
+    return true;
+}
+
+static void run_close(Run *run)
+{
+    map_file_close(run->file);
+    bloom_destroy(run->bloom);
+    xfree(run->path);
+}
+
+static void runs_append(LSMMap *map, const Run *run)
+{
+    if (map->run_count == map->run_capacity)
+    {
+        map->run_capacity = map->run_capacity ? map->run_capacity * 2 : MAX_RUNS * 2;
+        map->runs = xrealloc(map->runs, sizeof(Run) * map->run_capacity);
+    }
+
+    map->runs[map->run_count++] = *run;
+}
+
+static int run_order(const void *_a, const void *_b)
+{
+    const Run *a = _a, *b = _b;
+    return (a->hi > b->hi) - (a->hi < b->hi);
+}
+
+static void source_advance(MergeSource *source)
+{
+    if (source->memtable)
+    {
+        void *key, *value;
+        source->valid = rbtree_iterator_next(source->memtable, &key, &value);
+        if (source->valid)
+        {
+            const Bytes *k = key, *v = value;
+            source->key = k->data;
+            source->key_size = k->size;
+            source->value = v->data;
+            source->value_size = v->size;
+            source->tombstone = v->tombstone;
+        }
+    }
+    else
+    {
+        const void *value;
+        size_t value_size;
+        source->valid = map_file_iterator_next(source->run, &source->key, &source->key_size,
+                                               &value, &value_size);
+        if (source->valid)
+        {
+            assert(value_size >= 1);
+            source->tombstone = *(const unsigned char *)value == TAG_TOMBSTONE;
+            source->value = (const unsigned char *)value + 1;
+            source->value_size = value_size - 1;
+        }
+    }
+}
+
+// merges runs[start, end) and the memtable if given, newest first
+static void merge_init(Merge *merge, const LSMMap *map, bool memtable, size_t start, size_t end)
+{
+    merge->count = (end - start) + (memtable ? 1 : 0);
+    merge->sources = xcalloc(merge->count + 1, sizeof(MergeSource));
+
+    size_t i = 0;
+    if (memtable)
+    {
+        merge->sources[i++].memtable = rbtree_iterator_new(map->memtable);
+    }
+    for (size_t r = end; r > start; r--)
+    {
+        merge->sources[i++].run = map_file_iterator_new(map->runs[r - 1].file);
+    }
+
+    for (i = 0; i < merge->count; i++)
+    {
+        source_advance(&merge->sources[i]);
+    }
+}
+
+static void merge_destroy(Merge *merge)
+{
+    for (size_t i = 0; i < merge->count; i++)
+    {
+        rbtree_iterator_destroy(merge->sources[i].memtable);
+        map_file_iterator_destroy(merge->sources[i].run);
+    }
+    xfree(merge->sources);
+}
+
+static bool merge_next(Merge *merge, MergeSource *out)
+{
+    MergeSource *min = NULL;
+
+    for (size_t i = 0; i < merge->count; i++)
+    {
+        MergeSource *s = &merge->sources[i];
+        if (s->valid && (!min || map_file_key_compare(s->key, s->key_size, min->key, min->key_size) < 0))
+        {
+            min = s;
+        }
+    }
+
+    if (!min)
+    {
+        return false;
+    }
+
+    *out = *min;
+
+    // drop the shadowed versions of the key from older sources
+    for (size_t i = 0; i < merge->count; i++)
+    {
+        MergeSource *s = &merge->sources[i];
+        if (s->valid && map_file_key_compare(s->key, s->key_size, out->key, out->key_size) == 0)
+        {
+            source_advance(s);
+        }
+    }
+
+    return true;
+}
+
+static bool write_record(LSMMap *map, MapFileWriter *writer, const MergeSource *record)
+{
+    size_t size = record->value_size + 1;
+    if (size > map->scratch_capacity)
+    {
+        map->scratch_capacity = size;
+        map->scratch = xrealloc(map->scratch, size);
+    }
+
+    map->scratch[0] = record->tombstone ? TAG_TOMBSTONE : TAG_VALUE;
+    if (record->value_size > 0)
+    {
+        memcpy(map->scratch + 1, record->value, record->value_size);
+    }
+
+    return map_file_writer_add(writer, record->key, record->key_size, map->scratch, size);
+}
+
+// writes the merge of the memtable or of runs[start, end) as a new run
+static bool write_run(LSMMap *map, bool memtable, size_t start, size_t end,
+                      uint64_t lo, uint64_t hi, bool drop_tombstones)
+{
+    char *path = run_path(map, lo, hi);
+    MapFileWriter *writer = map_file_writer_new(path);
+    if (!writer)
+    {
+        xfree(path);
+        return false;
+    }
+
+    Merge merge;
+    MergeSource record;
+    bool ok = true;
+    size_t written = 0;
+
+    merge_init(&merge, map, memtable, start, end);
+    while (ok && merge_next(&merge, &record))
+    {
+        if (!(drop_tombstones && record.tombstone))
+        {
+            ok = write_record(map, writer, &record);
+            written++;
+        }
+    }
+    merge_destroy(&merge);
+
+    if (!ok)
+    {
+        map_file_writer_abort(writer);
+        xfree(path);
+        return false;
+    }
+
+    if (!map_file_writer_close(writer))
+    {
+        xfree(path);
+        return false;
+    }
+
+    Run run;
+    bool have_run = written > 0;
+    if (have_run)
+    {
+        if (!run_open(&run, path, lo, hi))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        // every key in the merged runs was deleted
+        unlink(path);
+        xfree(path);
+    }
+
+    // the new run replaces runs[start, end)
+    for (size_t i = start; i < end; i++)
+    {
+        unlink(map->runs[i].path);
+        run_close(&map->runs[i]);
+    }
+    if (end > start)
+    {
+        memmove(&map->runs[start], &map->runs[end], sizeof(Run) * (map->run_count - end));
+        map->run_count -= end - start;
+    }
+
+    if (have_run)
+    {
+        runs_append(map, &run);
+        qsort(map->runs, map->run_count, sizeof(Run), run_order);
+    }
+
+    return true;
+}
+
+static bool compact_runs(LSMMap *map, size_t start)
+{
+    size_t end = map->run_count;
+    if (end - start < 2)
+    {
+        return true;
+    }
+
+    return write_run(map, false, start, end, map->runs[start].lo, map->runs[end - 1].hi, start == 0);
+}
+
+// merges the newest runs whose combined size reaches the next older run
+static bool maybe_compact(LSMMap *map)
+{
+    if (map->run_count <= MAX_RUNS)
+    {
+        return true;
+    }
+
+    size_t start = map->run_count - 1;
+    size_t total = map_file_size(map->runs[start].file);
+    while (start > 0 && map_file_size(map->runs[start - 1].file) <= total)
+    {
+        start--;
+        total += map_file_size(map->runs[start].file);
+    }
+
+    if (map->run_count - start < 2)
+    {
+        start = map->run_count - 2;
+    }
+
+    return compact_runs(map, start);
+}
+
+// also matches the temporary file a run is written to, setting *tmp
+static bool parse_run_name(const char *name, uint64_t *lo, uint64_t *hi, bool *tmp)
+{
+    unsigned long long l, h;
+    int consumed = 0;
+
+    if (sscanf(name, "run-%16llx-%16llx.map%n", &l, &h, &consumed) != 2 || consumed == 0)
+    {
+        return false;
+    }
+
+    *tmp = strcmp(name + consumed, ".tmp") == 0;
+    if (name[consumed] != '\0' && !*tmp)
+    {
+        return false;
+    }
+
+    *lo = l;
+    *hi = h;
+    return true;
+}
+
+static bool load_runs(LSMMap *map)
+{
+    DIR *dir = opendir(map->dir);
+    if (!dir)
+    {
+        return false;
+    }
+
+    Run *found = NULL;
+    size_t found_count = 0, found_capacity = 0;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)))
+    {
+        uint64_t lo, hi;
+        bool tmp;
+        if (!parse_run_name(entry->d_name, &lo, &hi, &tmp))
+        {
+            continue;
+        }
+
+        // left by a flush or merge interrupted before its rename
+        if (tmp)
+        {
+            size_t size = strlen(map->dir) + strlen(entry->d_name) + 2;
+            char *path = xmalloc(size);
+            snprintf(path, size, "%s/%s", map->dir, entry->d_name);
+            unlink(path);
+            xfree(path);
+            continue;
+        }
+
+        if (found_count == found_capacity)
+        {
+            found_capacity = found_capacity ? found_capacity * 2 : 16;
+            found = xrealloc(found, sizeof(Run) * found_capacity);
+        }
+        found[found_count].lo = lo;
+        found[found_count].hi = hi;
+        found_count++;
+    }
+    closedir(dir);
+
+    bool ok = true;
+    for (size_t i = 0; i < found_count; i++)
+    {
+        char *path = run_path(map, found[i].lo, found[i].hi);
+
+        // inputs of a merge interrupted before they were unlinked
+        bool covered = false;
+        for (size_t j = 0; j < found_count; j++)
+        {
+            if (j != i && found[j].lo <= found[i].lo && found[i].hi <= found[j].hi)
+            {
+                covered = true;
+            }
+        }
+
+        if (covered)
+        {
+            unlink(path);
+            xfree(path);
+            continue;
+        }
+
+        Run run;
+        if (!run_open(&run, path, found[i].lo, found[i].hi))
+        {
+            ok = false;
+            break;
+        }
+        runs_append(map, &run);
+
+        if (found[i].hi >= map->next_id)
+        {
+            map->next_id = found[i].hi + 1;
+        }
+    }
+    xfree(found);
+
+    if (map->run_count > 1)
+    {
+        qsort(map->runs, map->run_count, sizeof(Run), run_order);
+    }
+    return ok;
+}
+
+LSMMap *lsm_map_open(const char *dir, size_t memtable_limit)
+{
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+    {
+        return NULL;
+    }
+
+    LSMMap *map = xcalloc(1, sizeof(LSMMap));
+    map->allocator = alloc_get_allocator();
+    map->dir = xmemdup(dir, strlen(dir) + 1);
+    map->memtable_limit = memtable_limit;
+    map->memtable = rbtree_new(bytes_copy, bytes_compare, xfree, bytes_copy, bytes_compare, xfree);
+
+    if (!load_runs(map))
+    {
+        lsm_map_close(map);
+        return NULL;
+    }
+
+    return map;
+}
+
+static bool flush(LSMMap *map)
+{
+    if (rbtree_size(map->memtable) == 0)
+    {
+        return true;
+    }
+
+    uint64_t id = map->next_id++;
+    if (!write_run(map, true, map->run_count, map->run_count, id, id, false))
+    {
+        return false;
+    }
+
+    rbtree_clear(map->memtable);
+    map->memtable_bytes = 0;
+
+    return maybe_compact(map);
+}
+
+bool lsm_map_close(LSMMap *map)
+{
+    if (!map)
+    {
+        return true;
+    }
+
+    Allocator previous = alloc_set_allocator(&map->allocator);
+    bool ok = flush(map);
+
+    for (size_t i = 0; i < map->run_count; i++)
+    {
+        run_close(&map->runs[i]);
+    }
+
+    rbtree_destroy(map->memtable);
+    xfree(map->runs);
+    xfree(map->scratch);
+    xfree(map->dir);
+    xfree(map);
+
+    alloc_set_allocator(&previous);
+    return ok;
+}
+
+static bool memtable_put(LSMMap *map, const void *key, size_t key_size,
+                         const void *value, size_t value_size, bool tombstone)
+{
+    const Bytes k = { key_size, false, key };
+    const Bytes v = { value_size, tombstone, value };
+
+    const Bytes *old = rbtree_get(map->memtable, &k);
+    if (old)
+    {
+        map->memtable_bytes -= old->size;
+    }
+    else
+    {
+        map->memtable_bytes += key_size + ENTRY_OVERHEAD;
+    }
+    map->memtable_bytes += value_size;
+
+    rbtree_put(map->memtable, &k, &v);
+
+    if (map->memtable_bytes >= map->memtable_limit)
+    {
+        return flush(map);
+    }
+
+    return true;
+}
+
+bool lsm_map_put(LSMMap *map, const void *key, size_t key_size, const void *value, size_t value_size)
+{
+    Allocator previous = alloc_set_allocator(&map->allocator);
+    bool ok = memtable_put(map, key, key_size, value, value_size, false);
+    alloc_set_allocator(&previous);
+    return ok;
+}
+
+bool lsm_map_remove(LSMMap *map, const void *key, size_t key_size)
+{
+    Allocator previous = alloc_set_allocator(&map->allocator);
+    bool ok = memtable_put(map, key, key_size, NULL, 0, true);
+    alloc_set_allocator(&previous);
+    return ok;
+}
+
+const void *lsm_map_get(const LSMMap *map, const void *key, size_t key_size, size_t *value_size)
+{
+    const Bytes k = { key_size, false, key };
+
+    const Bytes *v = rbtree_get(map->memtable, &k);
+    if (v)
+    {
+        if (v->tombstone)
+        {
+            return NULL;
+        }
+        if (value_size)
+        {
+            *value_size = v->size;
+        }
+        return v->data;
+    }
+
+    uint64_t hash = bloom_hash_bytes(key, key_size);
+    for (size_t i = map->run_count; i > 0; i--)
+    {
+        const Run *run = &map->runs[i - 1];
+        if (!bloom_may_contain(run->bloom, hash))
+        {
+            continue;
+        }
+
+        size_t size;
+        const unsigned char *record = map_file_get(run->file, key, key_size, &size);
+        if (record)
+        {
+            assert(size >= 1);
+            if (record[0] == TAG_TOMBSTONE)
+            {
+                return NULL;
+            }
+            if (value_size)
+            {
+                *value_size = size - 1;
+            }
+            return record + 1;
+        }
+    }
+
+    return NULL;
+}
+
+bool lsm_map_flush(LSMMap *map)
+{
+    Allocator previous = alloc_set_allocator(&map->allocator);
+    bool ok = flush(map);
+    alloc_set_allocator(&previous);
+    return ok;
+}
+
+bool lsm_map_compact(LSMMap *map)
+{
+    Allocator previous = alloc_set_allocator(&map->allocator);
+    bool ok = flush(map) && compact_runs(map, 0);
+    alloc_set_allocator(&previous);
+    return ok;
+}
+
+size_t lsm_map_run_count(const LSMMap *map)
+{
+    return map->run_count;
+}
+
+LSMMapIterator *lsm_map_iterator_new(const LSMMap *map)
+{
+    Allocator previous = alloc_set_allocator(&map->allocator);
+    LSMMapIterator *iter = xmalloc(sizeof(LSMMapIterator));
+    iter->map = map;
+    merge_init(&iter->merge, map, true, 0, map->run_count);
+    alloc_set_allocator(&previous);
+    return iter;
+}
+
+bool lsm_map_iterator_next(LSMMapIterator *iter, const void **key, size_t *key_size,
+                           const void **value, size_t *value_size)
+{
+    MergeSource record;
+
+    do
+    {
+        if (!merge_next(&iter->merge, &record))
+        {
+            return false;
+        }
+    } while (record.tombstone);
+
+    if (key)
+    {
+        *key = record.key;
+    }
+    if (key_size)
+    {
+        *key_size = record.key_size;
+    }
+    if (value)
+    {
+        *value = record.value;
+    }
+    if (value_size)
+    {
+        *value_size = record.value_size;
+    }
+
+    return true;
+}
+
+void lsm_map_iterator_destroy(void *_iter)
+{
+    LSMMapIterator *iter = _iter;
+    if (iter)
+    {
+        Allocator previous = alloc_set_allocator(&iter->map->allocator);
+        merge_destroy(&iter->merge);
+        xfree(iter);
+        alloc_set_allocator(&previous);
+    }
+}
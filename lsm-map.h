@@ -0,0 +1,36 @@
+#ifndef LIBUTILS_LSM_MAP_H
+#define LIBUTILS_LSM_MAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * A write-optimized byte-string map kept in a directory. Writes go to an
+ * in-memory RBTree; once it holds memtable_limit bytes it is flushed to an
+ * immutable sorted run (a MapFile), and runs are merged as they pile up.
+ *
+ * Pointers returned by get and by iterators stay valid until the next
+ * put, remove, flush or compaction.
+ */
+
+typedef struct LSMMap_ LSMMap;
+typedef struct LSMMapIterator_ LSMMapIterator;
+
+LSMMap *lsm_map_open(const char *dir, size_t memtable_limit);
+bool lsm_map_close(LSMMap *map);
+
+bool lsm_map_put(LSMMap *map, const void *key, size_t key_size, const void *value, size_t value_size);
+bool lsm_map_remove(LSMMap *map, const void *key, size_t key_size);
+const void *lsm_map_get(const LSMMap *map, const void *key, size_t key_size, size_t *value_size);
+
+bool lsm_map_flush(LSMMap *map);
+// merges all runs into one, dropping deleted keys
+bool lsm_map_compact(LSMMap *map);
+size_t lsm_map_run_count(const LSMMap *map);
+
+LSMMapIterator *lsm_map_iterator_new(const LSMMap *map);
+bool lsm_map_iterator_next(LSMMapIterator *iter, const void **key, size_t *key_size,
+                           const void **value, size_t *value_size);
+void lsm_map_iterator_destroy(void *iter);
+
+#endif
@@ -0,0 +1,588 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "map-file.h"
+
+#include "alloc.h"
+#include "sha1.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MAGIC "LUMAPF01"
+#define MAGIC_SIZE 8
+#define VERSION 1
+
+#define HEADER_SIZE 16
+#define RECORD_HEADER_SIZE 8
+#define INDEX_ENTRY_SIZE 16
+#define FOOTER_SIZE 56
+#define FOOTER_DIGEST_OFFSET 24
+
+#define BLOCK_TARGET_SIZE 4096
+#define SHA1_CHUNK (1u << 30)
+
+typedef struct
+{
+    uint64_t offset;
+    uint32_t count;
+} IndexEntry;
+
+struct MapFileWriter_
+{
+    FILE *out;
+    char *path;
+    char *tmp_path;
+    SHA1Context sha1;
+    bool failed;
+
+    uint64_t offset;
+    uint64_t count;
+
+    IndexEntry *index;
+    size_t index_length;
+    size_t index_capacity;
+
+    unsigned char *last_key;
+    size_t last_key_size;
+    size_t last_key_capacity;
+
+    Allocator allocator;
+};
+
+struct MapFile_
+{
+    const unsigned char *base;
+    size_t length;
+
+    const unsigned char *index;
+    uint64_t index_offset;
+    uint64_t block_count;
+    uint64_t count;
+
+    Allocator allocator;
+};
+
+struct MapFileIterator_
+{
+    const MapFile *file;
+    uint64_t block;
+    const unsigned char *record;
+    uint32_t remaining;
+
+    const void *to;
+    size_t to_size;
+};
+
+static uint32_t read_u32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t read_u64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static void sha1_update_large(SHA1Context *sha1, const unsigned char *data, size_t size)
+{
+    while (size > 0)
+    {
+        uint32_t chunk = (size < SHA1_CHUNK) ? (uint32_t)size : SHA1_CHUNK;
+        sha1_update(sha1, data, chunk);
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+int map_file_key_compare(const void *a, size_t a_size, const void *b, size_t b_size)
+{
+    int cmp = memcmp(a, b, (a_size < b_size) ? a_size : b_size);
+    if (cmp != 0)
+    {
+        return cmp;
+    }
+
+    return (a_size > b_size) - (a_size < b_size);
+}
+
+static void writer_write(MapFileWriter *writer, const void *data, size_t size, bool checksum)
+{
+    if (writer->failed || size == 0)
+    {
+        return;
+    }
+
+    if (fwrite(data, 1, size, writer->out) != size)
+    {
+        writer->failed = true;
+        return;
+    }
+
+    if (checksum)
+    {
+        sha1_update_large(&writer->sha1, data, size);
+    }
+    writer->offset += size;
+}
+
+static void writer_write_u32(MapFileWriter *writer, uint32_t v)
+{
+    writer_write(writer, &v, sizeof(v), true);
+}
+
+static void writer_write_u64(MapFileWriter *writer, uint64_t v)
+{
+    writer_write(writer, &v, sizeof(v), true);
+}
+
+MapFileWriter *map_file_writer_new(const char *path)
+{
+    Allocator allocator = alloc_get_allocator();
+    size_t path_size = strlen(path);
+    char *tmp_path = alloc_malloc(&allocator, path_size + sizeof(".tmp"));
+    memcpy(tmp_path, path, path_size);
+    memcpy(tmp_path + path_size, ".tmp", sizeof(".tmp"));
+
+    FILE *out = fopen(tmp_path, "wb");
+    if (!out)
+    {
+        alloc_free(&allocator, tmp_path);
+        return NULL;
+    }
+
+    MapFileWriter *writer = alloc_calloc(&allocator, 1, sizeof(MapFileWriter));
+    writer->allocator = allocator;
+    writer->out = out;
+    writer->path = alloc_malloc(&allocator, path_size + 1);
+    memcpy(writer->path, path, path_size + 1);
+    writer->tmp_path = tmp_path;
+    sha1_init(&writer->sha1);
+
+    const uint32_t header[2] = { VERSION, 0 };
+    writer_write(writer, MAGIC, MAGIC_SIZE, true);
+    writer_write(writer, header, sizeof(header), true);
+
+    return writer;
+}
+
+static void writer_free(MapFileWriter *writer)
+{
+    Allocator allocator = writer->allocator;
+    alloc_free(&allocator, writer->index);
+    alloc_free(&allocator, writer->last_key);
+    alloc_free(&allocator, writer->path);
+    alloc_free(&allocator, writer->tmp_path);
+    alloc_free(&allocator, writer);
+}
+
+bool map_file_writer_add(MapFileWriter *writer, const void *key, size_t key_size,
+                         const void *value, size_t value_size)
+{
+    assert(key_size <= UINT32_MAX && value_size <= UINT32_MAX);
+
+    // binary search needs the order, so a key out of it fails the whole file
+    if (writer->count > 0
+        && map_file_key_compare(writer->last_key, writer->last_key_size, key, key_size) >= 0)
+    {
+        writer->failed = true;
+        return false;
+    }
+
+    IndexEntry *block = writer->index_length > 0 ? &writer->index[writer->index_length - 1] : NULL;
+
+    if (!block || writer->offset - block->offset >= BLOCK_TARGET_SIZE)
+    {
+        if (writer->index_length == writer->index_capacity)
+        {
+            writer->index_capacity = writer->index_capacity ? writer->index_capacity * 2 : 64;
+            writer->index = alloc_realloc(&writer->allocator, writer->index, sizeof(IndexEntry) * writer->index_capacity);
+        }
+
+        block = &writer->index[writer->index_length++];
+        block->offset = writer->offset;
+        block->count = 0;
+    }
+
+    writer_write_u32(writer, (uint32_t)key_size);
+    writer_write_u32(writer, (uint32_t)value_size);
+    writer_write(writer, key, key_size, true);
+    writer_write(writer, value, value_size, true);
+
+    block->count++;
+    writer->count++;
+
+    if (key_size > writer->last_key_capacity)
+    {
+        writer->last_key_capacity = key_size;
+        writer->last_key = alloc_realloc(&writer->allocator, writer->last_key, key_size);
+    }
+    if (key_size > 0)
+    {
+        memcpy(writer->last_key, key, key_size);
+    }
+    writer->last_key_size = key_size;
+
+    return !writer->failed;
+}
+
+bool map_file_writer_close(MapFileWriter *writer)
+{
+    uint64_t index_offset = writer->offset;
+
+    for (size_t i = 0; i < writer->index_length; i++)
+    {
+        writer_write_u64(writer, writer->index[i].offset);
+        writer_write_u32(writer, writer->index[i].count);
+        writer_write_u32(writer, 0);
+    }
+
+    writer_write_u64(writer, index_offset);
+    writer_write_u64(writer, writer->index_length);
+    writer_write_u64(writer, writer->count);
+
+    uint8_t digest[SHA1_SIZE_DIGEST];
+    const uint8_t reserved[4] = { 0 };
+    sha1_final(&writer->sha1, digest);
+    writer_write(writer, digest, sizeof(digest), false);
+    writer_write(writer, reserved, sizeof(reserved), false);
+    writer_write(writer, MAGIC, MAGIC_SIZE, false);
+
+    bool ok = !writer->failed
+        && fflush(writer->out) == 0
+        && fsync(fileno(writer->out)) == 0;
+    ok = (fclose(writer->out) == 0) && ok;
+    ok = ok && rename(writer->tmp_path, writer->path) == 0;
+
+    if (!ok)
+    {
+        unlink(writer->tmp_path);
+    }
+
+    writer_free(writer);
+    return ok;
+}
+
+void map_file_writer_abort(MapFileWriter *writer)
+{
+    if (writer)
+    {
+        fclose(writer->out);
+        unlink(writer->tmp_path);
+        writer_free(writer);
+    }
+}
+
+bool map_file_write(const char *path, const RBTree *tree,
+                    void (*key_bytes)(const void *key, const void **data, size_t *size),
+                    void (*value_bytes)(const void *value, const void **data, size_t *size))
+{
+    MapFileWriter *writer = map_file_writer_new(path);
+    if (!writer)
+    {
+        return false;
+    }
+
+    RBTreeIterator *iter = rbtree_iterator_new(tree);
+    void *key, *value;
+    while (rbtree_iterator_next(iter, &key, &value))
+    {
+        const void *key_data, *value_data;
+        size_t key_size, value_size;
+        key_bytes(key, &key_data, &key_size);
+        value_bytes(value, &value_data, &value_size);
+
+        if (!map_file_writer_add(writer, key_data, key_size, value_data, value_size))
+        {
+            rbtree_iterator_destroy(iter);
+            map_file_writer_abort(writer);
+            return false;
+        }
+    }
+    rbtree_iterator_destroy(iter);
+
+    return map_file_writer_close(writer);
+}
+
+MapFile *map_file_open(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < HEADER_SIZE + FOOTER_SIZE)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    size_t length = st.st_size;
+    void *base = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    const unsigned char *footer = (const unsigned char *)base + length - FOOTER_SIZE;
+    uint64_t index_offset = read_u64(footer);
+    uint64_t block_count = read_u64(footer + 8);
+
+    if (memcmp(base, MAGIC, MAGIC_SIZE) != 0
+        || read_u32((const unsigned char *)base + MAGIC_SIZE) != VERSION
+        || memcmp(footer + FOOTER_SIZE - MAGIC_SIZE, MAGIC, MAGIC_SIZE) != 0
+        || index_offset < HEADER_SIZE
+        || index_offset > length - FOOTER_SIZE
+        || (length - FOOTER_SIZE - index_offset) / INDEX_ENTRY_SIZE != block_count
+        || (length - FOOTER_SIZE - index_offset) % INDEX_ENTRY_SIZE != 0)
+    {
+        munmap(base, length);
+        return NULL;
+    }
+
+    Allocator allocator = alloc_get_allocator();
+    MapFile *file = alloc_malloc(&allocator, sizeof(MapFile));
+    file->allocator = allocator;
+    file->base = base;
+    file->length = length;
+    file->index = file->base + index_offset;
+    file->index_offset = index_offset;
+    file->block_count = block_count;
+    file->count = read_u64(footer + 16);
+
+    return file;
+}
+
+void map_file_close(MapFile *file)
+{
+    if (file)
+    {
+        munmap((void *)file->base, file->length);
+        alloc_free(&file->allocator, file);
+    }
+}
+
+bool map_file_verify(const MapFile *file)
+{
+    SHA1Context sha1;
+    uint8_t digest[SHA1_SIZE_DIGEST];
+
+    size_t checked = file->length - FOOTER_SIZE + FOOTER_DIGEST_OFFSET;
+    sha1_init(&sha1);
+    sha1_update_large(&sha1, file->base, checked);
+    sha1_final(&sha1, digest);
+
+    return memcmp(digest, file->base + checked, SHA1_SIZE_DIGEST) == 0;
+}
+
+size_t map_file_size(const MapFile *file)
+{
+    return file->count;
+}
+
+static const unsigned char *block_start(const MapFile *file, uint64_t block)
+{
+    return file->base + read_u64(file->index + block * INDEX_ENTRY_SIZE);
+}
+
+static uint32_t block_count(const MapFile *file, uint64_t block)
+{
+    return read_u32(file->index + block * INDEX_ENTRY_SIZE + 8);
+}
+
+static void record_read(const unsigned char *record, const void **key, size_t *key_size,
+                        const void **value, size_t *value_size)
+{
+    *key_size = read_u32(record);
+    *value_size = read_u32(record + 4);
+    *key = record + RECORD_HEADER_SIZE;
+    *value = record + RECORD_HEADER_SIZE + *key_size;
+}
+
+static const unsigned char *record_next(const unsigned char *record)
+{
+    return record + RECORD_HEADER_SIZE + read_u32(record) + read_u32(record + 4);
+}
+
+// last block whose first key is not greater than key, 0 if there is none
+static uint64_t find_block(const MapFile *file, const void *key, size_t key_size)
+{
+    uint64_t lo = 0, hi = file->block_count;
+
+    while (hi - lo > 1)
+    {
+        uint64_t mid = lo + (hi - lo) / 2;
+        const unsigned char *first = block_start(file, mid);
+        if (map_file_key_compare(first + RECORD_HEADER_SIZE, read_u32(first), key, key_size) <= 0)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+const void *map_file_get(const MapFile *file, const void *key, size_t key_size, size_t *value_size)
+{
+    if (file->block_count == 0)
+    {
+        return NULL;
+    }
+
+    uint64_t block = find_block(file, key, key_size);
+    const unsigned char *record = block_start(file, block);
+
+    for (uint32_t n = block_count(file, block); n > 0; n--, record = record_next(record))
+    {
+        const void *k, *v;
+        size_t ks, vs;
+        record_read(record, &k, &ks, &v, &vs);
+
+        int cmp = map_file_key_compare(k, ks, key, key_size);
+        if (cmp == 0)
+        {
+            if (value_size)
+            {
+                *value_size = vs;
+            }
+            return v;
+        }
+        if (cmp > 0)
+        {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static void iterator_seek_block(MapFileIterator *iter, uint64_t block)
+{
+    iter->block = block;
+    if (block < iter->file->block_count)
+    {
+        iter->record = block_start(iter->file, block);
+        iter->remaining = block_count(iter->file, block);
+    }
+    else
+    {
+        iter->record = NULL;
+        iter->remaining = 0;
+    }
+}
+
+static bool iterator_peek(MapFileIterator *iter, const void **key, size_t *key_size,
+                          const void **value, size_t *value_size)
+{
+    while (iter->remaining == 0)
+    {
+        if (iter->block >= iter->file->block_count)
+        {
+            return false;
+        }
+        iterator_seek_block(iter, iter->block + 1);
+    }
+
+    record_read(iter->record, key, key_size, value, value_size);
+    return true;
+}
+
+static void iterator_advance(MapFileIterator *iter)
+{
+    iter->record = record_next(iter->record);
+    iter->remaining--;
+}
+
+MapFileIterator *map_file_iterator_new(const MapFile *file)
+{
+    return map_file_iterator_new_range(file, NULL, 0, NULL, 0);
+}
+
+MapFileIterator *map_file_iterator_new_range(const MapFile *file,
+                                             const void *from, size_t from_size,
+                                             const void *to, size_t to_size)
+{
+    MapFileIterator *iter = alloc_malloc(&file->allocator, sizeof(MapFileIterator));
+
+    iter->file = file;
+    iter->to = to;
+    iter->to_size = to_size;
+
+    iterator_seek_block(iter, (from && file->block_count > 0) ? find_block(file, from, from_size) : 0);
+
+    if (from)
+    {
+        const void *k, *v;
+        size_t ks, vs;
+        while (iterator_peek(iter, &k, &ks, &v, &vs)
+               && map_file_key_compare(k, ks, from, from_size) < 0)
+        {
+            iterator_advance(iter);
+        }
+    }
+
+    return iter;
+}
+
+bool map_file_iterator_next(MapFileIterator *iter, const void **key, size_t *key_size,
+                            const void **value, size_t *value_size)
+{
+    const void *k, *v;
+    size_t ks, vs;
+
+    if (!iterator_peek(iter, &k, &ks, &v, &vs))
+    {
+        return false;
+    }
+
+    if (iter->to && map_file_key_compare(k, ks, iter->to, iter->to_size) >= 0)
+    {
+        return false;
+    }
+
+    if (key)
+    {
+        *key = k;
+    }
+    if (key_size)
+    {
+        *key_size = ks;
+    }
+    if (value)
+    {
+        *value = v;
+    }
+    if (value_size)
+    {
+        *value_size = vs;
+    }
+
+    iterator_advance(iter);
+    return true;
+}
+
+void map_file_iterator_destroy(void *_iter)
+{
+    MapFileIterator *iter = _iter;
+    if (iter)
+    {
+        alloc_free(&iter->file->allocator, iter);
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef LIBUTILS_MAP_FILE_H
+#define LIBUTILS_MAP_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "rb-tree.h"
+
+/*
+ * A sorted key/value file meant to be memory mapped and queried in place.
+ *
+ * Layout (host byte order):
+ *   header   magic "LUMAPF01", uint32 version, uint32 reserved
+ *   blocks   records of uint32 key size, uint32 value size, key, value
+ *   index    per block: uint64 offset, uint32 record count, uint32 reserved
+ *   footer   uint64 index offset, uint64 block count, uint64 record count,
+ *            SHA-1 of everything before the digest, 4 reserved bytes, magic
+ *
+ * Keys are ordered bytewise, a shorter key before any key it prefixes.
+ */
+
+typedef struct MapFile_ MapFile;
+typedef struct MapFileIterator_ MapFileIterator;
+typedef struct MapFileWriter_ MapFileWriter;
+
+/**
+ * Writes to a temporary file next to path, which replaces path once
+ * map_file_writer_close succeeds. Records must be added in strictly
+ * increasing key order; map_file_writer_add returns false on a key out of
+ * order or a write error, and map_file_writer_close then fails too.
+ */
+MapFileWriter *map_file_writer_new(const char *path);
+bool map_file_writer_add(MapFileWriter *writer, const void *key, size_t key_size,
+                         const void *value, size_t value_size);
+bool map_file_writer_close(MapFileWriter *writer);
+void map_file_writer_abort(MapFileWriter *writer);
+
+/**
+ * Writes the tree in its own order, so its key_compare must order the
+ * key_bytes bytewise, e.g. not little-endian integers. Fails otherwise.
+ */
+bool map_file_write(const char *path, const RBTree *tree,
+                    void (*key_bytes)(const void *key, const void **data, size_t *size),
+                    void (*value_bytes)(const void *value, const void **data, size_t *size));
+
+MapFile *map_file_open(const char *path);
+void map_file_close(MapFile *file);
+bool map_file_verify(const MapFile *file);
+
+size_t map_file_size(const MapFile *file);
+const void *map_file_get(const MapFile *file, const void *key, size_t key_size, size_t *value_size);
+
+MapFileIterator *map_file_iterator_new(const MapFile *file);
+// iterates keys in [from, to), a NULL bound is unbounded
+MapFileIterator *map_file_iterator_new_range(const MapFile *file,
+                                             const void *from, size_t from_size,
+                                             const void *to, size_t to_size);
+bool map_file_iterator_next(MapFileIterator *iter, const void **key, size_t *key_size,
+                            const void **value, size_t *value_size);
+void map_file_iterator_destroy(void *iter);
+
+int map_file_key_compare(const void *a, size_t a_size, const void *b, size_t b_size);
+
+#endif
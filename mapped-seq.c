@@ -0,0 +1,263 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "mapped-seq.h"
+
+#include "alloc.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MAGIC "LUSEQF01"
+#define MAGIC_SIZE 8
+#define VERSION 1
+
+// a full cache line, which also keeps records aligned like malloc'd memory
+#define HEADER_SIZE 64
+#define INITIAL_BYTES 4096
+
+typedef struct
+{
+    char magic[MAGIC_SIZE];
+    uint32_t version;
+    uint32_t elem_size;
+    uint64_t length;
+    uint64_t capacity;
+} Header;
+
+struct MappedSeq_
+{
+    int fd;
+    bool writable;
+    size_t elem_size;
+
+    unsigned char *base;
+    size_t mapped_size;
+    // records covered by the mapping, which a reader may see before the header
+    size_t mapped_capacity;
+
+    Allocator allocator;
+};
+
+static Header *header(const MappedSeq *seq)
+{
+    return (Header *)seq->base;
+}
+
+static bool map(MappedSeq *seq, size_t size)
+{
+    int prot = seq->writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void *base = mmap(NULL, size, prot, MAP_SHARED, seq->fd, 0);
+    if (base == MAP_FAILED)
+    {
+        return false;
+    }
+
+    if (seq->base)
+    {
+        munmap(seq->base, seq->mapped_size);
+    }
+    seq->base = base;
+    seq->mapped_size = size;
+    seq->mapped_capacity = (size - HEADER_SIZE) / seq->elem_size;
+    return true;
+}
+
+static MappedSeq *open_seq(const char *path, size_t elem_size, bool writable)
+{
+    assert(elem_size > 0 && elem_size <= UINT32_MAX);
+
+    int fd = writable ? open(path, O_RDWR | O_CREAT, 0644) : open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = st.st_size;
+    if (size == 0 && writable)
+    {
+        Header fresh;
+        memset(&fresh, 0, sizeof(fresh));
+        memcpy(fresh.magic, MAGIC, MAGIC_SIZE);
+        fresh.version = VERSION;
+        fresh.elem_size = elem_size;
+
+        size = HEADER_SIZE;
+        if (ftruncate(fd, size) != 0 || pwrite(fd, &fresh, sizeof(fresh), 0) != sizeof(fresh))
+        {
+            close(fd);
+            return NULL;
+        }
+    }
+
+    Allocator allocator = alloc_get_allocator();
+    MappedSeq *seq = alloc_calloc(&allocator, 1, sizeof(MappedSeq));
+    seq->allocator = allocator;
+    seq->fd = fd;
+    seq->writable = writable;
+    seq->elem_size = elem_size;
+
+    if (size < HEADER_SIZE || !map(seq, size))
+    {
+        mapped_seq_close(seq);
+        return NULL;
+    }
+
+    const Header *h = header(seq);
+    if (memcmp(h->magic, MAGIC, MAGIC_SIZE) != 0
+        || h->version != VERSION
+        || h->elem_size != elem_size
+        || h->length > h->capacity
+        || (writable && h->capacity > seq->mapped_capacity))
+    {
+        mapped_seq_close(seq);
+        return NULL;
+    }
+
+    return seq;
+}
+
+MappedSeq *mapped_seq_open(const char *path, size_t elem_size)
+{
+    return open_seq(path, elem_size, true);
+}
+
+MappedSeq *mapped_seq_open_readonly(const char *path, size_t elem_size)
+{
+    return open_seq(path, elem_size, false);
+}
+
+void mapped_seq_close(MappedSeq *seq)
+{
+    if (seq)
+    {
+        if (seq->base)
+        {
+            munmap(seq->base, seq->mapped_size);
+        }
+        close(seq->fd);
+        alloc_free(&seq->allocator, seq);
+    }
+}
+
+size_t mapped_seq_length(const MappedSeq *seq)
+{
+#if defined(__GNUC__)
+    size_t length = __atomic_load_n(&header(seq)->length, __ATOMIC_ACQUIRE);
+#else
+    size_t length = header(seq)->length;
+#endif
+    return length < seq->mapped_capacity ? length : seq->mapped_capacity;
+}
+
+size_t mapped_seq_capacity(const MappedSeq *seq)
+{
+    return seq->mapped_capacity;
+}
+
+size_t mapped_seq_elem_size(const MappedSeq *seq)
+{
+    return seq->elem_size;
+}
+
+void *mapped_seq_at(const MappedSeq *seq, size_t index)
+{
+    assert(index < mapped_seq_length(seq));
+    return seq->base + HEADER_SIZE + index * seq->elem_size;
+}
+
+bool mapped_seq_reserve(MappedSeq *seq, size_t capacity)
+{
+    assert(seq->writable);
+
+    if (capacity <= seq->mapped_capacity)
+    {
+        return true;
+    }
+    if (capacity > (SIZE_MAX - HEADER_SIZE) / seq->elem_size)
+    {
+        return false;
+    }
+
+    // the header's capacity follows the file, so a crash mid-growth is harmless
+    size_t size = HEADER_SIZE + capacity * seq->elem_size;
+    if (ftruncate(seq->fd, size) != 0 || !map(seq, size))
+    {
+        return false;
+    }
+    header(seq)->capacity = seq->mapped_capacity;
+    return true;
+}
+
+bool mapped_seq_append(MappedSeq *seq, const void *item)
+{
+    assert(seq->writable);
+
+    Header *h = header(seq);
+    if (h->length == seq->mapped_capacity)
+    {
+        size_t capacity = seq->mapped_capacity * 2;
+        size_t minimum = INITIAL_BYTES / seq->elem_size;
+        if (capacity < minimum)
+        {
+            capacity = minimum > 0 ? minimum : 1;
+        }
+        if (!mapped_seq_reserve(seq, capacity))
+        {
+            return false;
+        }
+        h = header(seq);
+    }
+
+    memcpy(seq->base + HEADER_SIZE + h->length * seq->elem_size, item, seq->elem_size);
+#if defined(__GNUC__)
+    // readers in other processes must not see the length before the record
+    __atomic_store_n(&h->length, h->length + 1, __ATOMIC_RELEASE);
+#else
+    h->length++;
+#endif
+    return true;
+}
+
+bool mapped_seq_sync(MappedSeq *seq)
+{
+    assert(seq->writable);
+
+    // records past the first page go first, so the length on disk never
+    // covers records that are not
+    size_t page = sysconf(_SC_PAGESIZE);
+    if (seq->mapped_size > page
+        && msync(seq->base + page, seq->mapped_size - page, MS_SYNC) != 0)
+    {
+        return false;
+    }
+
+    size_t first = seq->mapped_size < page ? seq->mapped_size : page;
+    return msync(seq->base, first, MS_SYNC) == 0 && fdatasync(seq->fd) == 0;
+}
+
+bool mapped_seq_refresh(MappedSeq *seq)
+{
+    struct stat st;
+    if (fstat(seq->fd, &st) != 0 || (size_t)st.st_size < HEADER_SIZE)
+    {
+        return false;
+    }
+    if ((size_t)st.st_size == seq->mapped_size)
+    {
+        return true;
+    }
+    return map(seq, st.st_size);
+}
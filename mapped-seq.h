@@ -0,0 +1,44 @@
+#ifndef LIBUTILS_MAPPED_SEQ_H
+#define LIBUTILS_MAPPED_SEQ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * An append-only sequence of fixed-size records stored in a memory-mapped
+ * file, so it reopens without parsing and other processes can read it
+ * through the page cache.
+ *
+ * Layout (host byte order):
+ *   header   magic "LUSEQF01", uint32 version, uint32 record size,
+ *            uint64 length, uint64 capacity, zero padding to 64 bytes
+ *   records  capacity slots of record size bytes, the first length in use
+ *
+ * Appends land in the page cache, so a crashed process loses nothing. Only
+ * mapped_seq_sync makes them durable: after a system crash the records up
+ * to the last sync are intact, later ones may read back as zeros.
+ */
+
+typedef struct MappedSeq_ MappedSeq;
+
+// Opens path for appending, creating it if needed
+MappedSeq *mapped_seq_open(const char *path, size_t elem_size);
+// Opens path for reading, possibly while another process appends to it
+MappedSeq *mapped_seq_open_readonly(const char *path, size_t elem_size);
+void mapped_seq_close(MappedSeq *seq);
+
+size_t mapped_seq_length(const MappedSeq *seq);
+size_t mapped_seq_capacity(const MappedSeq *seq);
+size_t mapped_seq_elem_size(const MappedSeq *seq);
+
+// Points into the mapping, which moves when the file grows
+void *mapped_seq_at(const MappedSeq *seq, size_t index);
+bool mapped_seq_append(MappedSeq *seq, const void *item);
+bool mapped_seq_reserve(MappedSeq *seq, size_t capacity);
+
+// Flushes the records, then the header, to disk
+bool mapped_seq_sync(MappedSeq *seq);
+// Remaps a reader after the writer has grown the file
+bool mapped_seq_refresh(MappedSeq *seq);
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef LIBUTILS_MEMORY_RESOURCE_HPP
+#define LIBUTILS_MEMORY_RESOURCE_HPP
+
+extern "C"
+{
+#include "alloc.h"
+}
+
+#include <cstddef>
+#include <cstring>
+#include <memory_resource>
+#include <new>
+
+/*
+ * Bridges between the libutils allocation layer and std::pmr.
+ *
+ * lu::memory_resource hands out memory from whatever Allocator the calling
+ * thread has installed in alloc.c, so std::pmr containers can share it with
+ * the C containers. lu::allocator_scope goes the other way and routes the
+ * thread's x*() calls to a std::pmr::memory_resource, e.g. a
+ * monotonic_buffer_resource backing one request; containers created in the
+ * scope keep using it from any thread. Do not chain the two onto each
+ * other, as that recurses forever.
+ */
+
+namespace lu
+{
+
+class memory_resource : public std::pmr::memory_resource
+{
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        // xmalloc() only guarantees malloc() alignment
+        if (alignment > alignof(std::max_align_t))
+        {
+            throw std::bad_alloc();
+        }
+        return xmalloc(bytes > 0 ? bytes : 1);
+    }
+
+    void do_deallocate(void *p, std::size_t, std::size_t) override
+    {
+        xfree(p);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return dynamic_cast<const memory_resource *>(&other) != nullptr;
+    }
+};
+
+inline memory_resource *libutils_resource() noexcept
+{
+    static memory_resource resource;
+    return &resource;
+}
+
+namespace detail
+{
+
+// Allocator::deallocate() is not told the size, but memory_resource needs it back
+struct alignas(std::max_align_t) block_header
+{
+    std::size_t size;
+};
+
+inline void *pmr_allocate(void *context, std::size_t size) noexcept
+{
+    auto *resource = static_cast<std::pmr::memory_resource *>(context);
+
+    try
+    {
+        auto *header = static_cast<block_header *>(
+            resource->allocate(sizeof(block_header) + size, alignof(block_header)));
+        header->size = size;
+        return header + 1;
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+inline void pmr_deallocate(void *context, void *ptr) noexcept
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    auto *resource = static_cast<std::pmr::memory_resource *>(context);
+    block_header *header = static_cast<block_header *>(ptr) - 1;
+    resource->deallocate(header, sizeof(block_header) + header->size, alignof(block_header));
+}
+
+inline void *pmr_reallocate(void *context, void *ptr, std::size_t size) noexcept
+{
+    if (!ptr)
+    {
+        return pmr_allocate(context, size);
+    }
+
+    std::size_t old_size = (static_cast<block_header *>(ptr) - 1)->size;
+    if (size <= old_size)
+    {
+        return ptr;
+    }
+
+    void *res = pmr_allocate(context, size);
+    if (res)
+    {
+        std::memcpy(res, ptr, old_size);
+        pmr_deallocate(context, ptr);
+    }
+    return res;
+}
+
+}
+
+inline Allocator make_allocator(std::pmr::memory_resource *resource) noexcept
+{
+    return Allocator{ detail::pmr_allocate, detail::pmr_reallocate, detail::pmr_deallocate, resource };
+}
+
+// Installs resource as the calling thread's libutils allocator until the end of the scope
+class allocator_scope
+{
+public:
+    explicit allocator_scope(std::pmr::memory_resource *resource) noexcept
+    {
+        Allocator allocator = make_allocator(resource);
+        previous_ = alloc_set_allocator(&allocator);
+    }
+
+    ~allocator_scope()
+    {
+        alloc_set_allocator(&previous_);
+    }
+
+    allocator_scope(const allocator_scope &) = delete;
+    allocator_scope &operator=(const allocator_scope &) = delete;
+
+private:
+    Allocator previous_;
+};
+
+}
+
+#endif
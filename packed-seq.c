@@ -0,0 +1,463 @@
+#include "packed-seq.h"
+
+#include "alloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define BLOCK 128
+// slack after the packed data so unaligned 16-byte reads never run off the end
+#define DATA_PADDING 16
+
+enum
+{
+    MODE_FOR,
+    MODE_DELTA
+};
+
+typedef struct
+{
+    // first value for delta blocks, minimum for frame-of-reference blocks
+    uint64_t base;
+    uint64_t offset;
+    uint8_t width;
+    uint8_t mode;
+} BlockHeader;
+
+struct PackedSeq_
+{
+    BlockHeader *blocks;
+    size_t block_count;
+    size_t block_capacity;
+
+    uint8_t *data;
+    size_t data_size;
+    size_t data_capacity;
+
+    // the last, incomplete block is kept unpacked
+    uint64_t tail[BLOCK];
+    size_t tail_length;
+
+    Allocator allocator;
+};
+
+struct PackedSeqIterator_
+{
+    const PackedSeq *seq;
+    size_t block;
+    size_t pos;
+    size_t available;
+    uint64_t values[BLOCK];
+};
+
+PackedSeq *packed_seq_new(void)
+{
+    Allocator allocator = alloc_get_allocator();
+    PackedSeq *seq = alloc_calloc(&allocator, 1, sizeof(PackedSeq));
+    seq->allocator = allocator;
+    return seq;
+}
+
+void packed_seq_destroy(PackedSeq *seq)
+{
+    if (seq)
+    {
+        Allocator allocator = seq->allocator;
+        alloc_free(&allocator, seq->blocks);
+        alloc_free(&allocator, seq->data);
+        alloc_free(&allocator, seq);
+    }
+}
+
+static unsigned int bit_width(uint64_t value)
+{
+    unsigned int width = 0;
+    while (width < 64 && (value >> width) != 0)
+    {
+        width++;
+    }
+    return width;
+}
+
+static size_t packed_size(unsigned int width)
+{
+    // widths up to 32 use 32-bit lanes, wider ones a plain 64-bit stream
+    return width <= 32 ? (size_t)width * 16 : (size_t)width * BLOCK / 8;
+}
+
+/*
+ * Narrow blocks use the vertical layout of SIMD-BP128 (Lemire and Boytsov):
+ * value i goes to lane i % 4, and each lane is a little bit stream of
+ * 32-bit words interleaved with the other lanes', so that one 128-bit load
+ * serves four values at the same bit position.
+ */
+static void pack_vertical(const uint64_t *in, unsigned int width, uint32_t *out)
+{
+    memset(out, 0, packed_size(width));
+
+    for (unsigned int lane = 0; lane < 4; lane++)
+    {
+        for (unsigned int row = 0; row < BLOCK / 4; row++)
+        {
+            uint32_t v = (uint32_t)in[row * 4 + lane];
+            unsigned int bit = row * width;
+            unsigned int word = bit / 32;
+            unsigned int shift = bit % 32;
+
+            out[word * 4 + lane] |= v << shift;
+            if (shift + width > 32)
+            {
+                out[(word + 1) * 4 + lane] |= v >> (32 - shift);
+            }
+        }
+    }
+}
+
+static void unpack_vertical(const uint8_t *in, unsigned int width, uint32_t *out)
+{
+    if (width == 0)
+    {
+        memset(out, 0, sizeof(uint32_t) * BLOCK);
+        return;
+    }
+
+#if defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi32(width == 32 ? -1 : (int)((1u << width) - 1));
+    const __m128i *words = (const __m128i *)in;
+    __m128i current = _mm_loadu_si128(words);
+    unsigned int word = 0;
+
+    for (unsigned int row = 0; row < BLOCK / 4; row++)
+    {
+        unsigned int shift = (row * width) % 32;
+        unsigned int next = (row * width) / 32;
+        if (next != word)
+        {
+            word = next;
+            current = _mm_loadu_si128(words + word);
+        }
+
+        __m128i v = _mm_srl_epi32(current, _mm_cvtsi32_si128((int)shift));
+        if (shift + width > 32)
+        {
+            __m128i high = _mm_loadu_si128(words + word + 1);
+            v = _mm_or_si128(v, _mm_sll_epi32(high, _mm_cvtsi32_si128((int)(32 - shift))));
+        }
+        _mm_storeu_si128((__m128i *)(out + row * 4), _mm_and_si128(v, mask));
+    }
+#else
+    uint32_t words[32 * 4];
+    uint32_t mask = width == 32 ? UINT32_MAX : (1u << width) - 1;
+
+    memcpy(words, in, packed_size(width));
+    for (unsigned int row = 0; row < BLOCK / 4; row++)
+    {
+        unsigned int bit = row * width;
+        unsigned int word = bit / 32;
+        unsigned int shift = bit % 32;
+
+        for (unsigned int lane = 0; lane < 4; lane++)
+        {
+            uint32_t v = words[word * 4 + lane] >> shift;
+            if (shift + width > 32)
+            {
+                v |= words[(word + 1) * 4 + lane] << (32 - shift);
+            }
+            out[row * 4 + lane] = v & mask;
+        }
+    }
+#endif
+}
+
+static void pack_wide(const uint64_t *in, unsigned int width, uint8_t *out)
+{
+    memset(out, 0, packed_size(width));
+
+    for (unsigned int i = 0; i < BLOCK; i++)
+    {
+        size_t bit = (size_t)i * width;
+        for (unsigned int b = 0; b < width; b++, bit++)
+        {
+            out[bit / 8] |= (uint8_t)(((in[i] >> b) & 1) << (bit % 8));
+        }
+    }
+}
+
+static void unpack_wide(const uint8_t *in, unsigned int width, uint64_t *out)
+{
+    uint64_t mask = width == 64 ? UINT64_MAX : (UINT64_C(1) << width) - 1;
+
+    for (unsigned int i = 0; i < BLOCK; i++)
+    {
+        size_t bit = (size_t)i * width;
+        uint64_t low;
+        memcpy(&low, in + bit / 8, sizeof(low));
+        unsigned int shift = bit % 8;
+
+        // host order is assumed little-endian, like the rest of the layout
+        uint64_t v = low >> shift;
+        if (shift + width > 64)
+        {
+            v |= (uint64_t)in[bit / 8 + 8] << (64 - shift);
+        }
+        out[i] = v & mask;
+    }
+}
+
+static void reserve_data(PackedSeq *seq, size_t extra)
+{
+    size_t needed = seq->data_size + extra + DATA_PADDING;
+    if (needed > seq->data_capacity)
+    {
+        size_t capacity = seq->data_capacity ? seq->data_capacity : 1024;
+        while (capacity < needed)
+        {
+            capacity *= 2;
+        }
+        seq->data = alloc_realloc(&seq->allocator, seq->data, capacity);
+        seq->data_capacity = capacity;
+    }
+}
+
+static void flush_tail(PackedSeq *seq)
+{
+    const uint64_t *values = seq->tail;
+    uint64_t residuals[BLOCK];
+    BlockHeader header;
+
+    bool sorted = true;
+    uint64_t min = values[0];
+    uint64_t max = values[0];
+    for (unsigned int i = 1; i < BLOCK; i++)
+    {
+        sorted = sorted && values[i] >= values[i - 1];
+        min = values[i] < min ? values[i] : min;
+        max = values[i] > max ? values[i] : max;
+    }
+
+    uint64_t largest = 0;
+    if (sorted)
+    {
+        header.mode = MODE_DELTA;
+        header.base = values[0];
+        residuals[0] = 0;
+        for (unsigned int i = 1; i < BLOCK; i++)
+        {
+            residuals[i] = values[i] - values[i - 1];
+            largest = residuals[i] > largest ? residuals[i] : largest;
+        }
+    }
+    else
+    {
+        header.mode = MODE_FOR;
+        header.base = min;
+        for (unsigned int i = 0; i < BLOCK; i++)
+        {
+            residuals[i] = values[i] - min;
+        }
+        largest = max - min;
+    }
+
+    header.width = (uint8_t)bit_width(largest);
+    header.offset = seq->data_size;
+
+    size_t size = packed_size(header.width);
+    reserve_data(seq, size);
+    if (header.width <= 32)
+    {
+        uint32_t words[32 * 4];
+        pack_vertical(residuals, header.width, words);
+        memcpy(seq->data + seq->data_size, words, size);
+    }
+    else
+    {
+        pack_wide(residuals, header.width, seq->data + seq->data_size);
+    }
+    seq->data_size += size;
+
+    if (seq->block_count == seq->block_capacity)
+    {
+        seq->block_capacity = seq->block_capacity ? seq->block_capacity * 2 : 16;
+        seq->blocks = alloc_realloc(&seq->allocator, seq->blocks, sizeof(BlockHeader) * seq->block_capacity);
+    }
+    seq->blocks[seq->block_count++] = header;
+    seq->tail_length = 0;
+}
+
+void packed_seq_append(PackedSeq *seq, uint64_t value)
+{
+    seq->tail[seq->tail_length++] = value;
+    if (seq->tail_length == BLOCK)
+    {
+        flush_tail(seq);
+    }
+}
+
+size_t packed_seq_length(const PackedSeq *seq)
+{
+    return seq->block_count * BLOCK + seq->tail_length;
+}
+
+size_t packed_seq_memory(const PackedSeq *seq)
+{
+    return sizeof(PackedSeq) + sizeof(BlockHeader) * seq->block_capacity + seq->data_capacity;
+}
+
+// Decodes block into out, returns the number of values
+static size_t decode_block(const PackedSeq *seq, size_t block, uint64_t *out)
+{
+    if (block == seq->block_count)
+    {
+        memcpy(out, seq->tail, sizeof(uint64_t) * seq->tail_length);
+        return seq->tail_length;
+    }
+
+    const BlockHeader *header = &seq->blocks[block];
+    const uint8_t *data = seq->data + header->offset;
+
+    if (header->width <= 32)
+    {
+        uint32_t narrow[BLOCK];
+        unpack_vertical(data, header->width, narrow);
+        for (unsigned int i = 0; i < BLOCK; i++)
+        {
+            out[i] = narrow[i];
+        }
+    }
+    else
+    {
+        unpack_wide(data, header->width, out);
+    }
+
+    if (header->mode == MODE_DELTA)
+    {
+        uint64_t sum = header->base;
+        for (unsigned int i = 0; i < BLOCK; i++)
+        {
+            sum += out[i];
+            out[i] = sum;
+        }
+    }
+    else
+    {
+        for (unsigned int i = 0; i < BLOCK; i++)
+        {
+            out[i] += header->base;
+        }
+    }
+
+    return BLOCK;
+}
+
+uint64_t packed_seq_get(const PackedSeq *seq, size_t index)
+{
+    assert(index < packed_seq_length(seq));
+
+    size_t block = index / BLOCK;
+    if (block == seq->block_count)
+    {
+        return seq->tail[index % BLOCK];
+    }
+
+    const BlockHeader *header = &seq->blocks[block];
+    if (header->width == 0)
+    {
+        return header->base;
+    }
+
+    uint64_t values[BLOCK];
+    decode_block(seq, block, values);
+    return values[index % BLOCK];
+}
+
+size_t packed_seq_lower_bound(const PackedSeq *seq, uint64_t value)
+{
+    // last block whose first value is below value, via the directory
+    size_t lo = 0;
+    size_t hi = seq->block_count;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (seq->blocks[mid].base < value)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    size_t block = lo > 0 ? lo - 1 : 0;
+    if (lo == seq->block_count && seq->tail_length > 0 && seq->tail[0] < value)
+    {
+        block = seq->block_count;
+    }
+
+    uint64_t values[BLOCK];
+    size_t n = decode_block(seq, block, values);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (values[i] >= value)
+        {
+            return block * BLOCK + i;
+        }
+    }
+    return block * BLOCK + n;
+}
+
+PackedSeqIterator *packed_seq_iterator_new(const PackedSeq *seq, size_t start)
+{
+    PackedSeqIterator *iter = alloc_malloc(&seq->allocator, sizeof(PackedSeqIterator));
+
+    iter->seq = seq;
+    iter->block = start / BLOCK;
+    iter->available = 0;
+    iter->pos = start % BLOCK;
+
+    if (start < packed_seq_length(seq))
+    {
+        iter->available = decode_block(seq, iter->block, iter->values);
+    }
+    else
+    {
+        iter->block = seq->block_count;
+        iter->pos = 0;
+    }
+
+    return iter;
+}
+
+bool packed_seq_iterator_next(PackedSeqIterator *iter, uint64_t *value)
+{
+    if (iter->pos == iter->available)
+    {
+        if (iter->block >= iter->seq->block_count)
+        {
+            return false;
+        }
+        iter->block++;
+        iter->pos = 0;
+        iter->available = decode_block(iter->seq, iter->block, iter->values);
+        if (iter->available == 0)
+        {
+            return false;
+        }
+    }
+
+    *value = iter->values[iter->pos++];
+    return true;
+}
+
+void packed_seq_iterator_destroy(PackedSeqIterator *iter)
+{
+    if (iter)
+    {
+        alloc_free(&iter->seq->allocator, iter);
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef LIBUTILS_PACKED_SEQ_H
+#define LIBUTILS_PACKED_SEQ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * An append-only sequence of 64-bit integers compressed in blocks of 128.
+ * A non-decreasing block stores the deltas between its values, any other
+ * block the offsets from its minimum, each bit-packed at the smallest width
+ * that fits. A directory entry per block makes random access one block
+ * decode, and sorted IDs typically cost one or two bytes each.
+ */
+
+typedef struct PackedSeq_ PackedSeq;
+typedef struct PackedSeqIterator_ PackedSeqIterator;
+
+PackedSeq *packed_seq_new(void);
+void packed_seq_destroy(PackedSeq *seq);
+
+void packed_seq_append(PackedSeq *seq, uint64_t value);
+size_t packed_seq_length(const PackedSeq *seq);
+uint64_t packed_seq_get(const PackedSeq *seq, size_t index);
+// First index whose value is not below value; the seq must be sorted
+size_t packed_seq_lower_bound(const PackedSeq *seq, uint64_t value);
+// Bytes held, directory and partial last block included
+size_t packed_seq_memory(const PackedSeq *seq);
+
+// Streams values from index start on, decoding a block at a time
+PackedSeqIterator *packed_seq_iterator_new(const PackedSeq *seq, size_t start);
+bool packed_seq_iterator_next(PackedSeqIterator *iter, uint64_t *value);
+void packed_seq_iterator_destroy(PackedSeqIterator *iter);
+
+#endif
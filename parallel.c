@@ -0,0 +1,175 @@
+#include "parallel.h"
+
+#include "alloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// leaves per worker when the caller leaves the grain to us
+#define LEAVES_PER_WORKER 8
+// ranges per worker for rbtree_parallel_for
+#define TREE_PARTS_PER_WORKER 4
+
+typedef struct
+{
+    TaskPool *pool;
+    const Seq *seq;
+    size_t grain;
+    size_t start;
+    size_t end;
+    void (*fn)(void *item, size_t index, void *context);
+    void (*map)(void *acc, const void *item, void *context);
+    void (*combine)(void *acc, const void *other, void *context);
+    const void *identity;
+    void *acc;
+    size_t acc_size;
+    void *context;
+} SeqRange;
+
+static size_t default_grain(TaskPool *pool, size_t length, size_t grain)
+{
+    if (grain > 0)
+    {
+        return grain;
+    }
+    grain = length / ((size_t)task_pool_workers(pool) * LEAVES_PER_WORKER);
+    return grain > 0 ? grain : 1;
+}
+
+static void for_range(void *arg)
+{
+    SeqRange *range = arg;
+
+    if (range->end - range->start <= range->grain)
+    {
+        for (size_t i = range->start; i < range->end; i++)
+        {
+            range->fn(seq_at(range->seq, i), i, range->context);
+        }
+        return;
+    }
+
+    // hand the left half to thieves, keep splitting the right one here
+    SeqRange left = *range;
+    SeqRange right = *range;
+    left.end = right.start = range->start + (range->end - range->start) / 2;
+
+    TaskGroup group = TASK_GROUP_INIT;
+    task_pool_spawn(range->pool, &group, for_range, &left);
+    for_range(&right);
+    task_pool_sync(range->pool, &group);
+}
+
+void seq_parallel_for(TaskPool *pool, const Seq *seq, size_t grain,
+                      void (*fn)(void *item, size_t index, void *context), void *context)
+{
+    SeqRange range = { 0 };
+    range.pool = pool;
+    range.seq = seq;
+    range.grain = default_grain(pool, seq_length(seq), grain);
+    range.end = seq_length(seq);
+    range.fn = fn;
+    range.context = context;
+
+    for_range(&range);
+}
+
+static void reduce_range(void *arg)
+{
+    SeqRange *range = arg;
+
+    if (range->end - range->start <= range->grain)
+    {
+        for (size_t i = range->start; i < range->end; i++)
+        {
+            range->map(range->acc, seq_at(range->seq, i), range->context);
+        }
+        return;
+    }
+
+    // the left half folds into our accumulator, the right half into a fresh one
+    SeqRange left = *range;
+    SeqRange right = *range;
+    left.end = right.start = range->start + (range->end - range->start) / 2;
+    right.acc = xmemdup(range->identity, range->acc_size);
+
+    TaskGroup group = TASK_GROUP_INIT;
+    task_pool_spawn(range->pool, &group, reduce_range, &left);
+    reduce_range(&right);
+    task_pool_sync(range->pool, &group);
+
+    range->combine(range->acc, right.acc, range->context);
+    xfree(right.acc);
+}
+
+void seq_parallel_map_reduce(TaskPool *pool, const Seq *seq, size_t grain,
+                             void (*map)(void *acc, const void *item, void *context),
+                             void (*combine)(void *acc, const void *other, void *context),
+                             const void *identity, void *result, size_t result_size, void *context)
+{
+    assert(result_size > 0);
+
+    SeqRange range = { 0 };
+    range.pool = pool;
+    range.seq = seq;
+    range.grain = default_grain(pool, seq_length(seq), grain);
+    range.end = seq_length(seq);
+    range.map = map;
+    range.combine = combine;
+    range.identity = identity;
+    range.acc = result;
+    range.acc_size = result_size;
+    range.context = context;
+
+    memcpy(result, identity, result_size);
+    reduce_range(&range);
+}
+
+typedef struct
+{
+    const RBTree *tree;
+    RBNode *start;
+    RBNode *end;
+    void (*fn)(void *key, void *value, void *context);
+    void *context;
+} TreeRange;
+
+static void tree_range(void *arg)
+{
+    TreeRange *range = arg;
+
+    for (RBNode *node = range->start; node != range->end; node = rbtree_next(range->tree, node))
+    {
+        range->fn(rbtree_node_key(node), rbtree_node_value(node), range->context);
+    }
+}
+
+void rbtree_parallel_for(TaskPool *pool, const RBTree *tree,
+                         void (*fn)(void *key, void *value, void *context), void *context)
+{
+    size_t max_parts = (size_t)task_pool_workers(pool) * TREE_PARTS_PER_WORKER;
+    RBNode **starts = xmalloc(sizeof(RBNode *) * max_parts);
+    size_t parts = rbtree_split(tree, max_parts, starts);
+
+    if (parts > 0)
+    {
+        TreeRange *ranges = xmalloc(sizeof(TreeRange) * parts);
+        TaskGroup group = TASK_GROUP_INIT;
+
+        for (size_t i = 0; i < parts; i++)
+        {
+            ranges[i] = (TreeRange){ tree, starts[i], i + 1 < parts ? starts[i + 1] : NULL, fn, context };
+            if (i > 0)
+            {
+                task_pool_spawn(pool, &group, tree_range, &ranges[i]);
+            }
+        }
+        tree_range(&ranges[0]);
+        task_pool_sync(pool, &group);
+
+        xfree(ranges);
+    }
+
+    xfree(starts);
+}
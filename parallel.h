@@ -0,0 +1,35 @@
+#ifndef LIBUTILS_PARALLEL_H
+#define LIBUTILS_PARALLEL_H
+
+#include <stddef.h>
+
+#include "rb-tree.h"
+#include "seq.h"
+#include "task-pool.h"
+
+/*
+ * Data-parallel loops over containers, run on a TaskPool. Ranges are split
+ * in halves until they hold at most grain items (grain == 0 picks one), so
+ * idle workers steal big chunks first. Items are passed as seq_at() returns
+ * them. The containers must not be modified while a loop runs.
+ */
+
+void seq_parallel_for(TaskPool *pool, const Seq *seq, size_t grain,
+                      void (*fn)(void *item, size_t index, void *context), void *context);
+
+/**
+ * Folds the Seq into result, which holds result_size bytes. Each leaf range
+ * starts from a copy of identity and folds its items in with map; adjacent
+ * ranges are then merged left to right with combine(acc, other), so combine
+ * only has to be associative.
+ */
+void seq_parallel_map_reduce(TaskPool *pool, const Seq *seq, size_t grain,
+                             void (*map)(void *acc, const void *item, void *context),
+                             void (*combine)(void *acc, const void *other, void *context),
+                             const void *identity, void *result, size_t result_size, void *context);
+
+// Runs fn over every entry, on ranges from rbtree_split()
+void rbtree_parallel_for(TaskPool *pool, const RBTree *tree,
+                         void (*fn)(void *key, void *value, void *context), void *context);
+
+#endif
@@ -3,20 +3,40 @@
 #include "alloc.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
-typedef struct _RBNode RBNode;
+#if defined(__GNUC__)
+#define PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define PREFETCH(addr)
+#endif
+
+#define GET_MANY_LANES 16
 
 struct _RBNode
 {
     void *key;
     void *value;
     bool red;
+    bool compacted;
+    // carries caller storage after the node, see rbtree_insert
+    bool has_data;
     RBNode *parent;
     RBNode *left;
     RBNode *right;
 };
 
+typedef union
+{
+    void *p;
+    long long ll;
+    long double ld;
+} MaxAlign;
+
+// keeps node data aligned like malloc() memory
+#define NODE_DATA_OFFSET ((sizeof(RBNode) + sizeof(MaxAlign) - 1) / sizeof(MaxAlign) * sizeof(MaxAlign))
+
 struct _RBTree
 {
     void *(*key_copy)(const void *key);
@@ -29,7 +49,12 @@ struct _RBTree
 
     struct _RBNode *root;
     struct _RBNode *nil;
-    unsigned int size;
+    size_t size;
+
+    // contiguous node block produced by rbtree_compact
+    RBNode *block;
+
+    Allocator allocator;
 };
 
 struct _RBTreeIterator
@@ -53,12 +78,15 @@ static void *noop_copy(const void *a)
     return (void *)a;
 }
 
-static RBNode *node_new(RBTree *tree, RBNode *parent, bool red, const void *key, const void *value)
+static RBNode *node_new(RBTree *tree, RBNode *parent, bool red, const void *key, const void *value,
+                        size_t data_size)
 {
-    RBNode *node = xmalloc(sizeof(RBNode));
+    RBNode *node = alloc_malloc(&tree->allocator, data_size > 0 ? NODE_DATA_OFFSET + data_size : sizeof(RBNode));
 
     node->parent = parent;
     node->red = red;
+    node->compacted = false;
+    node->has_data = data_size > 0;
     node->key = tree->key_copy(key);
     node->value = tree->value_copy(value);
     node->left = tree->nil;
@@ -73,7 +101,12 @@ static void node_destroy(RBTree *tree, RBNode *node)
     {
         tree->key_destroy(node->key);
         tree->value_destroy(node->value);
-        free(node);
+
+        // nodes in the compacted block are released with the block
+        if (!node->compacted)
+        {
+            alloc_free(&tree->allocator, node);
+        }
     }
 }
 
@@ -88,7 +121,9 @@ RBTree *rbtree_new(void *(*key_copy)(const void *key),
     assert(!(key_copy && key_destroy) || (key_copy && key_destroy));
     assert(!(value_copy && value_destroy) || (value_copy && value_destroy));
 
-    RBTree *t = xmalloc(sizeof(RBTree));
+    Allocator allocator = alloc_get_allocator();
+    RBTree *t = alloc_malloc(&allocator, sizeof(RBTree));
+    t->allocator = allocator;
 
     t->key_copy = key_copy ? key_copy : noop_copy;
     t->key_compare = key_compare ? key_compare : pointer_compare;
@@ -98,17 +133,18 @@ RBTree *rbtree_new(void *(*key_copy)(const void *key),
     t->value_compare = value_compare ? value_compare : pointer_compare;
     t->value_destroy = value_destroy ? value_destroy : noop_destroy;
 
-    t->nil = xcalloc(1, sizeof(RBNode));
+    t->nil = alloc_calloc(&allocator, 1, sizeof(RBNode));
     t->nil->key = t->nil->value = NULL;
     t->nil->red = false;
     t->nil->parent = t->nil->left = t->nil->right = t->nil;
 
-    t->root = xcalloc(1, sizeof(RBNode));
+    t->root = alloc_calloc(&allocator, 1, sizeof(RBNode));
     t->root->key = t->root->value = NULL;
     t->root->red = false;
     t->root->parent = t->root->left = t->root->right = t->nil;
 
     t->size = 0;
+    t->block = NULL;
 
     return t;
 }
@@ -172,9 +208,11 @@ void rbtree_destroy(void *rb_tree)
     if (tree)
     {
         tree_destroy(tree, tree->root->left);
-        free(tree->root);
-        free(tree->nil);
-        free(tree);
+        Allocator allocator = tree->allocator;
+        alloc_free(&allocator, tree->block);
+        alloc_free(&allocator, tree->root);
+        alloc_free(&allocator, tree->nil);
+        alloc_free(&allocator, tree);
     }
 }
 
@@ -306,6 +344,21 @@ static void put_fix(RBTree *tree, RBNode *z)
     assert(!tree->root->red);
 }
 
+// hangs z below y, where the descent for its key ended
+static void node_link(RBTree *tree, RBNode *y, RBNode *z)
+{
+    if (y == tree->root || tree->key_compare(z->key, y->key) < 0)
+    {
+        y->left = z;
+    }
+    else
+    {
+        y->right = z;
+    }
+
+    put_fix(tree, z);
+    tree->size++;
+}
 
 bool rbtree_put(RBTree *tree, const void *key, const void *value)
 {
@@ -325,21 +378,34 @@ bool rbtree_put(RBTree *tree, const void *key, const void *value)
         x = (cmp < 0) ? x->left : x->right;
     }
 
-    RBNode *z = node_new(tree, y, true, key, value);
+    RBNode *z = node_new(tree, y, true, key, value, 0);
+    node_link(tree, y, z);
 
-    if (y == tree->root || tree->key_compare(z->key, y->key) < 0)
-    {
-        y->left = z;
-    }
-    else
+    return false;
+}
+
+RBNode *rbtree_insert(RBTree *tree, const void *key, const void *value, size_t data_size, bool *inserted)
+{
+    RBNode *y = tree->root;
+    RBNode *x = tree->root->left;
+
+    while (x != tree->nil)
     {
-        y->right = z;
+        y = x;
+        int cmp = tree->key_compare(key, x->key);
+        if (cmp == 0)
+        {
+            *inserted = false;
+            return x;
+        }
+        x = (cmp < 0) ? x->left : x->right;
     }
 
-    put_fix(tree, z);
-    tree->size++;
+    RBNode *z = node_new(tree, y, true, key, value, data_size);
+    node_link(tree, y, z);
 
-    return false;
+    *inserted = true;
+    return z;
 }
 
 static RBNode *node_next(const RBTree *tree, const RBNode *node)
@@ -358,6 +424,42 @@ static RBNode *node_next(const RBTree *tree, const RBNode *node)
     }
 }
 
+static RBNode *node_first(const RBTree *tree)
+{
+    RBNode *curr = tree->root->left;
+    if (curr != tree->nil)
+    {
+        for (; curr->left != tree->nil; curr = curr->left);
+    }
+    return curr;
+}
+
+static RBNode *node_prev(const RBTree *tree, const RBNode *node)
+{
+    if (node->left != tree->nil)
+    {
+        RBNode *curr;
+        for (curr = node->left; curr->right != tree->nil; curr = curr->right);
+        return curr;
+    }
+    else
+    {
+        RBNode *curr;
+        for (curr = node->parent; node == curr->left; node = curr, curr = curr->parent);
+        return (curr != tree->root) ? curr : tree->nil;
+    }
+}
+
+static RBNode *node_last(const RBTree *tree)
+{
+    RBNode *curr = tree->root->left;
+    if (curr != tree->nil)
+    {
+        for (; curr->right != tree->nil; curr = curr->right);
+    }
+    return curr;
+}
+
 static RBNode *node_get(const RBTree *tree, const void *key)
 {
     assert(!tree->nil->red);
@@ -390,6 +492,56 @@ void *rbtree_get(const RBTree *tree, const void *key)
     return node != tree->nil ? node->value : NULL;
 }
 
+void rbtree_get_many(const RBTree *tree, const void *const *keys, size_t count, void **values)
+{
+    assert(!tree->nil->red);
+
+    RBNode *curr[GET_MANY_LANES];
+
+    for (size_t base = 0; base < count; base += GET_MANY_LANES)
+    {
+        size_t lanes = (count - base < GET_MANY_LANES) ? count - base : GET_MANY_LANES;
+
+        for (size_t i = 0; i < lanes; i++)
+        {
+            curr[i] = tree->root->left;
+            values[base + i] = NULL;
+        }
+
+        // advance every search one level per pass, so the misses of
+        // independent searches overlap instead of serializing
+        bool active = true;
+        while (active)
+        {
+            active = false;
+            for (size_t i = 0; i < lanes; i++)
+            {
+                RBNode *node = curr[i];
+                if (node == tree->nil)
+                {
+                    continue;
+                }
+
+                int cmp = tree->key_compare(keys[base + i], node->key);
+                if (cmp == 0)
+                {
+                    values[base + i] = node->value;
+                    curr[i] = tree->nil;
+                    continue;
+                }
+
+                node = (cmp < 0) ? node->left : node->right;
+                curr[i] = node;
+
+                if (node != tree->nil)
+                {
+                    PREFETCH(node);
+                    active = true;
+                }
+            }
+        }
+    }
+}
 
 void remove_fix(RBTree *tree, RBNode *x)
 {
@@ -471,16 +623,10 @@ void remove_fix(RBTree *tree, RBNode *x)
     assert(!tree->nil->red);
 }
 
-bool rbtree_remove(RBTree *tree, const void *key)
+static void node_remove(RBTree *tree, RBNode *z)
 {
     assert(!tree->nil->red);
 
-    RBNode *z = node_get(tree, key);
-    if (z == tree->nil)
-    {
-        return false;
-    }
-
     RBNode *y = ((z->left == tree->nil) || (z->right == tree->nil)) ? z : node_next(tree, z);
     RBNode *x = (y->left == tree->nil) ? y->right : y->left;
 
@@ -540,9 +686,26 @@ bool rbtree_remove(RBTree *tree, const void *key)
     assert(!tree->nil->red);
 
     tree->size--;
+}
+
+bool rbtree_remove(RBTree *tree, const void *key)
+{
+    RBNode *z = node_get(tree, key);
+    if (z == tree->nil)
+    {
+        return false;
+    }
+
+    node_remove(tree, z);
     return true;
 }
 
+void rbtree_remove_node(RBTree *tree, RBNode *node)
+{
+    assert(node && node != tree->nil);
+    node_remove(tree, node);
+}
+
 void clear_recursive(RBTree *tree, RBNode *node)
 {
     if (node == tree->nil)
@@ -556,24 +719,248 @@ void clear_recursive(RBTree *tree, RBNode *node)
     node_destroy(tree, node);
 }
 
+static RBNode *compact_recursive(RBTree *tree, RBNode *x, RBNode *block, size_t *next)
+{
+    if (x == tree->nil)
+    {
+        return tree->nil;
+    }
+
+    RBNode *left = compact_recursive(tree, x->left, block, next);
+
+    // callers hold pointers into node data, so those nodes stay put
+    RBNode *y = x;
+    if (!x->has_data)
+    {
+        y = &block[(*next)++];
+        *y = *x;
+        y->compacted = true;
+    }
+
+    y->left = left;
+    if (left != tree->nil)
+    {
+        left->parent = y;
+    }
+
+    y->right = compact_recursive(tree, x->right, block, next);
+    if (y->right != tree->nil)
+    {
+        y->right->parent = y;
+    }
+
+    if (y != x && !x->compacted)
+    {
+        alloc_free(&tree->allocator, x);
+    }
+
+    return y;
+}
+
+void rbtree_compact(RBTree *tree)
+{
+    assert(tree);
+
+    RBNode *old_block = tree->block;
+    RBNode *block = NULL;
+
+    if (tree->size > 0)
+    {
+        block = alloc_malloc(&tree->allocator, sizeof(RBNode) * tree->size);
+
+        size_t next = 0;
+        tree->root->left = compact_recursive(tree, tree->root->left, block, &next);
+        tree->root->left->parent = tree->root;
+        assert(next <= tree->size);
+    }
+
+    alloc_free(&tree->allocator, old_block);
+    tree->block = block;
+}
+
+FrozenMap *rbtree_freeze(const RBTree *tree)
+{
+    assert(tree);
+
+    void **keys = NULL, **values = NULL;
+
+    if (tree->size > 0)
+    {
+        keys = xmalloc(sizeof(void *) * tree->size);
+        values = xmalloc(sizeof(void *) * tree->size);
+    }
+
+    size_t i = 0;
+    for (RBNode *node = node_first(tree); node != tree->nil; node = node_next(tree, node), i++)
+    {
+        keys[i] = tree->key_copy(node->key);
+        values[i] = tree->value_copy(node->value);
+    }
+    assert(i == tree->size);
+
+    FrozenMap *map = frozen_map_new(keys, values, tree->size, tree->key_compare,
+                                    tree->key_destroy, tree->value_destroy);
+
+    xfree(keys);
+    xfree(values);
+
+    return map;
+}
+
 void rbtree_clear(RBTree *tree)
 {
     assert(tree);
 
-    clear_recursive(tree, tree->root);
+    clear_recursive(tree, tree->root->left);
+    tree->root->left = tree->nil;
+    tree->size = 0;
+
+    alloc_free(&tree->allocator, tree->block);
+    tree->block = NULL;
 }
 
-unsigned int rbtree_size(const RBTree *tree)
+size_t rbtree_size(const RBTree *tree)
 {
     return tree->size;
 }
 
+typedef struct
+{
+    // range is lead (if any) followed by all of subtree
+    RBNode *lead;
+    RBNode *subtree;
+    size_t weight;
+} SplitPiece;
+
+static size_t subtree_weight(const RBTree *tree, const RBNode *node)
+{
+    // 2^(mean spine length) tracks the size well enough to pick what to split next
+    unsigned int left = 0;
+    unsigned int right = 0;
+    for (const RBNode *n = node; n != tree->nil; n = n->left, left++);
+    for (const RBNode *n = node; n != tree->nil; n = n->right, right++);
+
+    return left + right > 0 ? (size_t)1 << ((left + right) / 2) : 0;
+}
+
+size_t rbtree_split(const RBTree *tree, size_t max_parts, RBNode **starts)
+{
+    assert(max_parts > 0);
+
+    if (tree->size == 0)
+    {
+        return 0;
+    }
+
+    SplitPiece *pieces = xmalloc(sizeof(SplitPiece) * (max_parts + 1));
+    size_t count = 1;
+    pieces[0] = (SplitPiece){ NULL, tree->root->left, subtree_weight(tree, tree->root->left) };
+
+    // Greedily cut the heaviest piece at its subtree root
+    while (count < max_parts)
+    {
+        size_t heaviest = 0;
+        for (size_t i = 1; i < count; i++)
+        {
+            if (pieces[i].weight > pieces[heaviest].weight)
+            {
+                heaviest = i;
+            }
+        }
+
+        SplitPiece *piece = &pieces[heaviest];
+        RBNode *root = piece->subtree;
+        if (root == tree->nil)
+        {
+            break;
+        }
+
+        SplitPiece left = { piece->lead, root->left, subtree_weight(tree, root->left) };
+        SplitPiece right = { root, root->right, subtree_weight(tree, root->right) };
+        if (!left.lead && left.subtree == tree->nil)
+        {
+            *piece = right;
+            continue;
+        }
+
+        memmove(piece + 2, piece + 1, sizeof(SplitPiece) * (count - heaviest - 1));
+        piece[0] = left;
+        piece[1] = right;
+        count++;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        RBNode *start = pieces[i].lead;
+        if (!start)
+        {
+            for (start = pieces[i].subtree; start->left != tree->nil; start = start->left);
+        }
+        starts[i] = start;
+    }
+
+    xfree(pieces);
+    return count;
+}
+
+RBNode *rbtree_first(const RBTree *tree)
+{
+    RBNode *node = node_first(tree);
+    return node != tree->nil ? node : NULL;
+}
+
+RBNode *rbtree_last(const RBTree *tree)
+{
+    RBNode *node = node_last(tree);
+    return node != tree->nil ? node : NULL;
+}
+
+RBNode *rbtree_next(const RBTree *tree, const RBNode *node)
+{
+    RBNode *next = node_next(tree, node);
+    return next != tree->nil ? next : NULL;
+}
+
+RBNode *rbtree_prev(const RBTree *tree, const RBNode *node)
+{
+    RBNode *prev = node_prev(tree, node);
+    return prev != tree->nil ? prev : NULL;
+}
+
+RBNode *rbtree_find(const RBTree *tree, const void *key)
+{
+    RBNode *node = node_get(tree, key);
+    return node != tree->nil ? node : NULL;
+}
+
+void *rbtree_node_key(const RBNode *node)
+{
+    return node->key;
+}
+
+void *rbtree_node_value(const RBNode *node)
+{
+    return node->value;
+}
+
+void *rbtree_node_data(const RBNode *node)
+{
+    assert(node->has_data);
+    return (char *)node + NODE_DATA_OFFSET;
+}
+
+void rbtree_node_set(RBNode *node, const void *key, const void *value)
+{
+    node->key = (void *)key;
+    node->value = (void *)value;
+}
+
 RBTreeIterator *rbtree_iterator_new(const RBTree *tree)
 {
-    RBTreeIterator *iter = malloc(sizeof(RBTreeIterator));
+    RBTreeIterator *iter = alloc_malloc(&tree->allocator, sizeof(RBTreeIterator));
 
     iter->tree = tree;
-    for (iter->curr = iter->tree->root; iter->curr->left != tree->nil; iter->curr = iter->curr->left);
+    iter->curr = node_first(tree);
 
     return iter;
 }
@@ -613,5 +1000,9 @@ bool rbtree_iterator_next(RBTreeIterator *iter, void **key, void **value)
 
 void rbtree_iterator_destroy(void *_rb_iter)
 {
-    free(_rb_iter);
+    RBTreeIterator *iter = _rb_iter;
+    if (iter)
+    {
+        alloc_free(&iter->tree->allocator, iter);
+    }
 }
@@ -2,9 +2,13 @@
 #define LIBUTILS_RB_TREE_H
 
 #include <stdbool.h>
+#include <stddef.h>
+
+#include "frozen-map.h"
 
 typedef struct _RBTree RBTree;
 typedef struct _RBTreeIterator RBTreeIterator;
+typedef struct _RBNode RBNode;
 
 RBTree *rbtree_new(void *(*key_copy)(const void *key),
                    int (*key_compare)(const void *a, const void *b),
@@ -19,9 +23,50 @@ void rbtree_destroy(void *rb_tree);
 
 bool rbtree_put(RBTree *tree, const void *key, const void *value);
 void *rbtree_get(const RBTree *tree, const void *key);
+void rbtree_get_many(const RBTree *tree, const void *const *keys, size_t count, void **values);
 bool rbtree_remove(RBTree *tree, const void *key);
+// other nodes stay valid
+void rbtree_remove_node(RBTree *tree, RBNode *node);
 void rbtree_clear(RBTree *tree);
-unsigned int rbtree_size(const RBTree *tree);
+size_t rbtree_size(const RBTree *tree);
+
+/**
+ * Relocates all nodes into a single allocation, laid out in key order, so
+ * that iteration walks memory sequentially. Invalidates iterators.
+ */
+void rbtree_compact(RBTree *tree);
+
+// copies the contents into an immutable map optimized for lookups
+FrozenMap *rbtree_freeze(const RBTree *tree);
+
+// non-allocating traversal, NULL past either end
+RBNode *rbtree_first(const RBTree *tree);
+RBNode *rbtree_last(const RBTree *tree);
+RBNode *rbtree_next(const RBTree *tree, const RBNode *node);
+RBNode *rbtree_prev(const RBTree *tree, const RBNode *node);
+RBNode *rbtree_find(const RBTree *tree, const void *key);
+void *rbtree_node_key(const RBNode *node);
+void *rbtree_node_value(const RBNode *node);
+
+/**
+ * Finds key, or links a new node for it in the same descent, and returns
+ * the node either way; *inserted tells which. Unlike rbtree_put an existing
+ * value is left alone. A new node also carries data_size bytes of storage,
+ * aligned like malloc() memory, at rbtree_node_data(), so callers can build
+ * the entry there and then repoint the node at it with rbtree_node_set().
+ * rbtree_node_set() stores key and value as given; the key must compare
+ * equal to the old one. Nodes with storage stay put through rbtree_compact.
+ */
+RBNode *rbtree_insert(RBTree *tree, const void *key, const void *value, size_t data_size, bool *inserted);
+void *rbtree_node_data(const RBNode *node);
+void rbtree_node_set(RBNode *node, const void *key, const void *value);
+
+/**
+ * Cuts the tree into at most max_parts key ranges of roughly equal size for
+ * parallel scans. Range i runs from starts[i] up to starts[i + 1], the last
+ * one to the end of the tree. Returns the number of ranges.
+ */
+size_t rbtree_split(const RBTree *tree, size_t max_parts, RBNode **starts);
 
 RBTreeIterator *rbtree_iterator_new(const RBTree *tree);
 bool rbtree_iterator_next(RBTreeIterator *iter, void **key, void **value);
@@ -0,0 +1,465 @@
+#define _GNU_SOURCE
+
+#include "ring-queue.h"
+
+#include "alloc.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <sched.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#if !defined(__GNUC__)
+#error "ring-queue needs the GCC __atomic builtins"
+#endif
+
+#define CACHE_LINE 64
+
+#define LOAD(p, order) __atomic_load_n(p, __ATOMIC_##order)
+#define STORE(p, v, order) __atomic_store_n(p, v, __ATOMIC_##order)
+
+/*
+ * Eventcount for the blocking calls. A waiter registers, re-checks the
+ * queue and sleeps on the epoch; the other side bumps the epoch only
+ * when someone is registered. The fences pair up so that either the
+ * waiter sees the change or the notifier sees the waiter.
+ */
+typedef struct
+{
+    uint32_t epoch;
+    uint32_t waiters;
+    char pad[CACHE_LINE - 2 * sizeof(uint32_t)];
+} Event;
+
+static void futex_wait(uint32_t *addr, uint32_t value)
+{
+#if defined(__linux__)
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+#else
+    if (LOAD(addr, ACQUIRE) == value)
+    {
+        sched_yield();
+    }
+#endif
+}
+
+static void futex_wake_all(uint32_t *addr)
+{
+#if defined(__linux__)
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+static void event_notify(Event *event)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (LOAD(&event->waiters, RELAXED) > 0)
+    {
+        __atomic_add_fetch(&event->epoch, 1, __ATOMIC_SEQ_CST);
+        futex_wake_all(&event->epoch);
+    }
+}
+
+static uint32_t event_prepare(Event *event)
+{
+    __atomic_add_fetch(&event->waiters, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return LOAD(&event->epoch, SEQ_CST);
+}
+
+static void event_wait(Event *event, uint32_t epoch)
+{
+    futex_wait(&event->epoch, epoch);
+    __atomic_sub_fetch(&event->waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+static void event_cancel(Event *event)
+{
+    __atomic_sub_fetch(&event->waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+// the padding only separates the hot fields if the struct starts on a cache line
+static void *cache_line_calloc(const Allocator *allocator, size_t size, void **memory)
+{
+    *memory = alloc_calloc(allocator, 1, size + CACHE_LINE - 1);
+    return (void *)(((uintptr_t)*memory + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1));
+}
+
+static size_t round_capacity(size_t capacity)
+{
+    size_t rounded = 2;
+    while (rounded < capacity)
+    {
+        assert(rounded <= SIZE_MAX / 2);
+        rounded *= 2;
+    }
+    return rounded;
+}
+
+struct SPSCQueue_
+{
+    // producer side; head_cache avoids reading the consumer's line on every push
+    size_t tail;
+    size_t head_cache;
+    char pad0[CACHE_LINE - 2 * sizeof(size_t)];
+
+    // consumer side
+    size_t head;
+    size_t tail_cache;
+    char pad1[CACHE_LINE - 2 * sizeof(size_t)];
+
+    Event not_empty;
+    Event not_full;
+
+    size_t mask;
+    bool blocking;
+    void **slots;
+    // start of the allocation holding the queue
+    void *memory;
+    Allocator allocator;
+};
+
+SPSCQueue *spsc_queue_new(size_t capacity, bool blocking)
+{
+    Allocator allocator = alloc_get_allocator();
+    void *memory;
+    SPSCQueue *queue = cache_line_calloc(&allocator, sizeof(SPSCQueue), &memory);
+
+    queue->memory = memory;
+    queue->allocator = allocator;
+    queue->mask = round_capacity(capacity) - 1;
+    queue->blocking = blocking;
+    queue->slots = alloc_malloc(&allocator, sizeof(void *) * (queue->mask + 1));
+
+    return queue;
+}
+
+void spsc_queue_destroy(SPSCQueue *queue)
+{
+    if (queue)
+    {
+        Allocator allocator = queue->allocator;
+        alloc_free(&allocator, queue->slots);
+        alloc_free(&allocator, queue->memory);
+    }
+}
+
+size_t spsc_queue_capacity(const SPSCQueue *queue)
+{
+    return queue->mask + 1;
+}
+
+size_t spsc_queue_push_many(SPSCQueue *queue, void *const *items, size_t count)
+{
+    size_t tail = queue->tail;
+    size_t capacity = queue->mask + 1;
+
+    if (capacity - (tail - queue->head_cache) < count)
+    {
+        queue->head_cache = LOAD(&queue->head, ACQUIRE);
+    }
+    size_t room = capacity - (tail - queue->head_cache);
+    size_t n = count < room ? count : room;
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    size_t start = tail & queue->mask;
+    size_t first = n < capacity - start ? n : capacity - start;
+    memcpy(queue->slots + start, items, sizeof(void *) * first);
+    memcpy(queue->slots, items + first, sizeof(void *) * (n - first));
+
+    STORE(&queue->tail, tail + n, RELEASE);
+    if (queue->blocking)
+    {
+        event_notify(&queue->not_empty);
+    }
+
+    return n;
+}
+
+size_t spsc_queue_pop_many(SPSCQueue *queue, void **items, size_t count)
+{
+    size_t head = queue->head;
+
+    if (queue->tail_cache - head < count)
+    {
+        queue->tail_cache = LOAD(&queue->tail, ACQUIRE);
+    }
+    size_t available = queue->tail_cache - head;
+    size_t n = count < available ? count : available;
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    size_t capacity = queue->mask + 1;
+    size_t start = head & queue->mask;
+    size_t first = n < capacity - start ? n : capacity - start;
+    memcpy(items, queue->slots + start, sizeof(void *) * first);
+    memcpy(items + first, queue->slots, sizeof(void *) * (n - first));
+
+    STORE(&queue->head, head + n, RELEASE);
+    if (queue->blocking)
+    {
+        event_notify(&queue->not_full);
+    }
+
+    return n;
+}
+
+bool spsc_queue_push(SPSCQueue *queue, void *item)
+{
+    return spsc_queue_push_many(queue, &item, 1) == 1;
+}
+
+bool spsc_queue_pop(SPSCQueue *queue, void **item)
+{
+    return spsc_queue_pop_many(queue, item, 1) == 1;
+}
+
+void spsc_queue_push_wait(SPSCQueue *queue, void *item)
+{
+    assert(queue->blocking);
+
+    while (!spsc_queue_push(queue, item))
+    {
+        uint32_t epoch = event_prepare(&queue->not_full);
+        if (spsc_queue_push(queue, item))
+        {
+            event_cancel(&queue->not_full);
+            return;
+        }
+        event_wait(&queue->not_full, epoch);
+    }
+}
+
+void *spsc_queue_pop_wait(SPSCQueue *queue)
+{
+    assert(queue->blocking);
+
+    void *item;
+    while (!spsc_queue_pop(queue, &item))
+    {
+        uint32_t epoch = event_prepare(&queue->not_empty);
+        if (spsc_queue_pop(queue, &item))
+        {
+            event_cancel(&queue->not_empty);
+            break;
+        }
+        event_wait(&queue->not_empty, epoch);
+    }
+    return item;
+}
+
+typedef struct
+{
+    size_t sequence;
+    void *item;
+} Cell;
+
+struct MPMCQueue_
+{
+    size_t enqueue_pos;
+    char pad0[CACHE_LINE - sizeof(size_t)];
+    size_t dequeue_pos;
+    char pad1[CACHE_LINE - sizeof(size_t)];
+
+    Event not_empty;
+    Event not_full;
+
+    size_t mask;
+    bool blocking;
+    Cell *cells;
+    void *memory;
+    Allocator allocator;
+};
+
+MPMCQueue *mpmc_queue_new(size_t capacity, bool blocking)
+{
+    Allocator allocator = alloc_get_allocator();
+    void *memory;
+    MPMCQueue *queue = cache_line_calloc(&allocator, sizeof(MPMCQueue), &memory);
+
+    queue->memory = memory;
+    queue->allocator = allocator;
+    queue->mask = round_capacity(capacity) - 1;
+    queue->blocking = blocking;
+    queue->cells = alloc_malloc(&allocator, sizeof(Cell) * (queue->mask + 1));
+    for (size_t i = 0; i <= queue->mask; i++)
+    {
+        queue->cells[i].sequence = i;
+    }
+
+    return queue;
+}
+
+void mpmc_queue_destroy(MPMCQueue *queue)
+{
+    if (queue)
+    {
+        Allocator allocator = queue->allocator;
+        alloc_free(&allocator, queue->cells);
+        alloc_free(&allocator, queue->memory);
+    }
+}
+
+size_t mpmc_queue_capacity(const MPMCQueue *queue)
+{
+    return queue->mask + 1;
+}
+
+/*
+ * A cell's sequence says whose turn it is: equal to the position when a
+ * producer may fill it, position + 1 when a consumer may empty it. The
+ * positions are claimed with a CAS, the cells handed over with the
+ * sequence store.
+ */
+static bool mpmc_push(MPMCQueue *queue, void *item)
+{
+    size_t pos = LOAD(&queue->enqueue_pos, RELAXED);
+    Cell *cell;
+
+    for (;;)
+    {
+        cell = &queue->cells[pos & queue->mask];
+        intptr_t diff = (intptr_t)LOAD(&cell->sequence, ACQUIRE) - (intptr_t)pos;
+
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&queue->enqueue_pos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = LOAD(&queue->enqueue_pos, RELAXED);
+        }
+    }
+
+    cell->item = item;
+    STORE(&cell->sequence, pos + 1, RELEASE);
+    return true;
+}
+
+static bool mpmc_pop(MPMCQueue *queue, void **item)
+{
+    size_t pos = LOAD(&queue->dequeue_pos, RELAXED);
+    Cell *cell;
+
+    for (;;)
+    {
+        cell = &queue->cells[pos & queue->mask];
+        intptr_t diff = (intptr_t)LOAD(&cell->sequence, ACQUIRE) - (intptr_t)(pos + 1);
+
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&queue->dequeue_pos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = LOAD(&queue->dequeue_pos, RELAXED);
+        }
+    }
+
+    *item = cell->item;
+    STORE(&cell->sequence, pos + queue->mask + 1, RELEASE);
+    return true;
+}
+
+size_t mpmc_queue_push_many(MPMCQueue *queue, void *const *items, size_t count)
+{
+    size_t n = 0;
+    while (n < count && mpmc_push(queue, items[n]))
+    {
+        n++;
+    }
+
+    if (n > 0 && queue->blocking)
+    {
+        event_notify(&queue->not_empty);
+    }
+    return n;
+}
+
+size_t mpmc_queue_pop_many(MPMCQueue *queue, void **items, size_t count)
+{
+    size_t n = 0;
+    while (n < count && mpmc_pop(queue, &items[n]))
+    {
+        n++;
+    }
+
+    if (n > 0 && queue->blocking)
+    {
+        event_notify(&queue->not_full);
+    }
+    return n;
+}
+
+bool mpmc_queue_push(MPMCQueue *queue, void *item)
+{
+    return mpmc_queue_push_many(queue, &item, 1) == 1;
+}
+
+bool mpmc_queue_pop(MPMCQueue *queue, void **item)
+{
+    return mpmc_queue_pop_many(queue, item, 1) == 1;
+}
+
+void mpmc_queue_push_wait(MPMCQueue *queue, void *item)
+{
+    assert(queue->blocking);
+
+    while (!mpmc_queue_push(queue, item))
+    {
+        uint32_t epoch = event_prepare(&queue->not_full);
+        if (mpmc_queue_push(queue, item))
+        {
+            event_cancel(&queue->not_full);
+            return;
+        }
+        event_wait(&queue->not_full, epoch);
+    }
+}
+
+void *mpmc_queue_pop_wait(MPMCQueue *queue)
+{
+    assert(queue->blocking);
+
+    void *item;
+    while (!mpmc_queue_pop(queue, &item))
+    {
+        uint32_t epoch = event_prepare(&queue->not_empty);
+        if (mpmc_queue_pop(queue, &item))
+        {
+            event_cancel(&queue->not_empty);
+            break;
+        }
+        event_wait(&queue->not_empty, epoch);
+    }
+    return item;
+}
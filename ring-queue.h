@@ -0,0 +1,45 @@
+#ifndef LIBUTILS_RING_QUEUE_H
+#define LIBUTILS_RING_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Bounded lock-free queues of pointers for handing work between threads.
+ * Capacities are rounded up to a power of two. The queues own nothing:
+ * items still queued at destroy time are the caller's to free.
+ *
+ * The *_wait calls block while the queue is full or empty. They only work
+ * on queues created with blocking set, which makes every push and pop pay
+ * for a memory fence so that sleepers are never missed.
+ */
+
+typedef struct SPSCQueue_ SPSCQueue;
+typedef struct MPMCQueue_ MPMCQueue;
+
+// One producer thread and one consumer thread; push and pop are wait-free
+SPSCQueue *spsc_queue_new(size_t capacity, bool blocking);
+void spsc_queue_destroy(SPSCQueue *queue);
+size_t spsc_queue_capacity(const SPSCQueue *queue);
+
+bool spsc_queue_push(SPSCQueue *queue, void *item);
+bool spsc_queue_pop(SPSCQueue *queue, void **item);
+// Move as many items as fit or are available, returns how many
+size_t spsc_queue_push_many(SPSCQueue *queue, void *const *items, size_t count);
+size_t spsc_queue_pop_many(SPSCQueue *queue, void **items, size_t count);
+void spsc_queue_push_wait(SPSCQueue *queue, void *item);
+void *spsc_queue_pop_wait(SPSCQueue *queue);
+
+// Any number of producers and consumers (Vyukov's bounded queue)
+MPMCQueue *mpmc_queue_new(size_t capacity, bool blocking);
+void mpmc_queue_destroy(MPMCQueue *queue);
+size_t mpmc_queue_capacity(const MPMCQueue *queue);
+
+bool mpmc_queue_push(MPMCQueue *queue, void *item);
+bool mpmc_queue_pop(MPMCQueue *queue, void **item);
+size_t mpmc_queue_push_many(MPMCQueue *queue, void *const *items, size_t count);
+size_t mpmc_queue_pop_many(MPMCQueue *queue, void **items, size_t count);
+void mpmc_queue_push_wait(MPMCQueue *queue, void *item);
+void *mpmc_queue_pop_wait(MPMCQueue *queue);
+
+#endif
@@ -0,0 +1,889 @@
+#include "roaring-set.h"
+
+#include "alloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// past this many values a bitmap is smaller than an array
+#define ARRAY_MAX 4096
+#define BITMAP_WORDS 1024
+#define BITMAP_BYTES (BITMAP_WORDS * sizeof(uint64_t))
+
+enum
+{
+    ARRAY,
+    BITMAP,
+    RUN
+};
+
+typedef struct
+{
+    uint16_t start;
+    uint16_t last;
+} Run;
+
+typedef struct
+{
+    // high 16 bits of the values held
+    uint16_t key;
+    uint8_t type;
+    uint32_t cardinality;
+    // slots in use and allocated, for arrays and runs
+    uint32_t length;
+    uint32_t capacity;
+    void *data;
+} Container;
+
+struct RoaringSet_
+{
+    Container *containers;
+    size_t count;
+    size_t capacity;
+    size_t size;
+    Allocator allocator;
+};
+
+struct RoaringSetIterator_
+{
+    const RoaringSet *set;
+    size_t container;
+    // array index, next bit to look at, or run index
+    uint32_t pos;
+    uint32_t run_offset;
+};
+
+static unsigned int popcount64(uint64_t w)
+{
+#if defined(__GNUC__)
+    return __builtin_popcountll(w);
+#else
+    w = w - ((w >> 1) & UINT64_C(0x5555555555555555));
+    w = (w & UINT64_C(0x3333333333333333)) + ((w >> 2) & UINT64_C(0x3333333333333333));
+    w = (w + (w >> 4)) & UINT64_C(0x0f0f0f0f0f0f0f0f);
+    return (unsigned int)((w * UINT64_C(0x0101010101010101)) >> 56);
+#endif
+}
+
+static unsigned int ctz64(uint64_t w)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(w);
+#else
+    unsigned int n = 0;
+    while (!(w & 1))
+    {
+        w >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+static uint32_t bitmap_count(const uint64_t *bits)
+{
+    uint32_t count = 0;
+    for (size_t i = 0; i < BITMAP_WORDS; i++)
+    {
+        count += popcount64(bits[i]);
+    }
+    return count;
+}
+
+static void bitmap_or(uint64_t *dst, const uint64_t *src)
+{
+#if defined(__AVX2__)
+    for (size_t i = 0; i < BITMAP_WORDS; i += 4)
+    {
+        __m256i v = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(dst + i)),
+                                    _mm256_loadu_si256((const __m256i *)(src + i)));
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+#else
+    for (size_t i = 0; i < BITMAP_WORDS; i++)
+    {
+        dst[i] |= src[i];
+    }
+#endif
+}
+
+static void bitmap_and(uint64_t *dst, const uint64_t *src)
+{
+#if defined(__AVX2__)
+    for (size_t i = 0; i < BITMAP_WORDS; i += 4)
+    {
+        __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(dst + i)),
+                                     _mm256_loadu_si256((const __m256i *)(src + i)));
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+#else
+    for (size_t i = 0; i < BITMAP_WORDS; i++)
+    {
+        dst[i] &= src[i];
+    }
+#endif
+}
+
+static void bitmap_set_range(uint64_t *bits, uint32_t start, uint32_t last)
+{
+    uint32_t first_word = start >> 6;
+    uint32_t last_word = last >> 6;
+    uint64_t first_mask = ~UINT64_C(0) << (start & 63);
+    uint64_t last_mask = ~UINT64_C(0) >> (63 - (last & 63));
+
+    if (first_word == last_word)
+    {
+        bits[first_word] |= first_mask & last_mask;
+        return;
+    }
+    bits[first_word] |= first_mask;
+    for (uint32_t w = first_word + 1; w < last_word; w++)
+    {
+        bits[w] = ~UINT64_C(0);
+    }
+    bits[last_word] |= last_mask;
+}
+
+static size_t array_lower_bound(const uint16_t *array, size_t length, uint16_t value)
+{
+    size_t lo = 0;
+    size_t hi = length;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (array[mid] < value)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static bool run_contains(const Container *c, uint16_t value)
+{
+    const Run *runs = c->data;
+    size_t lo = 0;
+    size_t hi = c->length;
+    // first run not ending before value
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (runs[mid].last < value)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo < c->length && runs[lo].start <= value;
+}
+
+static bool container_contains(const Container *c, uint16_t value)
+{
+    switch (c->type)
+    {
+    case ARRAY:
+    {
+        const uint16_t *array = c->data;
+        size_t pos = array_lower_bound(array, c->length, value);
+        return pos < c->length && array[pos] == value;
+    }
+    case BITMAP:
+        return (((const uint64_t *)c->data)[value >> 6] >> (value & 63)) & 1;
+    default:
+        return run_contains(c, value);
+    }
+}
+
+static size_t container_bytes(const Container *c)
+{
+    switch (c->type)
+    {
+    case ARRAY:
+        return c->capacity * sizeof(uint16_t);
+    case BITMAP:
+        return BITMAP_BYTES;
+    default:
+        return c->capacity * sizeof(Run);
+    }
+}
+
+static void container_reserve(RoaringSet *set, Container *c, uint32_t needed, size_t slot_size, uint32_t max)
+{
+    if (needed > c->capacity)
+    {
+        uint32_t capacity = c->capacity ? c->capacity * 2 : 4;
+        capacity = capacity < needed ? needed : capacity;
+        capacity = capacity > max ? max : capacity;
+        c->data = alloc_realloc(&set->allocator, c->data, slot_size * capacity);
+        c->capacity = capacity;
+    }
+}
+
+// Sets the bits of c's values in bits
+static void container_or_into(const Container *c, uint64_t *bits)
+{
+    switch (c->type)
+    {
+    case ARRAY:
+    {
+        const uint16_t *array = c->data;
+        for (uint32_t i = 0; i < c->length; i++)
+        {
+            bits[array[i] >> 6] |= UINT64_C(1) << (array[i] & 63);
+        }
+        break;
+    }
+    case BITMAP:
+        bitmap_or(bits, c->data);
+        break;
+    default:
+    {
+        const Run *runs = c->data;
+        for (uint32_t i = 0; i < c->length; i++)
+        {
+            bitmap_set_range(bits, runs[i].start, runs[i].last);
+        }
+        break;
+    }
+    }
+}
+
+static uint16_t *bitmap_to_values(RoaringSet *set, const uint64_t *bits, uint32_t cardinality)
+{
+    uint16_t *array = alloc_malloc(&set->allocator, sizeof(uint16_t) * (cardinality > 0 ? cardinality : 1));
+    uint32_t n = 0;
+
+    for (uint32_t w = 0; w < BITMAP_WORDS; w++)
+    {
+        uint64_t word = bits[w];
+        while (word)
+        {
+            array[n++] = (uint16_t)(w * 64 + ctz64(word));
+            word &= word - 1;
+        }
+    }
+
+    return array;
+}
+
+// Makes c hold bits, as an array if that is smaller; takes ownership of bits
+static void container_set_bits(RoaringSet *set, Container *c, uint64_t *bits, uint32_t cardinality)
+{
+    c->cardinality = cardinality;
+    if (cardinality <= ARRAY_MAX)
+    {
+        c->type = ARRAY;
+        c->data = bitmap_to_values(set, bits, cardinality);
+        c->length = c->capacity = cardinality;
+        alloc_free(&set->allocator, bits);
+    }
+    else
+    {
+        c->type = BITMAP;
+        c->data = bits;
+        c->length = c->capacity = 0;
+    }
+}
+
+static void array_to_bitmap(RoaringSet *set, Container *c)
+{
+    uint64_t *bits = alloc_calloc(&set->allocator, BITMAP_WORDS, sizeof(uint64_t));
+    container_or_into(c, bits);
+    alloc_free(&set->allocator, c->data);
+    c->type = BITMAP;
+    c->data = bits;
+    c->length = c->capacity = 0;
+}
+
+// Turns runs back into an array or bitmap ahead of a change
+static void run_expand(RoaringSet *set, Container *c)
+{
+    uint64_t *bits = alloc_calloc(&set->allocator, BITMAP_WORDS, sizeof(uint64_t));
+    container_or_into(c, bits);
+    alloc_free(&set->allocator, c->data);
+    container_set_bits(set, c, bits, c->cardinality);
+}
+
+static uint32_t count_runs(const Container *c)
+{
+    uint32_t runs = 0;
+
+    switch (c->type)
+    {
+    case ARRAY:
+    {
+        const uint16_t *array = c->data;
+        for (uint32_t i = 0; i < c->length; i++)
+        {
+            runs += i == 0 || array[i] != array[i - 1] + 1;
+        }
+        break;
+    }
+    case BITMAP:
+    {
+        const uint64_t *bits = c->data;
+        uint64_t carry = 0;
+        for (uint32_t w = 0; w < BITMAP_WORDS; w++)
+        {
+            // a run starts at each set bit whose predecessor is clear
+            runs += popcount64(bits[w] & ~((bits[w] << 1) | carry));
+            carry = bits[w] >> 63;
+        }
+        break;
+    }
+    default:
+        runs = c->length;
+        break;
+    }
+
+    return runs;
+}
+
+static void container_to_runs(RoaringSet *set, Container *c, uint32_t count)
+{
+    Run *runs = alloc_malloc(&set->allocator, sizeof(Run) * count);
+    uint32_t n = 0;
+
+    if (c->type == ARRAY)
+    {
+        const uint16_t *array = c->data;
+        for (uint32_t i = 0; i < c->length; i++)
+        {
+            if (n > 0 && array[i] == runs[n - 1].last + 1)
+            {
+                runs[n - 1].last = array[i];
+            }
+            else
+            {
+                runs[n].start = runs[n].last = array[i];
+                n++;
+            }
+        }
+    }
+    else
+    {
+        const uint64_t *bits = c->data;
+        for (uint32_t w = 0; w < BITMAP_WORDS; w++)
+        {
+            uint64_t word = bits[w];
+            while (word)
+            {
+                uint16_t value = (uint16_t)(w * 64 + ctz64(word));
+                word &= word - 1;
+                if (n > 0 && value == runs[n - 1].last + 1)
+                {
+                    runs[n - 1].last = value;
+                }
+                else
+                {
+                    runs[n].start = runs[n].last = value;
+                    n++;
+                }
+            }
+        }
+    }
+
+    assert(n == count);
+    alloc_free(&set->allocator, c->data);
+    c->type = RUN;
+    c->data = runs;
+    c->length = c->capacity = count;
+}
+
+static size_t find_container(const RoaringSet *set, uint16_t key)
+{
+    size_t lo = 0;
+    size_t hi = set->count;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (set->containers[mid].key < key)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static Container *insert_container(RoaringSet *set, size_t index, uint16_t key)
+{
+    if (set->count == set->capacity)
+    {
+        set->capacity = set->capacity ? set->capacity * 2 : 4;
+        set->containers = alloc_realloc(&set->allocator, set->containers, sizeof(Container) * set->capacity);
+    }
+    memmove(set->containers + index + 1, set->containers + index,
+            sizeof(Container) * (set->count - index));
+    set->count++;
+
+    Container *c = &set->containers[index];
+    memset(c, 0, sizeof(Container));
+    c->key = key;
+    c->type = ARRAY;
+    return c;
+}
+
+RoaringSet *roaring_set_new(void)
+{
+    Allocator allocator = alloc_get_allocator();
+    RoaringSet *set = alloc_calloc(&allocator, 1, sizeof(RoaringSet));
+    set->allocator = allocator;
+    return set;
+}
+
+void roaring_set_destroy(RoaringSet *set)
+{
+    if (set)
+    {
+        roaring_set_clear(set);
+        Allocator allocator = set->allocator;
+        alloc_free(&allocator, set->containers);
+        alloc_free(&allocator, set);
+    }
+}
+
+void roaring_set_clear(RoaringSet *set)
+{
+    for (size_t i = 0; i < set->count; i++)
+    {
+        alloc_free(&set->allocator, set->containers[i].data);
+    }
+    set->count = 0;
+    set->size = 0;
+}
+
+size_t roaring_set_size(const RoaringSet *set)
+{
+    return set->size;
+}
+
+size_t roaring_set_memory(const RoaringSet *set)
+{
+    size_t bytes = sizeof(RoaringSet) + sizeof(Container) * set->capacity;
+    for (size_t i = 0; i < set->count; i++)
+    {
+        bytes += container_bytes(&set->containers[i]);
+    }
+    return bytes;
+}
+
+bool roaring_set_add(RoaringSet *set, uint32_t value)
+{
+    uint16_t key = value >> 16;
+    uint16_t low = value & 0xffff;
+
+    size_t index = find_container(set, key);
+    Container *c = index < set->count && set->containers[index].key == key
+                   ? &set->containers[index]
+                   : insert_container(set, index, key);
+
+    if (c->type == RUN)
+    {
+        if (run_contains(c, low))
+        {
+            return false;
+        }
+        run_expand(set, c);
+    }
+
+    if (c->type == ARRAY)
+    {
+        uint16_t *array = c->data;
+        size_t pos = array_lower_bound(array, c->length, low);
+        if (pos < c->length && array[pos] == low)
+        {
+            return false;
+        }
+
+        if (c->cardinality < ARRAY_MAX)
+        {
+            container_reserve(set, c, c->length + 1, sizeof(uint16_t), ARRAY_MAX);
+            array = c->data;
+            memmove(array + pos + 1, array + pos, sizeof(uint16_t) * (c->length - pos));
+            array[pos] = low;
+            c->length++;
+            c->cardinality++;
+            set->size++;
+            return true;
+        }
+        array_to_bitmap(set, c);
+    }
+
+    uint64_t *word = &((uint64_t *)c->data)[low >> 6];
+    uint64_t bit = UINT64_C(1) << (low & 63);
+    if (*word & bit)
+    {
+        return false;
+    }
+    *word |= bit;
+    c->cardinality++;
+    set->size++;
+    return true;
+}
+
+bool roaring_set_contains(const RoaringSet *set, uint32_t value)
+{
+    uint16_t key = value >> 16;
+    size_t index = find_container(set, key);
+    return index < set->count && set->containers[index].key == key
+           && container_contains(&set->containers[index], value & 0xffff);
+}
+
+bool roaring_set_remove(RoaringSet *set, uint32_t value)
+{
+    uint16_t key = value >> 16;
+    uint16_t low = value & 0xffff;
+
+    size_t index = find_container(set, key);
+    if (index == set->count || set->containers[index].key != key)
+    {
+        return false;
+    }
+
+    Container *c = &set->containers[index];
+    if (!container_contains(c, low))
+    {
+        return false;
+    }
+    if (c->type == RUN)
+    {
+        run_expand(set, c);
+    }
+
+    if (c->type == ARRAY)
+    {
+        uint16_t *array = c->data;
+        size_t pos = array_lower_bound(array, c->length, low);
+        memmove(array + pos, array + pos + 1, sizeof(uint16_t) * (c->length - pos - 1));
+        c->length--;
+    }
+    else
+    {
+        ((uint64_t *)c->data)[low >> 6] &= ~(UINT64_C(1) << (low & 63));
+    }
+    c->cardinality--;
+    set->size--;
+
+    // a bitmap stays one until half the array limit, so that a group
+    // hovering around the limit does not convert on every change
+    if (c->type == BITMAP && c->cardinality <= ARRAY_MAX / 2)
+    {
+        uint64_t *bits = c->data;
+        container_set_bits(set, c, bits, c->cardinality);
+    }
+    if (c->cardinality == 0)
+    {
+        alloc_free(&set->allocator, c->data);
+        memmove(set->containers + index, set->containers + index + 1,
+                sizeof(Container) * (set->count - index - 1));
+        set->count--;
+    }
+
+    return true;
+}
+
+void roaring_set_optimize(RoaringSet *set)
+{
+    for (size_t i = 0; i < set->count; i++)
+    {
+        Container *c = &set->containers[i];
+        uint32_t runs = count_runs(c);
+        size_t run_bytes = runs * sizeof(Run);
+        size_t plain_bytes = c->cardinality <= ARRAY_MAX ? c->cardinality * sizeof(uint16_t) : BITMAP_BYTES;
+
+        if (c->type == RUN && run_bytes >= plain_bytes)
+        {
+            run_expand(set, c);
+        }
+        else if (c->type != RUN && run_bytes < plain_bytes)
+        {
+            container_to_runs(set, c, runs);
+        }
+        else if (c->type == BITMAP && c->cardinality <= ARRAY_MAX)
+        {
+            container_set_bits(set, c, c->data, c->cardinality);
+        }
+        else if (c->type == ARRAY && c->capacity > c->length)
+        {
+            c->data = alloc_realloc(&set->allocator, c->data, sizeof(uint16_t) * c->length);
+            c->capacity = c->length;
+        }
+    }
+
+    if (set->capacity > set->count)
+    {
+        set->capacity = set->count;
+        set->containers = alloc_realloc(&set->allocator, set->containers, sizeof(Container) * (set->count > 0 ? set->count : 1));
+    }
+}
+
+static void append_container(RoaringSet *set, const Container *c)
+{
+    Container *copy = insert_container(set, set->count, c->key);
+    *copy = *c;
+    set->size += c->cardinality;
+}
+
+static void append_copy(RoaringSet *set, const Container *c)
+{
+    Container copy = *c;
+    copy.data = alloc_malloc(&set->allocator, container_bytes(c));
+    memcpy(copy.data, c->data, container_bytes(c));
+    append_container(set, &copy);
+}
+
+static void append_union(RoaringSet *set, const Container *a, const Container *b)
+{
+    Container result;
+    memset(&result, 0, sizeof(result));
+    result.key = a->key;
+
+    if (a->type == ARRAY && b->type == ARRAY && a->cardinality + b->cardinality <= ARRAY_MAX)
+    {
+        const uint16_t *x = a->data;
+        const uint16_t *y = b->data;
+        uint16_t *out = alloc_malloc(&set->allocator, sizeof(uint16_t) * (a->length + b->length));
+        uint32_t i = 0, j = 0, n = 0;
+
+        while (i < a->length && j < b->length)
+        {
+            uint16_t u = x[i];
+            uint16_t v = y[j];
+            out[n++] = u < v ? u : v;
+            i += u <= v;
+            j += v <= u;
+        }
+        while (i < a->length)
+        {
+            out[n++] = x[i++];
+        }
+        while (j < b->length)
+        {
+            out[n++] = y[j++];
+        }
+
+        result.type = ARRAY;
+        result.data = out;
+        result.cardinality = result.length = n;
+        result.capacity = a->length + b->length;
+    }
+    else
+    {
+        uint64_t *bits = alloc_calloc(&set->allocator, BITMAP_WORDS, sizeof(uint64_t));
+        container_or_into(a, bits);
+        container_or_into(b, bits);
+        container_set_bits(set, &result, bits, bitmap_count(bits));
+    }
+
+    append_container(set, &result);
+}
+
+static void append_intersection(RoaringSet *set, const Container *a, const Container *b)
+{
+    Container result;
+    memset(&result, 0, sizeof(result));
+    result.key = a->key;
+
+    if (b->type == ARRAY)
+    {
+        const Container *t = a;
+        a = b;
+        b = t;
+    }
+
+    if (a->type == ARRAY)
+    {
+        // an array probes the other side, whatever its kind
+        const uint16_t *x = a->data;
+        uint16_t *out = alloc_malloc(&set->allocator, sizeof(uint16_t) * (a->length > 0 ? a->length : 1));
+        uint32_t n = 0;
+
+        for (uint32_t i = 0; i < a->length; i++)
+        {
+            out[n] = x[i];
+            n += container_contains(b, x[i]);
+        }
+
+        result.type = ARRAY;
+        result.data = out;
+        result.cardinality = result.length = n;
+        result.capacity = a->length > 0 ? a->length : 1;
+    }
+    else
+    {
+        uint64_t *bits = alloc_calloc(&set->allocator, BITMAP_WORDS, sizeof(uint64_t));
+        container_or_into(a, bits);
+        if (b->type == BITMAP)
+        {
+            bitmap_and(bits, b->data);
+        }
+        else
+        {
+            uint64_t *other = alloc_calloc(&set->allocator, BITMAP_WORDS, sizeof(uint64_t));
+            container_or_into(b, other);
+            bitmap_and(bits, other);
+            alloc_free(&set->allocator, other);
+        }
+        container_set_bits(set, &result, bits, bitmap_count(bits));
+    }
+
+    if (result.cardinality == 0)
+    {
+        alloc_free(&set->allocator, result.data);
+        return;
+    }
+    append_container(set, &result);
+}
+
+RoaringSet *roaring_set_union(const RoaringSet *a, const RoaringSet *b)
+{
+    RoaringSet *result = roaring_set_new();
+    size_t i = 0, j = 0;
+
+    while (i < a->count || j < b->count)
+    {
+        if (j == b->count || (i < a->count && a->containers[i].key < b->containers[j].key))
+        {
+            append_copy(result, &a->containers[i++]);
+        }
+        else if (i == a->count || b->containers[j].key < a->containers[i].key)
+        {
+            append_copy(result, &b->containers[j++]);
+        }
+        else
+        {
+            append_union(result, &a->containers[i++], &b->containers[j++]);
+        }
+    }
+
+    return result;
+}
+
+RoaringSet *roaring_set_intersection(const RoaringSet *a, const RoaringSet *b)
+{
+    RoaringSet *result = roaring_set_new();
+    size_t i = 0, j = 0;
+
+    while (i < a->count && j < b->count)
+    {
+        uint16_t x = a->containers[i].key;
+        uint16_t y = b->containers[j].key;
+        if (x == y)
+        {
+            append_intersection(result, &a->containers[i], &b->containers[j]);
+        }
+        i += x <= y;
+        j += y <= x;
+    }
+
+    return result;
+}
+
+bool roaring_set_equal(const RoaringSet *a, const RoaringSet *b)
+{
+    if (a->size != b->size || a->count != b->count)
+    {
+        return false;
+    }
+
+    RoaringSetIterator *x = roaring_set_iterator_new(a);
+    RoaringSetIterator *y = roaring_set_iterator_new(b);
+    uint32_t u, v;
+    bool equal = true;
+
+    while (equal && roaring_set_iterator_next(x, &u))
+    {
+        equal = roaring_set_iterator_next(y, &v) && u == v;
+    }
+
+    roaring_set_iterator_destroy(x);
+    roaring_set_iterator_destroy(y);
+    return equal;
+}
+
+RoaringSetIterator *roaring_set_iterator_new(const RoaringSet *set)
+{
+    RoaringSetIterator *iter = alloc_calloc(&set->allocator, 1, sizeof(RoaringSetIterator));
+    iter->set = set;
+    return iter;
+}
+
+bool roaring_set_iterator_next(RoaringSetIterator *iter, uint32_t *value)
+{
+    const RoaringSet *set = iter->set;
+
+    while (iter->container < set->count)
+    {
+        const Container *c = &set->containers[iter->container];
+        uint32_t high = (uint32_t)c->key << 16;
+
+        if (c->type == ARRAY)
+        {
+            if (iter->pos < c->length)
+            {
+                *value = high | ((const uint16_t *)c->data)[iter->pos++];
+                return true;
+            }
+        }
+        else if (c->type == BITMAP)
+        {
+            const uint64_t *bits = c->data;
+            for (uint32_t pos = iter->pos; pos < BITMAP_WORDS * 64; pos = (pos | 63) + 1)
+            {
+                uint64_t word = bits[pos >> 6] & (~UINT64_C(0) << (pos & 63));
+                if (word)
+                {
+                    uint32_t bit = (pos & ~63u) + ctz64(word);
+                    iter->pos = bit + 1;
+                    *value = high | bit;
+                    return true;
+                }
+            }
+        }
+        else if (iter->pos < c->length)
+        {
+            const Run *run = &((const Run *)c->data)[iter->pos];
+            *value = high | (run->start + iter->run_offset);
+            if (run->start + iter->run_offset == run->last)
+            {
+                iter->pos++;
+                iter->run_offset = 0;
+            }
+            else
+            {
+                iter->run_offset++;
+            }
+            return true;
+        }
+
+        iter->container++;
+        iter->pos = 0;
+        iter->run_offset = 0;
+    }
+
+    return false;
+}
+
+void roaring_set_iterator_destroy(RoaringSetIterator *iter)
+{
+    if (iter)
+    {
+        alloc_free(&iter->set->allocator, iter);
+    }
+}
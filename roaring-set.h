@@ -0,0 +1,41 @@
+#ifndef LIBUTILS_ROARING_SET_H
+#define LIBUTILS_ROARING_SET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A compressed set of 32-bit integers (Roaring bitmap). Values are grouped
+ * by their high 16 bits, and each group is a sorted array while it holds
+ * at most 4096 values, a 65536-bit bitmap beyond that, or a list of runs
+ * once roaring_set_optimize finds that smaller. Dense sets take a few bits
+ * per value where Set takes tens of bytes.
+ */
+
+typedef struct RoaringSet_ RoaringSet;
+typedef struct RoaringSetIterator_ RoaringSetIterator;
+
+RoaringSet *roaring_set_new(void);
+void roaring_set_destroy(RoaringSet *set);
+
+bool roaring_set_add(RoaringSet *set, uint32_t value);
+bool roaring_set_contains(const RoaringSet *set, uint32_t value);
+bool roaring_set_remove(RoaringSet *set, uint32_t value);
+void roaring_set_clear(RoaringSet *set);
+size_t roaring_set_size(const RoaringSet *set);
+// Bytes held by the set
+size_t roaring_set_memory(const RoaringSet *set);
+// Switches groups to runs where that is smaller and trims spare capacity
+void roaring_set_optimize(RoaringSet *set);
+
+RoaringSet *roaring_set_union(const RoaringSet *a, const RoaringSet *b);
+RoaringSet *roaring_set_intersection(const RoaringSet *a, const RoaringSet *b);
+bool roaring_set_equal(const RoaringSet *a, const RoaringSet *b);
+
+// Yields the values in increasing order
+RoaringSetIterator *roaring_set_iterator_new(const RoaringSet *set);
+bool roaring_set_iterator_next(RoaringSetIterator *iter, uint32_t *value);
+void roaring_set_iterator_destroy(RoaringSetIterator *iter);
+
+#endif
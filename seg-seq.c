@@ -0,0 +1,292 @@
+#include "seg-seq.h"
+
+#include "alloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// target chunk size, rounded down to a power of two number of elements
+#define CHUNK_BYTES 4096
+#define INITIAL_DIRECTORY 8
+
+struct SegSeq_
+{
+    // chunks[first .. first + used) are in use
+    char **chunks;
+    size_t directory_capacity;
+    size_t first;
+    size_t used;
+    // element 0 sits at slot head of chunks[first]
+    size_t head;
+    size_t length;
+
+    size_t elem_size;
+    unsigned int shift;
+    bool boxed;
+    char *spare;
+    void (*item_destroy)(void *);
+    Allocator allocator;
+};
+
+static SegSeq *seg_seq_alloc(size_t elem_size, bool boxed, void (*item_destroy)(void *))
+{
+    Allocator allocator = alloc_get_allocator();
+    SegSeq *seq = alloc_malloc(&allocator, sizeof(SegSeq));
+
+    seq->allocator = allocator;
+    seq->directory_capacity = INITIAL_DIRECTORY;
+    seq->chunks = alloc_malloc(&allocator, sizeof(char *) * seq->directory_capacity);
+    seq->first = seq->directory_capacity / 2;
+    seq->used = 0;
+    seq->head = 0;
+    seq->length = 0;
+
+    seq->elem_size = elem_size;
+    seq->shift = 0;
+    while (((size_t)2 << seq->shift) * elem_size <= CHUNK_BYTES)
+    {
+        seq->shift++;
+    }
+    seq->boxed = boxed;
+    seq->spare = NULL;
+    seq->item_destroy = item_destroy;
+
+    return seq;
+}
+
+SegSeq *seg_seq_new(void (*item_destroy)(void *))
+{
+    return seg_seq_alloc(sizeof(void *), true, item_destroy);
+}
+
+SegSeq *seg_seq_new_sized(size_t elem_size, void (*item_destroy)(void *))
+{
+    assert(elem_size > 0);
+    return seg_seq_alloc(elem_size, false, item_destroy);
+}
+
+static size_t chunk_items(const SegSeq *seq)
+{
+    return (size_t)1 << seq->shift;
+}
+
+static char *chunk_new(SegSeq *seq)
+{
+    char *chunk = seq->spare;
+    if (chunk)
+    {
+        seq->spare = NULL;
+        return chunk;
+    }
+    return alloc_malloc(&seq->allocator, seq->elem_size << seq->shift);
+}
+
+static void chunk_release(SegSeq *seq, char *chunk)
+{
+    if (!seq->spare)
+    {
+        seq->spare = chunk;
+    }
+    else
+    {
+        alloc_free(&seq->allocator, chunk);
+    }
+}
+
+inline void *seg_seq_at_ptr(const SegSeq *seq, size_t index)
+{
+    assert(index < seq->length);
+
+    size_t pos = seq->head + index;
+    return seq->chunks[seq->first + (pos >> seq->shift)] + (pos & (chunk_items(seq) - 1)) * seq->elem_size;
+}
+
+inline void *seg_seq_at(const SegSeq *seq, size_t index)
+{
+    void *slot = seg_seq_at_ptr(seq, index);
+    return seq->boxed ? *(void **)slot : slot;
+}
+
+inline size_t seg_seq_length(const SegSeq *seq)
+{
+    return seq->length;
+}
+
+/*
+ * Recenters the chunk pointers in the directory, doubling it first if it is
+ * more than half full. Only pointers move, one per chunk, so this is rare
+ * and cheap, but amortized rather than constant time.
+ */
+static void make_room(SegSeq *seq)
+{
+    size_t capacity = seq->directory_capacity;
+    char **chunks = seq->chunks;
+
+    if (seq->used * 2 > capacity)
+    {
+        capacity *= 2;
+        chunks = alloc_malloc(&seq->allocator, sizeof(char *) * capacity);
+    }
+
+    size_t first = (capacity - seq->used) / 2;
+    if (seq->used > 0)
+    {
+        memmove(chunks + first, seq->chunks + seq->first, sizeof(char *) * seq->used);
+    }
+    if (chunks != seq->chunks)
+    {
+        alloc_free(&seq->allocator, seq->chunks);
+    }
+
+    seq->chunks = chunks;
+    seq->directory_capacity = capacity;
+    seq->first = first;
+}
+
+static void store(const SegSeq *seq, void *slot, void *item)
+{
+    if (seq->boxed)
+    {
+        *(void **)slot = item;
+    }
+    else
+    {
+        memcpy(slot, item, seq->elem_size);
+    }
+}
+
+void seg_seq_push_back(SegSeq *seq, void *item)
+{
+    size_t pos = seq->head + seq->length;
+
+    if ((pos >> seq->shift) == seq->used)
+    {
+        if (seq->first + seq->used == seq->directory_capacity)
+        {
+            make_room(seq);
+        }
+        seq->chunks[seq->first + seq->used] = chunk_new(seq);
+        seq->used++;
+    }
+
+    seq->length++;
+    store(seq, seg_seq_at_ptr(seq, seq->length - 1), item);
+}
+
+void seg_seq_push_front(SegSeq *seq, void *item)
+{
+    if (seq->head == 0)
+    {
+        if (seq->first == 0)
+        {
+            make_room(seq);
+        }
+        seq->first--;
+        seq->chunks[seq->first] = chunk_new(seq);
+        seq->used++;
+        seq->head = chunk_items(seq);
+    }
+
+    seq->head--;
+    seq->length++;
+    store(seq, seg_seq_at_ptr(seq, 0), item);
+}
+
+// Releases chunks no longer covered by [head, head + length)
+static void trim(SegSeq *seq)
+{
+    if (seq->length == 0)
+    {
+        for (size_t i = 0; i < seq->used; i++)
+        {
+            chunk_release(seq, seq->chunks[seq->first + i]);
+        }
+        seq->used = 0;
+        seq->head = 0;
+        seq->first = seq->directory_capacity / 2;
+        return;
+    }
+
+    if (seq->head >= chunk_items(seq))
+    {
+        chunk_release(seq, seq->chunks[seq->first]);
+        seq->first++;
+        seq->used--;
+        seq->head -= chunk_items(seq);
+    }
+
+    size_t needed = ((seq->head + seq->length - 1) >> seq->shift) + 1;
+    while (seq->used > needed)
+    {
+        seq->used--;
+        chunk_release(seq, seq->chunks[seq->first + seq->used]);
+    }
+}
+
+static void take(SegSeq *seq, size_t index, void *out)
+{
+    if (out)
+    {
+        memcpy(out, seg_seq_at_ptr(seq, index), seq->elem_size);
+    }
+    else if (seq->item_destroy)
+    {
+        seq->item_destroy(seg_seq_at(seq, index));
+    }
+}
+
+bool seg_seq_pop_back(SegSeq *seq, void *out)
+{
+    if (seq->length == 0)
+    {
+        return false;
+    }
+
+    take(seq, seq->length - 1, out);
+    seq->length--;
+    trim(seq);
+
+    return true;
+}
+
+bool seg_seq_pop_front(SegSeq *seq, void *out)
+{
+    if (seq->length == 0)
+    {
+        return false;
+    }
+
+    take(seq, 0, out);
+    seq->head++;
+    seq->length--;
+    trim(seq);
+
+    return true;
+}
+
+void seg_seq_clear(SegSeq *seq)
+{
+    if (seq->item_destroy)
+    {
+        for (size_t i = 0; i < seq->length; i++)
+        {
+            seq->item_destroy(seg_seq_at(seq, i));
+        }
+    }
+
+    seq->length = 0;
+    trim(seq);
+}
+
+void seg_seq_destroy(SegSeq *seq)
+{
+    if (seq)
+    {
+        seg_seq_clear(seq);
+        Allocator allocator = seq->allocator;
+        alloc_free(&allocator, seq->spare);
+        alloc_free(&allocator, seq->chunks);
+        alloc_free(&allocator, seq);
+    }
+}
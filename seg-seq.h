@@ -0,0 +1,38 @@
+#ifndef LIBUTILS_SEG_SEQ_H
+#define LIBUTILS_SEG_SEQ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * A Seq stored as a directory of fixed-size chunks, so it grows and shrinks
+ * at both ends without moving elements: addresses from seg_seq_at() stay
+ * valid until that element is popped. Emptied chunks are freed right away,
+ * except for one kept to absorb push/pop traffic across a chunk boundary.
+ * Item conventions match seq_new() and seq_new_sized().
+ */
+
+typedef struct SegSeq_ SegSeq;
+
+SegSeq *seg_seq_new(void (*item_destroy)(void *));
+SegSeq *seg_seq_new_sized(size_t elem_size, void (*item_destroy)(void *));
+void seg_seq_destroy(SegSeq *seq);
+
+size_t seg_seq_length(const SegSeq *seq);
+void *seg_seq_at(const SegSeq *seq, size_t index);
+void *seg_seq_at_ptr(const SegSeq *seq, size_t index);
+
+void seg_seq_push_back(SegSeq *seq, void *item);
+void seg_seq_push_front(SegSeq *seq, void *item);
+
+/**
+ * Removes the last or first item, false if empty. The slot contents (the item
+ * pointer, or the element of a sized SegSeq) are copied to out, or the item
+ * is destroyed if out is NULL.
+ */
+bool seg_seq_pop_back(SegSeq *seq, void *out);
+bool seg_seq_pop_front(SegSeq *seq, void *out);
+
+void seg_seq_clear(SegSeq *seq);
+
+#endif
@@ -0,0 +1,568 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "seq-sort.h"
+
+#include "alloc.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// below this many items per thread seq_sort_parallel just calls seq_sort
+#define PARALLEL_MIN_CHUNK 4096
+// interpolation steps before seq_interpolation_search falls back to bisection
+#define INTERPOLATION_PROBES 32
+
+typedef struct
+{
+    size_t size;
+    bool boxed;
+    int (*compare)(const void *, const void *);
+    int (*compare_r)(const void *, const void *, void *);
+    void *context;
+} SortSpec;
+
+static const size_t INSERTION_THRESHOLD = 16;
+
+static SortSpec sort_spec(const Seq *seq, int (*compare)(const void *, const void *))
+{
+    SortSpec spec = { seq_elem_size(seq), !seq_is_sized(seq), compare, NULL, NULL };
+    return spec;
+}
+
+static inline int compare_items(const SortSpec *spec, const void *a, const void *b)
+{
+    return spec->compare ? spec->compare(a, b) : spec->compare_r(a, b, spec->context);
+}
+
+static inline int compare_slots(const SortSpec *spec, const char *a, const char *b)
+{
+    if (spec->boxed)
+    {
+        return compare_items(spec, *(void *const *)a, *(void *const *)b);
+    }
+    return compare_items(spec, a, b);
+}
+
+static inline void swap_slots(char *a, char *b, size_t size)
+{
+    char tmp[64];
+
+    while (size > 0)
+    {
+        size_t n = size < sizeof(tmp) ? size : sizeof(tmp);
+        memcpy(tmp, a, n);
+        memcpy(a, b, n);
+        memcpy(b, tmp, n);
+        a += n;
+        b += n;
+        size -= n;
+    }
+}
+
+static void insertion_sort(const SortSpec *spec, char *base, size_t n)
+{
+    size_t size = spec->size;
+
+    for (size_t i = 1; i < n; i++)
+    {
+        for (char *p = base + i * size; p > base && compare_slots(spec, p - size, p) > 0; p -= size)
+        {
+            swap_slots(p - size, p, size);
+        }
+    }
+}
+
+static void sift_down(const SortSpec *spec, char *base, size_t root, size_t n)
+{
+    size_t size = spec->size;
+
+    for (;;)
+    {
+        size_t child = 2 * root + 1;
+        if (child >= n)
+        {
+            return;
+        }
+        if (child + 1 < n && compare_slots(spec, base + child * size, base + (child + 1) * size) < 0)
+        {
+            child++;
+        }
+        if (compare_slots(spec, base + root * size, base + child * size) >= 0)
+        {
+            return;
+        }
+        swap_slots(base + root * size, base + child * size, size);
+        root = child;
+    }
+}
+
+static void heap_sort(const SortSpec *spec, char *base, size_t n)
+{
+    for (size_t i = n / 2; i-- > 0;)
+    {
+        sift_down(spec, base, i, n);
+    }
+    for (size_t end = n - 1; end > 0; end--)
+    {
+        swap_slots(base, base + end * spec->size, spec->size);
+        sift_down(spec, base, 0, end);
+    }
+}
+
+static void median_to_front(const SortSpec *spec, char *base, size_t n)
+{
+    size_t size = spec->size;
+    char *lo = base;
+    char *mid = base + (n / 2) * size;
+    char *hi = base + (n - 1) * size;
+
+    if (compare_slots(spec, mid, lo) < 0)
+    {
+        swap_slots(mid, lo, size);
+    }
+    if (compare_slots(spec, hi, mid) < 0)
+    {
+        swap_slots(hi, mid, size);
+        if (compare_slots(spec, mid, lo) < 0)
+        {
+            swap_slots(mid, lo, size);
+        }
+    }
+    swap_slots(base, mid, size);
+}
+
+static void introsort(const SortSpec *spec, char *base, size_t n, unsigned int depth)
+{
+    size_t size = spec->size;
+
+    while (n > INSERTION_THRESHOLD)
+    {
+        if (depth == 0)
+        {
+            heap_sort(spec, base, n);
+            return;
+        }
+        depth--;
+
+        // Hoare partition around the median of three, parked at base
+        median_to_front(spec, base, n);
+
+        char *end = base + n * size;
+        char *i = base;
+        char *j = end;
+        for (;;)
+        {
+            do
+            {
+                i += size;
+            } while (i < end && compare_slots(spec, i, base) < 0);
+            do
+            {
+                j -= size;
+            } while (compare_slots(spec, base, j) < 0);
+
+            if (i >= j)
+            {
+                break;
+            }
+            swap_slots(i, j, size);
+        }
+        swap_slots(base, j, size);
+
+        // recurse into the smaller side so the stack stays logarithmic
+        size_t left = (size_t)(j - base) / size;
+        size_t right = n - left - 1;
+        if (left < right)
+        {
+            introsort(spec, base, left, depth);
+            base = j + size;
+            n = right;
+        }
+        else
+        {
+            introsort(spec, j + size, right, depth);
+            n = left;
+        }
+    }
+
+    insertion_sort(spec, base, n);
+}
+
+static unsigned int depth_limit(size_t n)
+{
+    unsigned int depth = 0;
+    while (n > 1)
+    {
+        n >>= 1;
+        depth += 2;
+    }
+    return depth;
+}
+
+void seq_sort(Seq *seq, int (*compare)(const void *, const void *))
+{
+    size_t n = seq_length(seq);
+    if (n < 2)
+    {
+        return;
+    }
+
+    SortSpec spec = sort_spec(seq, compare);
+    introsort(&spec, seq_data(seq), n, depth_limit(n));
+}
+
+void seq_sort_r(Seq *seq, int (*compare)(const void *, const void *, void *), void *context)
+{
+    size_t n = seq_length(seq);
+    if (n < 2)
+    {
+        return;
+    }
+
+    SortSpec spec = { seq_elem_size(seq), !seq_is_sized(seq), NULL, compare, context };
+    introsort(&spec, seq_data(seq), n, depth_limit(n));
+}
+
+typedef struct
+{
+    const SortSpec *spec;
+    char *src;
+    char *dst;
+    size_t start;
+    size_t middle;
+    size_t end;
+} SortTask;
+
+static void *sort_chunk(void *arg)
+{
+    SortTask *task = arg;
+    size_t n = task->end - task->start;
+
+    introsort(task->spec, task->src + task->start * task->spec->size, n, depth_limit(n));
+    return NULL;
+}
+
+static void *merge_chunks(void *arg)
+{
+    SortTask *task = arg;
+    size_t size = task->spec->size;
+    const char *a = task->src + task->start * size;
+    const char *a_end = task->src + task->middle * size;
+    const char *b = a_end;
+    const char *b_end = task->src + task->end * size;
+    char *out = task->dst + task->start * size;
+
+    while (a < a_end && b < b_end)
+    {
+        if (compare_slots(task->spec, b, a) < 0)
+        {
+            memcpy(out, b, size);
+            b += size;
+        }
+        else
+        {
+            memcpy(out, a, size);
+            a += size;
+        }
+        out += size;
+    }
+    memcpy(out, a, (size_t)(a_end - a));
+    out += a_end - a;
+    memcpy(out, b, (size_t)(b_end - b));
+    return NULL;
+}
+
+static void run_tasks(SortTask *tasks, size_t count, void *(*fn)(void *))
+{
+    pthread_t *threads = xmalloc(sizeof(pthread_t) * count);
+    size_t started = 0;
+
+    // the calling thread takes the first task itself
+    for (size_t i = 1; i < count; i++)
+    {
+        if (pthread_create(&threads[i], NULL, fn, &tasks[i]) != 0)
+        {
+            break;
+        }
+        started = i;
+    }
+    for (size_t i = started + 1; i < count; i++)
+    {
+        fn(&tasks[i]);
+    }
+    fn(&tasks[0]);
+    for (size_t i = 1; i <= started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    xfree(threads);
+}
+
+void seq_sort_parallel(Seq *seq, int (*compare)(const void *, const void *), unsigned int threads)
+{
+    size_t n = seq_length(seq);
+
+    if (threads == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (unsigned int)cpus : 1;
+    }
+    if (threads > n / PARALLEL_MIN_CHUNK)
+    {
+        threads = n / PARALLEL_MIN_CHUNK;
+    }
+    if (threads <= 1)
+    {
+        seq_sort(seq, compare);
+        return;
+    }
+
+    SortSpec spec = sort_spec(seq, compare);
+    char *data = seq_data(seq);
+    char *scratch = xmalloc(spec.size * n);
+    size_t *bounds = xmalloc(sizeof(size_t) * (threads + 1));
+    SortTask *tasks = xmalloc(sizeof(SortTask) * threads);
+
+    size_t runs = threads;
+    for (size_t i = 0; i <= runs; i++)
+    {
+        bounds[i] = n * i / runs;
+    }
+    for (size_t i = 0; i < runs; i++)
+    {
+        tasks[i] = (SortTask){ &spec, data, NULL, bounds[i], bounds[i], bounds[i + 1] };
+    }
+    run_tasks(tasks, runs, sort_chunk);
+
+    char *src = data;
+    char *dst = scratch;
+    while (runs > 1)
+    {
+        size_t merged = 0;
+        for (size_t i = 0; i < runs; i += 2)
+        {
+            if (i + 1 < runs)
+            {
+                tasks[merged] = (SortTask){ &spec, src, dst, bounds[i], bounds[i + 1], bounds[i + 2] };
+            }
+            else
+            {
+                // odd run out is carried over unchanged
+                tasks[merged] = (SortTask){ &spec, src, dst, bounds[i], bounds[i + 1], bounds[i + 1] };
+            }
+            bounds[merged] = bounds[i];
+            merged++;
+        }
+        bounds[merged] = n;
+        run_tasks(tasks, merged, merge_chunks);
+
+        runs = merged;
+        char *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != data)
+    {
+        memcpy(data, src, spec.size * n);
+    }
+
+    xfree(tasks);
+    xfree(bounds);
+    xfree(scratch);
+}
+
+typedef struct
+{
+    uint64_t key;
+    size_t index;
+} KeyedIndex;
+
+void seq_radix_sort_by_key(Seq *seq, uint64_t (*key)(const void *item))
+{
+    size_t n = seq_length(seq);
+    if (n < 2)
+    {
+        return;
+    }
+
+    // Sort small (key, index) pairs and move the elements once at the end
+    KeyedIndex *pairs = xmalloc(sizeof(KeyedIndex) * n);
+    KeyedIndex *scratch = xmalloc(sizeof(KeyedIndex) * n);
+    size_t counts[8][256] = { { 0 } };
+
+    for (size_t i = 0; i < n; i++)
+    {
+        uint64_t k = key(seq_at(seq, i));
+        pairs[i] = (KeyedIndex){ k, i };
+        for (int byte = 0; byte < 8; byte++)
+        {
+            counts[byte][(k >> (byte * 8)) & 0xff]++;
+        }
+    }
+
+    for (int byte = 0; byte < 8; byte++)
+    {
+        unsigned int shift = byte * 8;
+        if (counts[byte][(pairs[0].key >> shift) & 0xff] == n)
+        {
+            // every key has the same digit here
+            continue;
+        }
+
+        size_t offsets[256];
+        size_t sum = 0;
+        for (int digit = 0; digit < 256; digit++)
+        {
+            offsets[digit] = sum;
+            sum += counts[byte][digit];
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            scratch[offsets[(pairs[i].key >> shift) & 0xff]++] = pairs[i];
+        }
+
+        KeyedIndex *tmp = pairs;
+        pairs = scratch;
+        scratch = tmp;
+    }
+
+    size_t size = seq_elem_size(seq);
+    char *data = seq_data(seq);
+    char *sorted = xmalloc(size * n);
+    for (size_t i = 0; i < n; i++)
+    {
+        memcpy(sorted + i * size, data + pairs[i].index * size, size);
+    }
+    memcpy(data, sorted, size * n);
+
+    xfree(sorted);
+    xfree(scratch);
+    xfree(pairs);
+}
+
+static inline const void *item_at(const Seq *seq, const char *slot)
+{
+    return seq_is_sized(seq) ? slot : *(void *const *)slot;
+}
+
+size_t seq_lower_bound(const Seq *seq, const void *key, int (*compare)(const void *, const void *))
+{
+    size_t size = seq_elem_size(seq);
+    const char *data = seq_data(seq);
+    const char *base = data;
+    size_t n = seq_length(seq);
+
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    // Halve the range with a conditional move instead of a branch
+    while (n > 1)
+    {
+        size_t half = n / 2;
+        base = compare(item_at(seq, base + half * size), key) < 0 ? base + half * size : base;
+        n -= half;
+    }
+
+    return (size_t)(base - data) / size + (compare(item_at(seq, base), key) < 0);
+}
+
+bool seq_binary_search(const Seq *seq, const void *key, int (*compare)(const void *, const void *),
+                       size_t *index)
+{
+    size_t i = seq_lower_bound(seq, key, compare);
+
+    if (index)
+    {
+        *index = i;
+    }
+    return i < seq_length(seq) && compare(seq_at(seq, i), key) == 0;
+}
+
+size_t seq_interpolation_search(const Seq *seq, uint64_t key, uint64_t (*key_of)(const void *item))
+{
+    size_t lo = 0;
+    size_t hi = seq_length(seq);
+
+    // Everything before lo is below key, everything from hi on is not
+    for (int probes = 0; hi - lo > 16 && probes < INTERPOLATION_PROBES; probes++)
+    {
+        uint64_t lo_key = key_of(seq_at(seq, lo));
+        uint64_t hi_key = key_of(seq_at(seq, hi - 1));
+
+        if (key <= lo_key)
+        {
+            return lo;
+        }
+        if (key > hi_key)
+        {
+            return hi;
+        }
+
+        double fraction = (double)(key - lo_key) / (double)(hi_key - lo_key);
+        size_t pos = lo + (size_t)(fraction * (double)(hi - 1 - lo));
+        if (pos >= hi)
+        {
+            pos = hi - 1;
+        }
+
+        if (key_of(seq_at(seq, pos)) < key)
+        {
+            lo = pos + 1;
+        }
+        else
+        {
+            hi = pos;
+        }
+    }
+
+    // Skewed keys or a short range left: finish by bisection
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (key_of(seq_at(seq, mid)) < key)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+size_t seq_dedup_sorted(Seq *seq, int (*compare)(const void *, const void *))
+{
+    size_t n = seq_length(seq);
+    if (n < 2)
+    {
+        return 0;
+    }
+
+    // Swap the survivors forward so the duplicates end up in the tail,
+    // where seq_remove_range destroys them
+    size_t write = 1;
+    for (size_t read = 1; read < n; read++)
+    {
+        if (compare(seq_at(seq, write - 1), seq_at(seq, read)) != 0)
+        {
+            if (read != write)
+            {
+                swap_slots(seq_at_ptr(seq, write), seq_at_ptr(seq, read), seq_elem_size(seq));
+            }
+            write++;
+        }
+    }
+
+    seq_remove_range(seq, write, n - write);
+    return n - write;
+}
@@ -0,0 +1,46 @@
+#ifndef LIBUTILS_SEQ_SORT_H
+#define LIBUTILS_SEQ_SORT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "seq.h"
+
+/*
+ * Sorting and searching of Seqs. Comparators and key extractors receive
+ * what seq_at() returns: the item for pointer Seqs, a pointer to the element
+ * for sized Seqs. Search keys are passed in the same form.
+ */
+
+// Introsort, not stable
+void seq_sort(Seq *seq, int (*compare)(const void *a, const void *b));
+void seq_sort_r(Seq *seq, int (*compare)(const void *a, const void *b, void *context), void *context);
+
+/**
+ * Sorts chunks on separate threads and merges them pairwise, also in
+ * parallel. threads == 0 uses one thread per online CPU. Not stable, and
+ * compare must be safe to call concurrently.
+ */
+void seq_sort_parallel(Seq *seq, int (*compare)(const void *a, const void *b), unsigned int threads);
+
+/**
+ * Stable LSD radix sort on an unsigned 64-bit key. Signed keys sort correctly
+ * once their sign bit is flipped by the extractor.
+ */
+void seq_radix_sort_by_key(Seq *seq, uint64_t (*key)(const void *item));
+
+// Index of the first item not less than key, seq_length() if there is none
+size_t seq_lower_bound(const Seq *seq, const void *key, int (*compare)(const void *a, const void *b));
+bool seq_binary_search(const Seq *seq, const void *key, int (*compare)(const void *a, const void *b),
+                       size_t *index);
+
+/**
+ * seq_lower_bound() for Seqs sorted on a numeric key. Probes where the key
+ * should be assuming evenly spread keys, then bisects if that does not pay off.
+ */
+size_t seq_interpolation_search(const Seq *seq, uint64_t key, uint64_t (*key_of)(const void *item));
+
+// Destroys all but the first of each run of equal items, returns how many
+size_t seq_dedup_sorted(Seq *seq, int (*compare)(const void *a, const void *b));
+
+#endif
@@ -3,36 +3,98 @@
 #include "alloc.h"
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 #include <assert.h>
 
+typedef union
+{
+    void *p;
+    long long ll;
+    long double ld;
+} MaxAlign;
+
 struct Seq_
 {
-    void **data;
-    unsigned int length;
-    unsigned int capacity;
+    char *data;
+    size_t length;
+    size_t capacity;
+    size_t elem_size;
+    // Pointer Seqs hand out the stored pointer, sized Seqs a pointer to the element
+    bool boxed;
     void (*item_destroy)(void *);
+    Allocator allocator;
+    // Small Seqs keep their items here, in the same allocation as the header
+    MaxAlign inline_data[];
 };
 
-static const unsigned int EXPAND_FACTOR = 2;
+static const size_t EXPAND_FACTOR = 2;
+static const size_t INLINE_BYTES = 8 * sizeof(void *);
 
-Seq *seq_new(unsigned int initial_capacity, void (*item_destroy)(void *))
+static Seq *seq_alloc(size_t elem_size, size_t initial_capacity, void (*item_destroy)(void *))
 {
-    Seq *seq = xmalloc(sizeof(Seq));
+    Allocator allocator = alloc_get_allocator();
+    Seq *seq;
 
-    if (initial_capacity == 0)
+    if (elem_size <= INLINE_BYTES && initial_capacity <= INLINE_BYTES / elem_size)
     {
-        initial_capacity = 1;
+        seq = alloc_malloc(&allocator, sizeof(Seq) + INLINE_BYTES);
+        seq->capacity = INLINE_BYTES / elem_size;
+        seq->data = (char *)seq->inline_data;
+    }
+    else
+    {
+        if (initial_capacity > SIZE_MAX / elem_size)
+        {
+            abort();
+        }
+        seq = alloc_malloc(&allocator, sizeof(Seq));
+        seq->capacity = initial_capacity ? initial_capacity : 1;
+        seq->data = alloc_malloc(&allocator, elem_size * seq->capacity);
     }
 
-    seq->capacity = initial_capacity;
     seq->length = 0;
-    seq->data = xmalloc(sizeof(void *) * initial_capacity);
+    seq->elem_size = elem_size;
     seq->item_destroy = item_destroy;
+    seq->allocator = allocator;
 
     return seq;
 }
 
-static void destroy_range(Seq *seq, unsigned int start, unsigned int end)
+Seq *seq_new(size_t initial_capacity, void (*item_destroy)(void *))
+{
+    Seq *seq = seq_alloc(sizeof(void *), initial_capacity, item_destroy);
+    seq->boxed = true;
+    return seq;
+}
+
+Seq *seq_new_sized(size_t elem_size, size_t initial_capacity, void (*item_destroy)(void *))
+{
+    assert(elem_size > 0);
+
+    Seq *seq = seq_alloc(elem_size, initial_capacity, item_destroy);
+    seq->boxed = false;
+    return seq;
+}
+
+static bool is_inline(const Seq *seq)
+{
+    return seq->data == (char *)seq->inline_data;
+}
+
+inline void *seq_at_ptr(const Seq *seq, size_t index)
+{
+    return seq->data + index * seq->elem_size;
+}
+
+inline void *seq_at(const Seq *seq, size_t index)
+{
+    void *slot = seq_at_ptr(seq, index);
+    return seq->boxed ? *(void **)slot : slot;
+}
+
+static void destroy_range(Seq *seq, size_t start, size_t end)
 {
     assert(start < seq->length);
     assert(end < seq->length);
@@ -40,9 +102,9 @@ static void destroy_range(Seq *seq, unsigned int start, unsigned int end)
 
     if (seq->item_destroy)
     {
-        for (unsigned int i = start; i <= end; i++)
+        for (size_t i = start; i <= end; i++)
         {
-            seq->item_destroy(seq->data[i]);
+            seq->item_destroy(seq_at(seq, i));
         }
     }
 }
@@ -56,36 +118,171 @@ void seq_destroy(Seq *seq)
             destroy_range(seq, 0, seq->length - 1);
         }
 
-        free(seq->data);
-        free(seq);
+        Allocator allocator = seq->allocator;
+        if (!is_inline(seq))
+        {
+            alloc_free(&allocator, seq->data);
+        }
+        alloc_free(&allocator, seq);
+    }
+}
+
+static size_t max_capacity(const Seq *seq)
+{
+    return SIZE_MAX / seq->elem_size;
+}
+
+// Sizes that do not fit in size_t abort, also with NDEBUG, rather than wrap
+static void set_capacity(Seq *seq, size_t capacity)
+{
+    if (capacity > max_capacity(seq))
+    {
+        abort();
+    }
+
+    if (is_inline(seq))
+    {
+        seq->data = alloc_malloc(&seq->allocator, seq->elem_size * capacity);
+        memcpy(seq->data, seq->inline_data, seq->elem_size * seq->length);
     }
+    else
+    {
+        seq->data = alloc_realloc(&seq->allocator, seq->data, seq->elem_size * capacity);
+    }
+    seq->capacity = capacity;
 }
 
-static void maybe_expand(Seq *seq)
+static void maybe_expand(Seq *seq, size_t count)
 {
     assert(seq->length <= seq->capacity);
 
-    if (seq->length == seq->capacity)
+    if (seq->capacity - seq->length < count)
     {
-        seq->capacity *= EXPAND_FACTOR;
-        seq->data = xrealloc(seq->data, sizeof(void *) * seq->capacity);
+        size_t max = max_capacity(seq);
+        if (count > max - seq->length)
+        {
+            abort();
+        }
+
+        // Saturate rather than wrap around near the top of the address space
+        size_t capacity = seq->capacity;
+        while (capacity - seq->length < count)
+        {
+            capacity = capacity > max / EXPAND_FACTOR ? max : capacity * EXPAND_FACTOR;
+        }
+        set_capacity(seq, capacity);
     }
 }
 
-inline void *seq_at(const Seq *seq, unsigned int index)
+inline size_t seq_length(const Seq *seq)
 {
-    return seq->data[index];
+    return seq->length;
 }
 
-inline unsigned int seq_length(const Seq *seq)
+inline size_t seq_elem_size(const Seq *seq)
 {
-    return seq->length;
+    return seq->elem_size;
+}
+
+inline bool seq_is_sized(const Seq *seq)
+{
+    return !seq->boxed;
+}
+
+inline void *seq_data(const Seq *seq)
+{
+    return seq->data;
 }
 
 void seq_append(Seq *seq, void *item)
 {
-    maybe_expand(seq);
+    maybe_expand(seq, 1);
 
-    seq->data[seq->length] = item;
+    if (seq->boxed)
+    {
+        ((void **)seq->data)[seq->length] = item;
+    }
+    else
+    {
+        memcpy(seq_at_ptr(seq, seq->length), item, seq->elem_size);
+    }
     (seq->length)++;
 }
+
+void seq_append_n(Seq *seq, const void *items, size_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    maybe_expand(seq, count);
+
+    memcpy(seq_at_ptr(seq, seq->length), items, seq->elem_size * count);
+    seq->length += count;
+}
+
+void seq_reserve(Seq *seq, size_t capacity)
+{
+    if (capacity > seq->capacity)
+    {
+        set_capacity(seq, capacity);
+    }
+}
+
+void seq_insert_range(Seq *seq, size_t index, const void *items, size_t count)
+{
+    assert(index <= seq->length);
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    maybe_expand(seq, count);
+
+    char *at = seq_at_ptr(seq, index);
+    memmove(at + seq->elem_size * count, at, seq->elem_size * (seq->length - index));
+    memcpy(at, items, seq->elem_size * count);
+    seq->length += count;
+}
+
+void seq_remove_range(Seq *seq, size_t start, size_t count)
+{
+    assert(start <= seq->length && count <= seq->length - start);
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    destroy_range(seq, start, start + count - 1);
+
+    char *at = seq_at_ptr(seq, start);
+    memmove(at, at + seq->elem_size * count, seq->elem_size * (seq->length - start - count));
+    seq->length -= count;
+}
+
+void seq_clear(Seq *seq)
+{
+    if (seq->length > 0)
+    {
+        destroy_range(seq, 0, seq->length - 1);
+    }
+    seq->length = 0;
+}
+
+void seq_shrink_to_fit(Seq *seq)
+{
+    if (is_inline(seq) || seq->capacity == seq->length)
+    {
+        return;
+    }
+
+    set_capacity(seq, seq->length > 0 ? seq->length : 1);
+}
+
+inline size_t seq_capacity(const Seq *seq)
+{
+    return seq->capacity;
+}
@@ -1,14 +1,40 @@
 #ifndef LIBUTILS_SEQ_H
 #define LIBUTILS_SEQ_H
 
+#include <stddef.h>
+#include <stdbool.h>
+
 typedef struct Seq_ Seq;
 
-Seq *seq_new(unsigned int initial_capacity, void (*item_destroy)(void*));
+Seq *seq_new(size_t initial_capacity, void (*item_destroy)(void*));
+/**
+ * Seq storing elem_size byte elements contiguously. seq_at() and item_destroy
+ * get a pointer to the element, and seq_append() copies the element pointed to.
+ */
+Seq *seq_new_sized(size_t elem_size, size_t initial_capacity, void (*item_destroy)(void*));
 void seq_destroy(Seq *seq);
 
-unsigned int seq_length(const Seq *seq);
-void *seq_at(const Seq *seq, unsigned int index);
+size_t seq_length(const Seq *seq);
+size_t seq_capacity(const Seq *seq);
+size_t seq_elem_size(const Seq *seq);
+bool seq_is_sized(const Seq *seq);
+void *seq_at(const Seq *seq, size_t index);
+// Address of the slot at index, also for pointer Seqs
+void *seq_at_ptr(const Seq *seq, size_t index);
+// Slots are laid out back to back, valid until the Seq grows
+void *seq_data(const Seq *seq);
 
 void seq_append(Seq *seq, void *item);
+// Appends count slots copied from items, i.e. elements or item pointers
+void seq_append_n(Seq *seq, const void *items, size_t count);
+void seq_insert_range(Seq *seq, size_t index, const void *items, size_t count);
+// Destroys the removed items and closes the gap
+void seq_remove_range(Seq *seq, size_t start, size_t count);
+
+// Growing past SIZE_MAX bytes aborts, here and in the appends and inserts
+void seq_reserve(Seq *seq, size_t capacity);
+// Destroys all items but keeps the storage for reuse
+void seq_clear(Seq *seq);
+void seq_shrink_to_fit(Seq *seq);
 
 #endif
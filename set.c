@@ -1,53 +1,204 @@
 #include "set.h"
 
+#include "alloc.h"
+#include "bloom.h"
 #include "rb-tree.h"
 
 #include <assert.h>
 
+#define CONTAINS_MANY_BATCH 64
+
+#define FILTER_FALSE_POSITIVE_RATE 0.01
+#define FILTER_MIN_KEYS 64
+
+struct Set_
+{
+    RBTree *tree;
+
+    // only for filtered sets
+    uint64_t (*hash)(const void *);
+    Bloom *filter;
+    // keys the filter was sized for
+    size_t filter_keys;
+    // removals since the filter was built, each leaving stale bits
+    size_t removals;
+
+    Allocator allocator;
+};
+
 Set *set_new(void *(*copy)(const void *), int (*compare)(const void *, const void *), void (*destroy)(void *))
 {
-    return (Set*)rbtree_new(copy, compare, destroy, NULL, NULL, NULL);
+    Allocator allocator = alloc_get_allocator();
+    Set *set = alloc_calloc(&allocator, 1, sizeof(Set));
+    set->allocator = allocator;
+    set->tree = rbtree_new(copy, compare, destroy, NULL, NULL, NULL);
+    return set;
 }
 
-bool set_equal(const void *a, const void *b)
+static void rebuild_filter(Set *set)
 {
-    return rbtree_equal(a, b);
+    size_t size = rbtree_size(set->tree);
+
+    bloom_destroy(set->filter);
+    // room to double before the next rebuild
+    set->filter_keys = size * 2 > FILTER_MIN_KEYS ? size * 2 : FILTER_MIN_KEYS;
+    // from the set's allocator, whichever one is current now
+    Allocator previous = alloc_set_allocator(&set->allocator);
+    set->filter = bloom_new(set->filter_keys, FILTER_FALSE_POSITIVE_RATE);
+    alloc_set_allocator(&previous);
+    set->removals = 0;
+
+    RBTreeIterator *iter = rbtree_iterator_new(set->tree);
+    void *element;
+    while (rbtree_iterator_next(iter, &element, NULL))
+    {
+        bloom_add(set->filter, set->hash(element));
+    }
+    rbtree_iterator_destroy(iter);
 }
 
-void set_destroy(void *set)
+Set *set_new_filtered(void *(*copy)(const void *), int (*compare)(const void *, const void *),
+                      void (*destroy)(void *), uint64_t (*hash)(const void *))
 {
-    rbtree_destroy(set);
+    Set *set = set_new(copy, compare, destroy);
+    set->hash = hash;
+    rebuild_filter(set);
+    return set;
+}
+
+bool set_equal(const void *_a, const void *_b)
+{
+    const Set *a = _a, *b = _b;
+
+    if (a == b)
+    {
+        return true;
+    }
+    if (a == NULL || b == NULL)
+    {
+        return false;
+    }
+    return rbtree_equal(a->tree, b->tree);
+}
+
+void set_destroy(void *_set)
+{
+    Set *set = _set;
+    if (set)
+    {
+        rbtree_destroy(set->tree);
+        bloom_destroy(set->filter);
+        alloc_free(&set->allocator, set);
+    }
 }
 
 bool set_add(Set *set, void *element)
 {
     assert(element);
-    return rbtree_put((RBTree *)set, element, element);
+    bool existed = rbtree_put(set->tree, element, element);
+
+    if (set->filter && !existed)
+    {
+        if (rbtree_size(set->tree) > set->filter_keys)
+        {
+            rebuild_filter(set);
+        }
+        else
+        {
+            bloom_add(set->filter, set->hash(element));
+        }
+    }
+
+    return existed;
 }
 
 bool set_contains(const Set *set, const void *element)
 {
-    return rbtree_get((const RBTree *)set, element) == element;
+    if (set->filter && !bloom_may_contain(set->filter, set->hash(element)))
+    {
+        return false;
+    }
+    return rbtree_get(set->tree, element) == element;
+}
+
+size_t set_contains_many(const Set *set, const void *const *elements, size_t count, bool *found)
+{
+    const void *probes[CONTAINS_MANY_BATCH];
+    size_t positions[CONTAINS_MANY_BATCH];
+    void *values[CONTAINS_MANY_BATCH];
+    size_t hits = 0;
+
+    for (size_t base = 0; base < count; base += CONTAINS_MANY_BATCH)
+    {
+        size_t n = (count - base < CONTAINS_MANY_BATCH) ? count - base : CONTAINS_MANY_BATCH;
+
+        // only what gets past the filter goes down the tree
+        size_t probe_count = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            const void *element = elements[base + i];
+            if (found)
+            {
+                found[base + i] = false;
+            }
+            if (!set->filter || bloom_may_contain(set->filter, set->hash(element)))
+            {
+                probes[probe_count] = element;
+                positions[probe_count++] = base + i;
+            }
+        }
+
+        rbtree_get_many(set->tree, probes, probe_count, values);
+
+        for (size_t i = 0; i < probe_count; i++)
+        {
+            bool hit = values[i] == probes[i];
+            if (found)
+            {
+                found[positions[i]] = hit;
+            }
+            hits += hit;
+        }
+    }
+
+    return hits;
 }
 
 bool set_remove(Set *set, const void *element)
 {
-    return rbtree_remove((RBTree *)set, element);
+    bool removed = rbtree_remove(set->tree, element);
+
+    if (set->filter && removed && ++set->removals > set->filter_keys / 2)
+    {
+        rebuild_filter(set);
+    }
+
+    return removed;
 }
 
 void set_clear(Set *set)
 {
-    rbtree_clear((RBTree *)set);
+    rbtree_clear(set->tree);
+    if (set->filter)
+    {
+        bloom_clear(set->filter);
+        set->removals = 0;
+    }
 }
 
 size_t set_size(const Set *set)
 {
-    return rbtree_size((const RBTree *)set);
+    return rbtree_size(set->tree);
+}
+
+FrozenMap *set_freeze(const Set *set)
+{
+    return rbtree_freeze(set->tree);
 }
 
 SetIterator *set_iterator_new(const Set *set)
 {
-    return (SetIterator*)rbtree_iterator_new((RBTree *)set);
+    return (SetIterator*)rbtree_iterator_new(set->tree);
 }
 
 void *set_iterator_next(SetIterator *iter)
@@ -3,19 +3,31 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
-typedef void *Set;
+#include "frozen-map.h"
+
+typedef struct Set_ Set;
 typedef void *SetIterator;
 
 Set *set_new(void *(*copy)(const void *), int (*compare)(const void *, const void *), void (*destroy)(void *));
+/**
+ * Set that keeps a Bloom filter over hash(element) in front of the tree, so
+ * that most misses cost one cache line. The filter is rebuilt as the set
+ * grows, and as removals leave stale bits behind.
+ */
+Set *set_new_filtered(void *(*copy)(const void *), int (*compare)(const void *, const void *),
+                      void (*destroy)(void *), uint64_t (*hash)(const void *));
 bool set_equal(const void *a, const void *b);
 void set_destroy(void *set);
 
 bool set_add(Set *set, void *element);
 bool set_contains(const Set *set, const void *element);
+size_t set_contains_many(const Set *set, const void *const *elements, size_t count, bool *found);
 bool set_remove(Set *set, const void *element);
 void set_clear(Set *set);
 size_t set_size(const Set *set);
+FrozenMap *set_freeze(const Set *set);
 
 SetIterator *set_iterator_new(const Set *set);
 void *set_iterator_next(SetIterator *iter);
@@ -0,0 +1,361 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "task-pool.h"
+
+#include "alloc.h"
+#include "ring-queue.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#if !defined(__GNUC__)
+#error "task-pool needs the GCC __atomic builtins"
+#endif
+
+#define CACHE_LINE 64
+#define DEQUE_CAPACITY 4096
+#define INJECT_CAPACITY 4096
+// failed steal rounds before a worker goes to sleep
+#define IDLE_SPINS 64
+// nested syncs that may run foreign tasks on one thread's stack
+#define SYNC_STEAL_DEPTH 4
+
+#define LOAD(p, order) __atomic_load_n(p, __ATOMIC_##order)
+#define STORE(p, v, order) __atomic_store_n(p, v, __ATOMIC_##order)
+#define FENCE(order) __atomic_thread_fence(__ATOMIC_##order)
+#define CAS(p, expected, desired) \
+    __atomic_compare_exchange_n(p, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)
+
+typedef struct
+{
+    void (*fn)(void *arg);
+    void *arg;
+    TaskGroup *group;
+} Task;
+
+/*
+ * Fixed-size Chase-Lev deque, after Le et al., "Correct and Efficient
+ * Work-Stealing for Weak Memory Models". When it is full, the spawner
+ * just runs the task itself.
+ */
+typedef struct
+{
+    int64_t top;
+    char pad0[CACHE_LINE - sizeof(int64_t)];
+    int64_t bottom;
+    char pad1[CACHE_LINE - sizeof(int64_t)];
+    Task *slots[DEQUE_CAPACITY];
+} Deque;
+
+static bool deque_push(Deque *deque, Task *task)
+{
+    int64_t b = LOAD(&deque->bottom, RELAXED);
+    int64_t t = LOAD(&deque->top, ACQUIRE);
+
+    if (b - t >= DEQUE_CAPACITY)
+    {
+        return false;
+    }
+
+    STORE(&deque->slots[b % DEQUE_CAPACITY], task, RELAXED);
+    FENCE(RELEASE);
+    STORE(&deque->bottom, b + 1, RELAXED);
+    return true;
+}
+
+static Task *deque_take(Deque *deque)
+{
+    int64_t b = LOAD(&deque->bottom, RELAXED) - 1;
+    STORE(&deque->bottom, b, RELAXED);
+    FENCE(SEQ_CST);
+    int64_t t = LOAD(&deque->top, RELAXED);
+
+    if (t > b)
+    {
+        STORE(&deque->bottom, b + 1, RELAXED);
+        return NULL;
+    }
+
+    Task *task = LOAD(&deque->slots[b % DEQUE_CAPACITY], RELAXED);
+    if (t == b)
+    {
+        // last item, race the thieves for it
+        if (!CAS(&deque->top, &t, t + 1))
+        {
+            task = NULL;
+        }
+        STORE(&deque->bottom, b + 1, RELAXED);
+    }
+    return task;
+}
+
+static Task *deque_steal(Deque *deque)
+{
+    int64_t t = LOAD(&deque->top, ACQUIRE);
+    FENCE(SEQ_CST);
+    int64_t b = LOAD(&deque->bottom, ACQUIRE);
+
+    if (t >= b)
+    {
+        return NULL;
+    }
+
+    Task *task = LOAD(&deque->slots[t % DEQUE_CAPACITY], RELAXED);
+    return CAS(&deque->top, &t, t + 1) ? task : NULL;
+}
+
+typedef struct
+{
+    Deque deque;
+    TaskPool *pool;
+    unsigned int index;
+    unsigned int seed;
+    pthread_t thread;
+} Worker;
+
+struct TaskPool_
+{
+    Worker *workers;
+    unsigned int count;
+    MPMCQueue *inject;
+
+    // sleeping workers wait for epoch to move
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    uint64_t epoch;
+    unsigned int sleepers;
+    bool stopping;
+
+    // tasks may be spawned and run on threads with different allocators
+    Allocator allocator;
+};
+
+static LU_THREAD_LOCAL Worker *current_worker;
+// foreign tasks currently running on this thread's stack from inside a sync
+static LU_THREAD_LOCAL unsigned int steal_depth;
+
+static void notify(TaskPool *pool)
+{
+    __atomic_add_fetch(&pool->epoch, 1, __ATOMIC_SEQ_CST);
+    if (LOAD(&pool->sleepers, SEQ_CST) > 0)
+    {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+static void run(TaskPool *pool, Task *task)
+{
+    TaskGroup *group = task->group;
+
+    task->fn(task->arg);
+    alloc_free(&pool->allocator, task);
+    __atomic_sub_fetch(&group->pending, 1, __ATOMIC_RELEASE);
+}
+
+// Takes a task from the injection queue or another worker's deque
+static Task *steal_task(TaskPool *pool, Worker *self, unsigned int *seed)
+{
+    void *item;
+    if (mpmc_queue_pop(pool->inject, &item))
+    {
+        return item;
+    }
+
+    // one sweep over the other workers from a random start
+    unsigned int start = (unsigned int)rand_r(seed) % pool->count;
+    for (unsigned int i = 0; i < pool->count; i++)
+    {
+        Worker *victim = &pool->workers[(start + i) % pool->count];
+        Task *task;
+        if (victim != self && (task = deque_steal(&victim->deque)))
+        {
+            return task;
+        }
+    }
+    return NULL;
+}
+
+static Task *find_task(TaskPool *pool, Worker *self, unsigned int *seed)
+{
+    Task *task;
+
+    if (self && (task = deque_take(&self->deque)))
+    {
+        return task;
+    }
+    return steal_task(pool, self, seed);
+}
+
+static void *worker_main(void *arg)
+{
+    Worker *self = arg;
+    TaskPool *pool = self->pool;
+    unsigned int idle = 0;
+
+    current_worker = self;
+
+    for (;;)
+    {
+        uint64_t epoch = LOAD(&pool->epoch, SEQ_CST);
+        Task *task = find_task(pool, self, &self->seed);
+
+        if (task)
+        {
+            run(pool, task);
+            idle = 0;
+            continue;
+        }
+        if (++idle < IDLE_SPINS)
+        {
+            sched_yield();
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        __atomic_add_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+        while (!pool->stopping && LOAD(&pool->epoch, SEQ_CST) == epoch)
+        {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        __atomic_sub_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+        bool stop = pool->stopping;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (stop)
+        {
+            return NULL;
+        }
+        idle = 0;
+    }
+}
+
+TaskPool *task_pool_new(unsigned int workers)
+{
+    if (workers == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? (unsigned int)cpus : 1;
+    }
+
+    Allocator allocator = alloc_get_allocator();
+    TaskPool *pool = alloc_malloc(&allocator, sizeof(TaskPool));
+    pool->allocator = allocator;
+    pool->workers = alloc_calloc(&allocator, workers, sizeof(Worker));
+    pool->count = workers;
+    pool->inject = mpmc_queue_new(INJECT_CAPACITY, false);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pool->epoch = 0;
+    pool->sleepers = 0;
+    pool->stopping = false;
+
+    for (unsigned int i = 0; i < workers; i++)
+    {
+        Worker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        worker->seed = i * 2654435761u + 1;
+        int res = pthread_create(&worker->thread, NULL, worker_main, worker);
+        assert(res == 0);
+        (void)res;
+    }
+
+    return pool;
+}
+
+void task_pool_destroy(TaskPool *pool)
+{
+    if (!pool)
+    {
+        return;
+    }
+
+    // drain whatever is still queued before the workers go away
+    unsigned int seed = 1;
+    Task *task;
+    while ((task = find_task(pool, NULL, &seed)))
+    {
+        run(pool, task);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (unsigned int i = 0; i < pool->count; i++)
+    {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    mpmc_queue_destroy(pool->inject);
+    Allocator allocator = pool->allocator;
+    alloc_free(&allocator, pool->workers);
+    alloc_free(&allocator, pool);
+}
+
+unsigned int task_pool_workers(const TaskPool *pool)
+{
+    return pool->count;
+}
+
+void task_pool_spawn(TaskPool *pool, TaskGroup *group, void (*fn)(void *arg), void *arg)
+{
+    Task *task = alloc_malloc(&pool->allocator, sizeof(Task));
+    task->fn = fn;
+    task->arg = arg;
+    task->group = group;
+
+    __atomic_add_fetch(&group->pending, 1, __ATOMIC_RELAXED);
+
+    Worker *self = current_worker;
+    bool queued = (self && self->pool == pool) ? deque_push(&self->deque, task)
+                                               : mpmc_queue_push(pool->inject, task);
+    if (!queued)
+    {
+        run(pool, task);
+        return;
+    }
+    notify(pool);
+}
+
+/*
+ * Tasks popped from the thread's own deque were forked by this thread, so
+ * running them keeps the stack about as deep as serial execution would.
+ * A stolen task can sync and steal again in turn, so only a few of those
+ * may nest before the waiter falls back to yielding.
+ */
+void task_pool_sync(TaskPool *pool, TaskGroup *group)
+{
+    Worker *self = (current_worker && current_worker->pool == pool) ? current_worker : NULL;
+    unsigned int seed = (unsigned int)(uintptr_t)group;
+
+    while (LOAD(&group->pending, ACQUIRE) > 0)
+    {
+        Task *task = self ? deque_take(&self->deque) : NULL;
+        if (task)
+        {
+            run(pool, task);
+            continue;
+        }
+
+        if (steal_depth < SYNC_STEAL_DEPTH &&
+            (task = steal_task(pool, self, self ? &self->seed : &seed)))
+        {
+            steal_depth++;
+            run(pool, task);
+            steal_depth--;
+            continue;
+        }
+        sched_yield();
+    }
+}
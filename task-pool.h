@@ -0,0 +1,37 @@
+#ifndef LIBUTILS_TASK_POOL_H
+#define LIBUTILS_TASK_POOL_H
+
+#include <stddef.h>
+
+/*
+ * A fork/join scheduler over a fixed set of worker threads. Every worker
+ * owns a Chase-Lev deque: it pushes and pops spawned tasks at the bottom
+ * while idle workers steal from the top. Tasks spawned from outside the
+ * pool go through a shared injection queue.
+ */
+
+typedef struct TaskPool_ TaskPool;
+
+// Counts the unfinished tasks spawned into it; initialize with TASK_GROUP_INIT
+typedef struct
+{
+    size_t pending;
+} TaskGroup;
+
+#define TASK_GROUP_INIT { 0 }
+
+// workers == 0 starts one worker per online CPU
+TaskPool *task_pool_new(unsigned int workers);
+// Waits for queued tasks to finish, then stops the workers
+void task_pool_destroy(TaskPool *pool);
+unsigned int task_pool_workers(const TaskPool *pool);
+
+void task_pool_spawn(TaskPool *pool, TaskGroup *group, void (*fn)(void *arg), void *arg);
+/**
+ * Returns once every task spawned into group has finished. The calling
+ * thread runs and steals tasks while it waits, so tasks may sync on the
+ * groups they spawn into without tying up a worker.
+ */
+void task_pool_sync(TaskPool *pool, TaskGroup *group);
+
+#endif
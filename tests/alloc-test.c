@@ -1,4 +1,138 @@
+#include "alloc.h"
+#include "seq.h"
+#include "typed-rb-tree.h"
+#include "typed-seq.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define INT_CMP(a, b) ((a) < (b) ? -1 : (a) > (b))
+
+LU_RBTREE_DEFINE(IntMap, int, int, INT_CMP)
+LU_SEQ_DEFINE(IntSeq, int)
+
+static size_t live;
+
+static void *counting_allocate(void *context, size_t size)
+{
+    live++;
+    return malloc(size);
+}
+
+static void *counting_reallocate(void *context, void *ptr, size_t size)
+{
+    if (!ptr)
+    {
+        live++;
+    }
+    return realloc(ptr, size);
+}
+
+static void counting_deallocate(void *context, void *ptr)
+{
+    if (ptr)
+    {
+        live--;
+    }
+    free(ptr);
+}
+
+static void test_set_allocator(void **state)
+{
+    Allocator counting = { counting_allocate, counting_reallocate, counting_deallocate, NULL };
+    alloc_set_allocator(&counting);
+    assert_true(alloc_get_allocator().allocate == counting_allocate);
+
+    int *a = xcalloc(4, sizeof(int));
+    assert_int_equal(0, a[0] + a[1] + a[2] + a[3]);
+    a = xrealloc(a, 8 * sizeof(int));
+    char *b = xmemdup("hello", 6);
+    assert_string_equal("hello", b);
+    assert_int_equal(2, live);
+
+    xfree(a);
+    xfree(b);
+    xfree(NULL);
+    assert_int_equal(0, live);
+
+    alloc_set_allocator(NULL);
+    assert_true(alloc_get_allocator().allocate != counting_allocate);
+    xfree(xmalloc(8));
+    assert_int_equal(0, live);
+}
+
+static void test_container_keeps_allocator(void **state)
+{
+    Allocator counting = { counting_allocate, counting_reallocate, counting_deallocate, NULL };
+    alloc_set_allocator(&counting);
+    Seq *seq = seq_new_sized(sizeof(int), 0, NULL);
+    alloc_set_allocator(NULL);
+
+    // grows and goes away through the allocator it was created with
+    for (int i = 0; i < 1000; i++)
+    {
+        seq_append(seq, &i);
+    }
+    assert_true(live > 0);
+    seq_destroy(seq);
+    assert_int_equal(0, live);
+
+    // the macro containers too
+    alloc_set_allocator(&counting);
+    IntMap *map = IntMap_new();
+    IntSeq *ints = IntSeq_new(0);
+    alloc_set_allocator(NULL);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        IntMap_put(map, i, i);
+        IntSeq_append(ints, i);
+    }
+    for (int i = 0; i < 500; i++)
+    {
+        IntMap_remove(map, i);
+    }
+    IntMap_destroy(map);
+    IntSeq_destroy(ints);
+    assert_int_equal(0, live);
+}
+
+static void *allocate_elsewhere(void *arg)
+{
+    return xmalloc(64);
+}
+
+static void test_thread_local(void **state)
+{
+    Allocator counting = { counting_allocate, counting_reallocate, counting_deallocate, NULL };
+    Allocator previous = alloc_set_allocator(&counting);
+    assert_true(previous.allocate != counting_allocate);
+
+    // other threads keep malloc
+    pthread_t thread;
+    void *block;
+    pthread_create(&thread, NULL, allocate_elsewhere, NULL);
+    pthread_join(thread, &block);
+    assert_int_equal(0, live);
+    free(block);
+
+    alloc_set_allocator(&previous);
+}
+
 int main()
 {
-    return 0;
+    const UnitTest tests[] =
+    {
+        unit_test(test_set_allocator),
+        unit_test(test_container_keeps_allocator),
+        unit_test(test_thread_local)
+    };
+
+    return run_tests(tests);
 }
@@ -0,0 +1,252 @@
+#include "art.h"
+
+#include "alloc.h"
+#include "rb-tree.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void *int_copy(const void *_a)
+{
+    return xmemdup(_a, sizeof(int));
+}
+
+static void test_put_get_remove(void **state)
+{
+    ARTree *t = art_new(int_copy, free);
+
+    int a = 42, b = 43;
+    assert_false(art_put(t, "abc", 3, &a));
+    assert_int_equal(42, *(int *)art_get(t, "abc", 3));
+    assert_true(art_put(t, "abc", 3, &b));
+    assert_int_equal(43, *(int *)art_get(t, "abc", 3));
+    assert_int_equal(1, art_size(t));
+
+    assert_true(art_get(t, "ab", 2) == NULL);
+    assert_true(art_get(t, "abcd", 4) == NULL);
+
+    assert_false(art_put(t, "ab", 2, &a));
+    assert_false(art_put(t, "", 0, &a));
+    assert_false(art_put(t, "abcd", 4, &a));
+    assert_int_equal(4, art_size(t));
+    assert_int_equal(42, *(int *)art_get(t, "", 0));
+    assert_int_equal(42, *(int *)art_get(t, "ab", 2));
+
+    assert_true(art_remove(t, "abc", 3));
+    assert_false(art_remove(t, "abc", 3));
+    assert_true(art_get(t, "abc", 3) == NULL);
+    assert_int_equal(42, *(int *)art_get(t, "abcd", 4));
+    assert_int_equal(3, art_size(t));
+
+    art_destroy(t);
+}
+
+static int string_compare(const void *a, const void *b)
+{
+    return strcmp(a, b);
+}
+
+static void *string_copy(const void *s)
+{
+    return xmemdup(s, strlen(s) + 1);
+}
+
+// random paths with long shared prefixes, checked against an RBTree
+static void test_against_rbtree(void **state)
+{
+    static const char *parts[] = { "/usr", "/local", "/share", "/x", "/a", "/very-long-directory-name", "/lib", "/b" };
+
+    ARTree *t = art_new(NULL, NULL);
+    RBTree *expected = rbtree_new(string_copy, string_compare, free, NULL, NULL, NULL);
+
+    srand(0);
+    for (int round = 0; round < 20000; round++)
+    {
+        char key[256] = "";
+        int depth = rand() % 6;
+        for (int i = 0; i < depth; i++)
+        {
+            strcat(key, parts[rand() % 8]);
+        }
+        if (rand() % 2)
+        {
+            char suffix[16];
+            snprintf(suffix, sizeof(suffix), "/%d", rand() % 300);
+            strcat(key, suffix);
+        }
+
+        size_t size = strlen(key);
+        void *value = (void *)(uintptr_t)(round + 1);
+
+        if (rand() % 3 == 0)
+        {
+            bool removed = art_remove(t, key, size);
+            assert_int_equal(rbtree_remove(expected, key), removed);
+        }
+        else
+        {
+            bool replaced = art_put(t, key, size, value);
+            assert_int_equal(rbtree_put(expected, key, value), replaced);
+        }
+        assert_int_equal(rbtree_size(expected), art_size(t));
+    }
+
+    RBTreeIterator *it = rbtree_iterator_new(expected);
+    ARTreeIterator *art_it = art_iterator_new(t);
+    void *k, *v, *av;
+    const void *ak;
+    size_t ak_size;
+    while (rbtree_iterator_next(it, &k, &v))
+    {
+        assert_true(art_get(t, k, strlen(k)) == v);
+
+        assert_true(art_iterator_next(art_it, &ak, &ak_size, &av));
+        assert_int_equal(strlen(k), ak_size);
+        assert_memory_equal(k, ak, ak_size);
+        assert_true(av == v);
+    }
+    assert_false(art_iterator_next(art_it, &ak, &ak_size, &av));
+    art_iterator_destroy(art_it);
+    rbtree_iterator_destroy(it);
+
+    it = rbtree_iterator_new(expected);
+    while (rbtree_iterator_next(it, &k, NULL))
+    {
+        assert_true(art_remove(t, k, strlen(k)));
+    }
+    rbtree_iterator_destroy(it);
+    assert_int_equal(0, art_size(t));
+
+    rbtree_destroy(expected);
+    art_destroy(t);
+}
+
+static void test_prefix(void **state)
+{
+    ARTree *t = art_new(NULL, NULL);
+    const char *keys[] = { "api", "app", "apple", "applet", "application", "apt", "b", "ap" };
+    for (int i = 0; i < 8; i++)
+    {
+        art_put(t, keys[i], strlen(keys[i]), keys[i]);
+    }
+
+    const char *expected[] = { "app", "apple", "applet", "application" };
+    ARTreeIterator *it = art_iterator_new_prefix(t, "app", 3);
+    const void *k;
+    size_t k_size;
+    int n = 0;
+    while (art_iterator_next(it, &k, &k_size, NULL))
+    {
+        assert_int_equal(strlen(expected[n]), k_size);
+        assert_memory_equal(expected[n], k, k_size);
+        n++;
+    }
+    assert_int_equal(4, n);
+    art_iterator_destroy(it);
+
+    it = art_iterator_new_prefix(t, "appl", 4);
+    n = 0;
+    while (art_iterator_next(it, NULL, NULL, NULL))
+    {
+        n++;
+    }
+    assert_int_equal(3, n);
+    art_iterator_destroy(it);
+
+    it = art_iterator_new_prefix(t, "c", 1);
+    assert_false(art_iterator_next(it, NULL, NULL, NULL));
+    art_iterator_destroy(it);
+
+    art_destroy(t);
+}
+
+static void test_u64_keys(void **state)
+{
+    ARTree *t = art_new(NULL, NULL);
+    unsigned char key[ART_KEY_U64_SIZE];
+
+    srand(1);
+    for (int i = 0; i < 10000; i++)
+    {
+        uint64_t v = ((uint64_t)rand() << 20) ^ (uint64_t)rand();
+        art_key_u64(v, key);
+        art_put(t, key, sizeof(key), NULL);
+    }
+    for (uint64_t v = 0; v < 1000; v++)
+    {
+        art_key_u64(v, key);
+        art_put(t, key, sizeof(key), (void *)(uintptr_t)v);
+    }
+
+    ARTreeIterator *it = art_iterator_new(t);
+    const void *k;
+    size_t k_size;
+    unsigned char last[ART_KEY_U64_SIZE] = { 0 };
+    bool first = true;
+    while (art_iterator_next(it, &k, &k_size, NULL))
+    {
+        assert_int_equal(ART_KEY_U64_SIZE, k_size);
+        if (!first)
+        {
+            assert_true(memcmp(last, k, k_size) < 0);
+        }
+        memcpy(last, k, k_size);
+        first = false;
+    }
+    art_iterator_destroy(it);
+
+    for (uint64_t v = 0; v < 1000; v++)
+    {
+        art_key_u64(v, key);
+        assert_true(art_remove(t, key, sizeof(key)));
+    }
+
+    art_destroy(t);
+}
+
+static void test_grow_shrink(void **state)
+{
+    ARTree *t = art_new(NULL, NULL);
+    unsigned char key[2] = { 'x', 0 };
+
+    for (int i = 0; i < 256; i++)
+    {
+        key[1] = i;
+        art_put(t, key, 2, (void *)(uintptr_t)(i + 1));
+    }
+    assert_int_equal(256, art_size(t));
+
+    for (int i = 0; i < 256; i++)
+    {
+        key[1] = (i * 37) % 256;
+        assert_true(art_remove(t, key, 2));
+
+        for (int j = i + 1; j < 256; j++)
+        {
+            key[1] = (j * 37) % 256;
+            assert_true(art_get(t, key, 2) == (void *)(uintptr_t)(key[1] + 1));
+        }
+    }
+    assert_int_equal(0, art_size(t));
+
+    art_destroy(t);
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_put_get_remove),
+        unit_test(test_against_rbtree),
+        unit_test(test_prefix),
+        unit_test(test_u64_keys),
+        unit_test(test_grow_shrink)
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,105 @@
+#include "bloom.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+
+#include <stdio.h>
+#include <string.h>
+
+static uint64_t key_hash(uint64_t i)
+{
+    return bloom_hash_bytes(&i, sizeof(i));
+}
+
+static void test_false_positive_rate(void **state)
+{
+    const double rates[] = { 0.1, 0.01, 0.001 };
+    const size_t count = 100000;
+
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+    {
+        Bloom *bloom = bloom_new(count, rates[r]);
+
+        for (uint64_t i = 0; i < count; i++)
+        {
+            bloom_add(bloom, key_hash(i));
+        }
+        for (uint64_t i = 0; i < count; i++)
+        {
+            assert_true(bloom_may_contain(bloom, key_hash(i)));
+        }
+
+        size_t false_positives = 0;
+        for (uint64_t i = count; i < 11 * count; i++)
+        {
+            false_positives += bloom_may_contain(bloom, key_hash(i));
+        }
+        double rate = (double)false_positives / (10 * count);
+        assert_true(rate < rates[r] * 1.5);
+
+        bloom_destroy(bloom);
+    }
+}
+
+static void test_merge_clear(void **state)
+{
+    Bloom *a = bloom_new(1000, 0.01);
+    Bloom *b = bloom_new(1000, 0.01);
+    Bloom *other = bloom_new(5000, 0.01);
+
+    for (uint64_t i = 0; i < 1000; i++)
+    {
+        bloom_add(i % 2 ? a : b, key_hash(i));
+    }
+
+    assert_false(bloom_merge(a, other));
+    assert_true(bloom_merge(a, b));
+    for (uint64_t i = 0; i < 1000; i++)
+    {
+        assert_true(bloom_may_contain(a, key_hash(i)));
+    }
+    assert_true(bloom_memory(other) > bloom_memory(a));
+
+    bloom_clear(a);
+    size_t hits = 0;
+    for (uint64_t i = 0; i < 1000; i++)
+    {
+        hits += bloom_may_contain(a, key_hash(i));
+    }
+    assert_int_equal(0, hits);
+
+    bloom_destroy(a);
+    bloom_destroy(b);
+    bloom_destroy(other);
+}
+
+static void test_hash_bytes(void **state)
+{
+    char key[16];
+    assert_true(bloom_hash_bytes("abc", 3) == bloom_hash_bytes("abc", 3));
+    assert_true(bloom_hash_bytes("abc", 3) != bloom_hash_bytes("abd", 3));
+    assert_true(bloom_hash_bytes("abc", 3) != bloom_hash_bytes("abc", 2));
+
+    // an empty filter holds nothing, even with a tiny expected size
+    Bloom *bloom = bloom_new(0, 0.5);
+    for (int i = 0; i < 100; i++)
+    {
+        snprintf(key, sizeof(key), "key%d", i);
+        assert_false(bloom_may_contain(bloom, bloom_hash_bytes(key, strlen(key))));
+    }
+    bloom_destroy(bloom);
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_false_positive_rate),
+        unit_test(test_merge_clear),
+        unit_test(test_hash_bytes)
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,312 @@
+#include "cache.h"
+
+#include "alloc.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t fake_now;
+
+static uint64_t fake_clock(void)
+{
+    return fake_now;
+}
+
+static void *string_copy(const void *s)
+{
+    return xmemdup(s, strlen(s) + 1);
+}
+
+static int string_compare(const void *a, const void *b)
+{
+    return strcmp(a, b);
+}
+
+static uint64_t string_hash(const void *s)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (const unsigned char *p = s; *p; p++)
+    {
+        h = (h ^ *p) * 0x100000001b3ULL;
+    }
+    return h ^ (h >> 32);
+}
+
+static size_t value_bytes(const void *key, const void *value)
+{
+    return strlen(value);
+}
+
+static const CacheCallbacks strings =
+{
+    string_copy, string_compare, string_hash, free, string_copy, free, NULL, fake_clock
+};
+
+static void test_lru(void **state)
+{
+    Cache *cache = cache_new(&strings, 3, CACHE_LRU);
+    CacheStats stats;
+
+    assert_false(cache_put(cache, "a", "1"));
+    assert_false(cache_put(cache, "b", "2"));
+    assert_false(cache_put(cache, "c", "3"));
+    assert_string_equal("1", cache_get(cache, "a"));
+
+    cache_put(cache, "d", "4");
+    assert_int_equal(3, cache_size(cache));
+    assert_true(cache_get(cache, "b") == NULL);
+    assert_string_equal("3", cache_get(cache, "c"));
+
+    // replacing refreshes too
+    assert_true(cache_put(cache, "a", "one"));
+    cache_put(cache, "e", "5");
+    assert_true(cache_get(cache, "d") == NULL);
+    assert_string_equal("one", cache_get(cache, "a"));
+
+    cache_stats(cache, &stats);
+    assert_int_equal(3, stats.hits);
+    assert_int_equal(2, stats.misses);
+    assert_int_equal(2, stats.evictions);
+
+    assert_true(cache_remove(cache, "a"));
+    assert_false(cache_remove(cache, "a"));
+    assert_int_equal(2, cache_size(cache));
+
+    cache_destroy(cache);
+}
+
+static void test_clock(void **state)
+{
+    Cache *cache = cache_new(&strings, 3, CACHE_CLOCK);
+
+    cache_put(cache, "a", "1");
+    cache_put(cache, "b", "2");
+    cache_put(cache, "c", "3");
+    cache_get(cache, "a");
+
+    // a gets a second chance, b goes
+    cache_put(cache, "d", "4");
+    assert_true(cache_get(cache, "b") == NULL);
+    assert_true(cache_get(cache, "a") != NULL);
+
+    // the hand moved on past a, whose bit was cleared and then set again
+    for (int i = 0; i < 100; i++)
+    {
+        char key[8];
+        snprintf(key, sizeof(key), "k%d", i);
+        cache_put(cache, key, "x");
+        assert_int_equal(3, cache_size(cache));
+    }
+
+    cache_clear(cache);
+    assert_int_equal(0, cache_size(cache));
+    cache_put(cache, "z", "26");
+    assert_string_equal("26", cache_get(cache, "z"));
+
+    cache_destroy(cache);
+}
+
+static void test_weight(void **state)
+{
+    CacheCallbacks callbacks = strings;
+    callbacks.weight = value_bytes;
+    Cache *cache = cache_new(&callbacks, 10, CACHE_LRU);
+
+    cache_put(cache, "a", "xxxx");
+    cache_put(cache, "b", "xxxx");
+    assert_int_equal(8, cache_weight(cache));
+    cache_put(cache, "c", "xxxx");
+    assert_int_equal(2, cache_size(cache));
+    assert_int_equal(8, cache_weight(cache));
+
+    // a bigger value for c squeezes out b
+    cache_put(cache, "c", "xxxxxxxx");
+    assert_int_equal(1, cache_size(cache));
+    assert_int_equal(8, cache_weight(cache));
+
+    cache_destroy(cache);
+}
+
+static void test_ttl(void **state)
+{
+    CacheStats stats;
+
+    fake_now = 1000;
+    Cache *cache = cache_new(&strings, 100000, CACHE_LRU);
+    cache_put_ttl(cache, "short", "1", 5);
+    cache_put(cache, "forever", "2");
+
+    fake_now = 1004;
+    assert_true(cache_get(cache, "short") != NULL);
+    fake_now = 1005;
+    assert_true(cache_get(cache, "short") == NULL);
+    assert_true(cache_get(cache, "forever") != NULL);
+
+    // a plain put clears an earlier TTL
+    cache_put_ttl(cache, "forever", "2", 1);
+    cache_put(cache, "forever", "3");
+    fake_now = 100000;
+    assert_string_equal("3", cache_get(cache, "forever"));
+
+    cache_stats(cache, &stats);
+    assert_int_equal(1, stats.expirations);
+
+    cache_destroy(cache);
+}
+
+static void test_idle(void **state)
+{
+    const uint64_t day = 24 * 60 * 60 * 1000;
+    CacheStats stats;
+
+    // before cache_new, which starts the wheel at the current time
+    fake_now = 5000;
+    Cache *cache = cache_new(&strings, 10, CACHE_LRU);
+    cache_put_ttl(cache, "week", "1", 7 * day);
+    cache_put_ttl(cache, "hour", "2", day / 24);
+
+    // idle time is skipped up to the next occupied slot, not ticked through
+    fake_now += day;
+    assert_true(cache_get(cache, "week") != NULL);
+    assert_true(cache_get(cache, "hour") == NULL);
+
+    fake_now = 5000 + 7 * day - 1;
+    assert_true(cache_get(cache, "week") != NULL);
+    fake_now++;
+    assert_true(cache_get(cache, "week") == NULL);
+
+    cache_stats(cache, &stats);
+    assert_int_equal(2, stats.expirations);
+
+    cache_destroy(cache);
+}
+
+static void test_wheel(void **state)
+{
+    enum { COUNT = 2000 };
+    static uint64_t expires[COUNT];
+    char key[16];
+
+    fake_now = 123456;
+    Cache *cache = cache_new(&strings, COUNT, CACHE_CLOCK);
+
+    srand(1);
+    for (int i = 0; i < COUNT; i++)
+    {
+        // spread over every level, and past the wheel's span
+        uint64_t ttl = 1 + (uint64_t)rand() % (i % 5 == 4 ? 40000000 : 300000);
+        snprintf(key, sizeof(key), "k%d", i);
+        cache_put_ttl(cache, key, "v", ttl);
+        expires[i] = fake_now + ttl;
+        fake_now += rand() % 3;
+    }
+
+    CacheStats stats;
+    size_t expired = 0;
+    bool jumped = false;
+    while (expired < COUNT)
+    {
+        fake_now += 1 + rand() % 2000;
+        cache_expire(cache);
+        cache_stats(cache, &stats);
+        expired = stats.expirations;
+
+        size_t live = 0;
+        for (int i = 0; i < COUNT; i++)
+        {
+            live += expires[i] > fake_now;
+        }
+        assert_int_equal(live, cache_size(cache));
+        assert_int_equal(COUNT - live, expired);
+
+        // jump ahead once the short TTLs are done
+        if (!jumped && fake_now > 123456 + 2 * COUNT + 300000)
+        {
+            fake_now += 20000000;
+            jumped = true;
+        }
+    }
+
+    cache_destroy(cache);
+}
+
+#define THREADS 4
+#define KEYS 5000
+
+static void *hammer(void *arg)
+{
+    ConcurrentCache *cache = arg;
+    char key[16], value[16];
+
+    for (int i = 0; i < 50000; i++)
+    {
+        int k = rand() % KEYS;
+        snprintf(key, sizeof(key), "k%d", k);
+        snprintf(value, sizeof(value), "v%d", k);
+
+        void *cached;
+        if (concurrent_cache_get(cache, key, &cached))
+        {
+            assert_string_equal(value, cached);
+            free(cached);
+        }
+        else
+        {
+            concurrent_cache_put(cache, key, value);
+        }
+    }
+    return NULL;
+}
+
+static void test_concurrent(void **state)
+{
+    CacheCallbacks callbacks = strings;
+    callbacks.now = NULL;
+    ConcurrentCache *cache = concurrent_cache_new(&callbacks, 1000, CACHE_CLOCK, 8);
+    pthread_t threads[THREADS];
+
+    for (int t = 0; t < THREADS; t++)
+    {
+        pthread_create(&threads[t], NULL, hammer, cache);
+    }
+    for (int t = 0; t < THREADS; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+
+    assert_true(concurrent_cache_size(cache) <= 1000);
+    CacheStats stats;
+    concurrent_cache_stats(cache, &stats);
+    assert_int_equal(THREADS * 50000, stats.hits + stats.misses);
+    assert_true(stats.hits > 0 && stats.evictions > 0);
+
+    assert_false(concurrent_cache_put_ttl(cache, "ttl", "1", 100000));
+    assert_true(concurrent_cache_remove(cache, "ttl"));
+    concurrent_cache_clear(cache);
+    assert_int_equal(0, concurrent_cache_size(cache));
+
+    concurrent_cache_destroy(cache);
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_lru),
+        unit_test(test_clock),
+        unit_test(test_weight),
+        unit_test(test_ttl),
+        unit_test(test_idle),
+        unit_test(test_wheel),
+        unit_test(test_concurrent)
+    };
+
+    return run_tests(tests);
+}
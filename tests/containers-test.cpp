@@ -0,0 +1,215 @@
+#include "containers.hpp"
+
+#include <cstdarg>
+#include <cstddef>
+#include <csetjmp>
+extern "C"
+{
+#include <cmockery.h>
+}
+
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+static void test_ordered_map(void **state)
+{
+    lu::ordered_map<std::string, int> m;
+
+    assert_true(m.emplace("b", 2).second);
+    assert_false(m.emplace("b", 3).second);
+    assert_int_equal(2, m["b"]);
+    m["a"] = 1;
+    m.insert_or_assign("c", 3);
+    m.insert_or_assign("c", 4);
+    assert_int_equal(3, m.size());
+    assert_int_equal(4, m.at("c"));
+    assert_true(m.contains("a"));
+    assert_false(m.contains("d"));
+
+    std::string keys;
+    for (const auto &kv : m)
+    {
+        keys += kv.first;
+    }
+    assert_string_equal("abc", keys.c_str());
+
+    auto it = m.end();
+    --it;
+    assert_string_equal("c", it->first.c_str());
+
+    bool thrown = false;
+    try
+    {
+        m.at("zzz");
+    }
+    catch (const std::out_of_range &)
+    {
+        thrown = true;
+    }
+    assert_true(thrown);
+
+    it = m.erase(m.find("b"));
+    assert_string_equal("c", it->first.c_str());
+    assert_int_equal(0, m.erase("b"));
+    assert_int_equal(2, m.size());
+
+    lu::ordered_map<std::string, int> moved(std::move(m));
+    assert_int_equal(2, moved.size());
+    assert_int_equal(0, m.size());
+
+    lu::ordered_map<std::string, int> copy = moved;
+    copy["x"] = 9;
+    assert_int_equal(2, moved.size());
+    assert_int_equal(3, copy.size());
+
+    copy.clear();
+    assert_true(copy.empty());
+    copy["y"] = 1;
+    assert_int_equal(1, copy.size());
+}
+
+static void test_ordered_map_against_std(void **state)
+{
+    lu::ordered_map<int, int, std::greater<int>> m;
+    std::map<int, int, std::greater<int>> expected;
+
+    srand(0);
+    for (int i = 0; i < 20000; i++)
+    {
+        int k = rand() % 2000;
+        if (rand() % 4 == 0)
+        {
+            assert_int_equal(expected.erase(k), m.erase(k));
+        }
+        else
+        {
+            m[k] += i;
+            expected[k] += i;
+        }
+    }
+
+    assert_int_equal(expected.size(), m.size());
+    auto e = expected.begin();
+    for (const auto &kv : m)
+    {
+        assert_int_equal(e->first, kv.first);
+        assert_int_equal(e->second, kv.second);
+        ++e;
+    }
+    assert_true(e == expected.end());
+}
+
+static void test_move_only_values(void **state)
+{
+    lu::ordered_map<int, std::unique_ptr<int>> m;
+    m.emplace(1, std::unique_ptr<int>(new int(10)));
+    m.try_emplace(2, new int(20));
+    assert_int_equal(20, *m[2]);
+
+    lu::seq<std::unique_ptr<int>> s;
+    s.emplace_back(new int(1));
+    s.push_back(std::unique_ptr<int>(new int(2)));
+    assert_int_equal(2, *s[1]);
+}
+
+static void test_set(void **state)
+{
+    lu::set<std::string> s = { "pear", "apple", "fig" };
+    assert_false(s.insert("fig").second);
+    assert_int_equal(3, s.size());
+    assert_true(s.contains("apple"));
+    assert_int_equal(1, s.erase("apple"));
+    assert_false(s.contains("apple"));
+    assert_string_equal("fig", s.begin()->c_str());
+}
+
+struct Point
+{
+    int x;
+    double y;
+};
+
+static void test_seq(void **state)
+{
+    lu::seq<std::string> s;
+    for (int i = 0; i < 100; i++)
+    {
+        s.push_back(std::to_string(i));
+    }
+
+    assert_int_equal(100, s.size());
+    assert_string_equal("42", s[42].c_str());
+    assert_int_equal(100, s.end() - s.begin());
+
+    int n = 0;
+    for (const std::string &item : s)
+    {
+        assert_string_equal(std::to_string(n).c_str(), item.c_str());
+        n++;
+    }
+
+    lu::seq<std::string> copy = s;
+    copy[0] = "zero";
+    assert_string_equal("0", s.front().c_str());
+    assert_string_equal("zero", copy.front().c_str());
+
+    // trivially copyable elements live in the Seq itself
+    lu::seq<Point> points;
+    for (int i = 0; i < 1000; i++)
+    {
+        points.push_back({ i, i / 2.0 });
+    }
+    assert_int_equal(999, points.back().x);
+    assert_true(&points[1] == &points[0] + 1);
+}
+
+struct Throwing
+{
+    explicit Throwing(bool fail)
+    {
+        if (fail)
+        {
+            throw std::runtime_error("Throwing");
+        }
+    }
+};
+
+static void test_throwing_constructor(void **state)
+{
+    lu::ordered_map<std::string, Throwing> m;
+    m.try_emplace("a", false);
+
+    bool thrown = false;
+    try
+    {
+        m.try_emplace("b", true);
+    }
+    catch (const std::runtime_error &)
+    {
+        thrown = true;
+    }
+    assert_true(thrown);
+    assert_int_equal(1, m.size());
+    assert_false(m.contains("b"));
+
+    m.try_emplace("b", false);
+    assert_int_equal(2, m.size());
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_ordered_map),
+        unit_test(test_ordered_map_against_std),
+        unit_test(test_move_only_values),
+        unit_test(test_set),
+        unit_test(test_seq),
+        unit_test(test_throwing_constructor)
+    };
+
+    return run_tests(tests);
+}
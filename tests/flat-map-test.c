@@ -0,0 +1,133 @@
+#include "flat-map.h"
+
+#include "alloc.h"
+#include "rb-tree.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static void *int_copy(const void *p)
+{
+    return xmemdup(p, sizeof(int));
+}
+
+static int int_compare(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+static void test_put_get(void **state)
+{
+    FlatMap *map = flat_map_new(int_copy, int_compare, free, int_copy, free);
+
+    for (int i = 0; i < 100; i++)
+    {
+        int value = i * 10;
+        flat_map_put(map, &i, &value);
+    }
+    assert_int_equal(100, flat_map_size(map));
+
+    for (int i = 0; i < 100; i++)
+    {
+        assert_int_equal(i * 10, *(int *)flat_map_get(map, &i));
+    }
+    int missing = 100;
+    assert_true(flat_map_get(map, &missing) == NULL);
+    assert_false(flat_map_contains(map, &missing));
+
+    // second batch overlaps the first, later puts win
+    for (int i = 50; i < 150; i++)
+    {
+        int value = -i;
+        flat_map_put(map, &i, &value);
+        value = i;
+        flat_map_put(map, &i, &value);
+    }
+    assert_int_equal(150, flat_map_size(map));
+    for (int i = 0; i < 150; i++)
+    {
+        assert_int_equal(i, *(int *)flat_map_key_at(map, i));
+        assert_int_equal(i < 50 ? i * 10 : i, *(int *)flat_map_value_at(map, i));
+    }
+
+    flat_map_destroy(map);
+}
+
+static void test_remove_clear(void **state)
+{
+    FlatMap *map = flat_map_new(int_copy, int_compare, free, int_copy, free);
+
+    for (int i = 0; i < 10; i++)
+    {
+        flat_map_put(map, &i, &i);
+    }
+    for (int i = 0; i < 10; i += 2)
+    {
+        assert_true(flat_map_remove(map, &i));
+        assert_false(flat_map_remove(map, &i));
+    }
+    assert_int_equal(5, flat_map_size(map));
+    for (int i = 0; i < 10; i++)
+    {
+        assert_int_equal(i % 2 == 1, flat_map_contains(map, &i));
+    }
+
+    int key = 42;
+    flat_map_put(map, &key, &key);
+    flat_map_clear(map);
+    assert_int_equal(0, flat_map_size(map));
+    assert_false(flat_map_contains(map, &key));
+
+    flat_map_destroy(map);
+}
+
+static void test_against_rbtree(void **state)
+{
+    FlatMap *map = flat_map_new(int_copy, int_compare, free, int_copy, free);
+    RBTree *tree = rbtree_new(int_copy, int_compare, free, int_copy, NULL, free);
+
+    srand(7);
+    for (int round = 0; round < 20; round++)
+    {
+        for (int i = 0; i < 500; i++)
+        {
+            int key = rand() % 2000;
+            int value = rand();
+            flat_map_put(map, &key, &value);
+            rbtree_put(tree, &key, &value);
+        }
+        for (int i = 0; i < 50; i++)
+        {
+            int key = rand() % 2000;
+            assert_int_equal(rbtree_remove(tree, &key), flat_map_remove(map, &key));
+        }
+
+        assert_int_equal(rbtree_size(tree), flat_map_size(map));
+        size_t index = 0;
+        for (RBNode *node = rbtree_first(tree); node; node = rbtree_next(tree, node), index++)
+        {
+            assert_int_equal(*(int *)rbtree_node_key(node), *(int *)flat_map_key_at(map, index));
+            assert_int_equal(*(int *)rbtree_node_value(node), *(int *)flat_map_value_at(map, index));
+        }
+    }
+
+    rbtree_destroy(tree);
+    flat_map_destroy(map);
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_put_get),
+        unit_test(test_remove_clear),
+        unit_test(test_against_rbtree)
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,48 @@
+#include "flat-set.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+#include <string.h>
+
+static int string_compare(const void *a, const void *b)
+{
+    return strcmp(a, b);
+}
+
+static void test_flat_set(void **state)
+{
+    char *words[] = { "delta", "alpha", "gamma", "beta", "alpha", "epsilon" };
+
+    FlatSet *s = flat_set_new(NULL, string_compare, NULL);
+    for (int i = 0; i < 6; i++)
+    {
+        flat_set_add(s, words[i]);
+    }
+
+    assert_int_equal(5, flat_set_size(s));
+    assert_true(flat_set_contains(s, "gamma"));
+    assert_false(flat_set_contains(s, "zeta"));
+    assert_string_equal("alpha", flat_set_at(s, 0));
+    assert_string_equal("gamma", flat_set_at(s, 4));
+
+    assert_true(flat_set_remove(s, "beta"));
+    assert_false(flat_set_contains(s, "beta"));
+    assert_string_equal("delta", flat_set_at(s, 1));
+
+    flat_set_clear(s);
+    assert_int_equal(0, flat_set_size(s));
+
+    flat_set_destroy(s);
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_flat_set)
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,162 @@
+#include "frozen-map.h"
+
+#include "alloc.h"
+#include "rb-tree.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+#include <stdlib.h>
+
+static void *int_copy(const void *_a)
+{
+    return xmemdup(_a, sizeof(int));
+}
+
+static int int_compare(const void *_a, const void *_b)
+{
+    const int *a = _a, *b = _b;
+    return *a - *b;
+}
+
+static RBTree *int_tree_new(void)
+{
+    return rbtree_new(int_copy, int_compare, free, int_copy, int_compare, free);
+}
+
+static void test_freeze_empty(void **state)
+{
+    RBTree *t = int_tree_new();
+    FrozenMap *m = rbtree_freeze(t);
+    rbtree_destroy(t);
+
+    assert_int_equal(0, frozen_map_size(m));
+
+    int a = 1;
+    assert_true(frozen_map_get(m, &a) == NULL);
+
+    FrozenMapIterator *it = frozen_map_iterator_new(m);
+    assert_false(frozen_map_iterator_next(it, NULL, NULL));
+    frozen_map_iterator_destroy(it);
+
+    frozen_map_destroy(m);
+}
+
+static void test_freeze_get(void **state)
+{
+    for (int n = 1; n < 70; n++)
+    {
+        RBTree *t = int_tree_new();
+        for (int i = 0; i < n; i++)
+        {
+            int k = i * 2;
+            rbtree_put(t, &k, &i);
+        }
+
+        FrozenMap *m = rbtree_freeze(t);
+        rbtree_destroy(t);
+
+        assert_int_equal(n, frozen_map_size(m));
+        for (int k = -1; k < 2 * n; k++)
+        {
+            int *v = frozen_map_get(m, &k);
+            if (k >= 0 && k % 2 == 0)
+            {
+                assert_int_equal(k / 2, *v);
+                assert_true(frozen_map_contains(m, &k));
+            }
+            else
+            {
+                assert_true(v == NULL);
+                assert_false(frozen_map_contains(m, &k));
+            }
+        }
+
+        frozen_map_destroy(m);
+    }
+}
+
+static void test_iterate(void **state)
+{
+    RBTree *t = int_tree_new();
+    srand(0);
+    for (int i = 0; i < 1000; i++)
+    {
+        int k = rand() % 5000;
+        rbtree_put(t, &k, &k);
+    }
+
+    FrozenMap *m = rbtree_freeze(t);
+
+    RBTreeIterator *expected = rbtree_iterator_new(t);
+    FrozenMapIterator *it = frozen_map_iterator_new(m);
+    void *k1, *k2, *v2;
+    while (rbtree_iterator_next(expected, &k1, NULL))
+    {
+        assert_true(frozen_map_iterator_next(it, &k2, &v2));
+        assert_int_equal(*(int *)k1, *(int *)k2);
+        assert_int_equal(*(int *)k1, *(int *)v2);
+    }
+    assert_false(frozen_map_iterator_next(it, NULL, NULL));
+
+    frozen_map_iterator_destroy(it);
+    rbtree_iterator_destroy(expected);
+    rbtree_destroy(t);
+    frozen_map_destroy(m);
+}
+
+static void test_range(void **state)
+{
+    RBTree *t = int_tree_new();
+    for (int i = 0; i < 100; i += 10)
+    {
+        rbtree_put(t, &i, &i);
+    }
+    FrozenMap *m = rbtree_freeze(t);
+    rbtree_destroy(t);
+
+    int from = 15, to = 60;
+    FrozenMapIterator *it = frozen_map_iterator_new_range(m, &from, &to);
+    void *k;
+    int expected = 20;
+    while (frozen_map_iterator_next(it, &k, NULL))
+    {
+        assert_int_equal(expected, *(int *)k);
+        expected += 10;
+    }
+    assert_int_equal(60, expected);
+    frozen_map_iterator_destroy(it);
+
+    from = 90;
+    it = frozen_map_iterator_new_range(m, &from, NULL);
+    assert_true(frozen_map_iterator_next(it, &k, NULL));
+    assert_int_equal(90, *(int *)k);
+    assert_false(frozen_map_iterator_next(it, &k, NULL));
+    frozen_map_iterator_destroy(it);
+
+    from = 91;
+    it = frozen_map_iterator_new_range(m, &from, NULL);
+    assert_false(frozen_map_iterator_next(it, &k, NULL));
+    frozen_map_iterator_destroy(it);
+
+    from = 50; to = 50;
+    it = frozen_map_iterator_new_range(m, &from, &to);
+    assert_false(frozen_map_iterator_next(it, &k, NULL));
+    frozen_map_iterator_destroy(it);
+
+    frozen_map_destroy(m);
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_freeze_empty),
+        unit_test(test_freeze_get),
+        unit_test(test_iterate),
+        unit_test(test_range)
+    };
+
+    return run_tests(tests);
+}
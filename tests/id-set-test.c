@@ -0,0 +1,204 @@
+#include "id-set.h"
+
+#include "seq.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static int compare_ids(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Fills ids with length distinct sorted IDs below limit
+static void random_ids(uint32_t *ids, size_t length, uint32_t limit)
+{
+    size_t n = 0;
+    while (n < length)
+    {
+        for (; n < length; n++)
+        {
+            ids[n] = (((uint32_t)rand() << 16) ^ (uint32_t)rand()) % limit;
+        }
+        qsort(ids, length, sizeof(uint32_t), compare_ids);
+
+        size_t unique = 0;
+        for (size_t i = 0; i < length; i++)
+        {
+            if (unique == 0 || ids[unique - 1] != ids[i])
+            {
+                ids[unique++] = ids[i];
+            }
+        }
+        n = unique;
+    }
+}
+
+static size_t naive_intersect(const uint32_t *a, size_t a_length,
+                              const uint32_t *b, size_t b_length, uint32_t *out)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < a_length; i++)
+    {
+        if (bsearch(&a[i], b, b_length, sizeof(uint32_t), compare_ids))
+        {
+            out[n++] = a[i];
+        }
+    }
+    return n;
+}
+
+static void test_intersect(void **state)
+{
+    const size_t sizes[][2] =
+    {
+        { 0, 0 }, { 0, 10 }, { 1, 1 }, { 3, 5 }, { 7, 9 }, { 100, 100 },
+        { 1000, 1003 }, { 37, 5000 }, { 5000, 37 }, { 10, 100000 }, { 20000, 30000 }
+    };
+
+    srand(1);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        for (uint32_t limit = 64; limit <= 1u << 20; limit *= 32)
+        {
+            size_t a_length = sizes[s][0] < limit ? sizes[s][0] : limit / 2;
+            size_t b_length = sizes[s][1] < limit ? sizes[s][1] : limit / 2;
+            uint32_t *a = malloc(sizeof(uint32_t) * (a_length + 1));
+            uint32_t *b = malloc(sizeof(uint32_t) * (b_length + 1));
+            uint32_t *expected = malloc(sizeof(uint32_t) * (a_length + 1));
+            uint32_t *actual = malloc(sizeof(uint32_t) * (a_length + 1));
+
+            random_ids(a, a_length, limit);
+            random_ids(b, b_length, limit);
+
+            size_t n = naive_intersect(a, a_length, b, b_length, expected);
+            size_t m = a_length < b_length ? a_length : b_length;
+            assert_int_equal(n, id_set_intersect(a, a_length, b, b_length, actual));
+            assert_memory_equal(expected, actual, sizeof(uint32_t) * n);
+            assert_int_equal(n, id_set_intersect(b, b_length, a, a_length, actual));
+            assert_memory_equal(expected, actual, sizeof(uint32_t) * n);
+            assert_true(n <= m);
+
+            free(a);
+            free(b);
+            free(expected);
+            free(actual);
+        }
+    }
+}
+
+static void test_intersect_extremes(void **state)
+{
+    uint32_t a[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, UINT32_MAX - 1, UINT32_MAX };
+    uint32_t b[] = { 0, 2, 4, 6, 8, 10, 12, 14, 16, UINT32_MAX };
+    uint32_t expected[] = { 0, 2, 4, 6, 8, UINT32_MAX };
+    uint32_t out[10];
+
+    assert_int_equal(6, id_set_intersect(a, 11, b, 10, out));
+    assert_memory_equal(expected, out, sizeof(expected));
+
+    // identical inputs match every block in full
+    assert_int_equal(10, id_set_intersect(b, 10, b, 10, out));
+    assert_memory_equal(b, out, sizeof(b));
+}
+
+static void test_union(void **state)
+{
+    srand(2);
+    for (size_t count = 0; count <= 9; count++)
+    {
+        uint32_t *sets[9];
+        size_t lengths[9];
+        size_t total = 0;
+
+        for (size_t s = 0; s < count; s++)
+        {
+            lengths[s] = s % 4 == 3 ? 0 : (size_t)(rand() % 2000);
+            sets[s] = malloc(sizeof(uint32_t) * (lengths[s] + 1));
+            random_ids(sets[s], lengths[s], 10000);
+            total += lengths[s];
+        }
+
+        uint32_t *expected = malloc(sizeof(uint32_t) * (total + 1));
+        size_t n = 0;
+        for (size_t s = 0; s < count; s++)
+        {
+            memcpy(expected + n, sets[s], sizeof(uint32_t) * lengths[s]);
+            n += lengths[s];
+        }
+        qsort(expected, n, sizeof(uint32_t), compare_ids);
+        size_t unique = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            if (unique == 0 || expected[unique - 1] != expected[i])
+            {
+                expected[unique++] = expected[i];
+            }
+        }
+
+        uint32_t *actual = malloc(sizeof(uint32_t) * (total + 1));
+        assert_int_equal(unique, id_set_union((const uint32_t *const *)sets, lengths, count, actual));
+        assert_memory_equal(expected, actual, sizeof(uint32_t) * unique);
+
+        for (size_t s = 0; s < count; s++)
+        {
+            free(sets[s]);
+        }
+        free(expected);
+        free(actual);
+    }
+}
+
+static void test_seqs(void **state)
+{
+    Seq *a = seq_new_sized(sizeof(uint32_t), 0, NULL);
+    Seq *b = seq_new_sized(sizeof(uint32_t), 0, NULL);
+    Seq *c = seq_new_sized(sizeof(uint32_t), 0, NULL);
+    Seq *out = seq_new_sized(sizeof(uint32_t), 0, NULL);
+
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        seq_append(a, &(uint32_t){ i * 2 });
+        seq_append(b, &(uint32_t){ i * 3 });
+        seq_append(c, &(uint32_t){ UINT32_MAX - 999 + i });
+    }
+
+    id_set_intersect_seq(out, a, b);
+    assert_int_equal(334, seq_length(out));
+    for (size_t i = 0; i < seq_length(out); i++)
+    {
+        assert_int_equal(i * 6, *(uint32_t *)seq_at(out, i));
+    }
+
+    seq_clear(out);
+    const Seq *inputs[] = { a, b, c };
+    id_set_union_seq(out, inputs, 3);
+    assert_int_equal(1000 + 1000 - 334 + 1000, seq_length(out));
+    assert_int_equal(0, *(uint32_t *)seq_at(out, 0));
+    assert_true(*(uint32_t *)seq_at(out, seq_length(out) - 1) == UINT32_MAX);
+
+    seq_destroy(a);
+    seq_destroy(b);
+    seq_destroy(c);
+    seq_destroy(out);
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_intersect),
+        unit_test(test_intersect_extremes),
+        unit_test(test_union),
+        unit_test(test_seqs)
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,221 @@
+#include "intern.h"
+
+#include "rb-tree.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int sign(int x)
+{
+    return (x > 0) - (x < 0);
+}
+
+static void test_canonical(void **state)
+{
+    InternPool *pool = intern_pool_new(false);
+    char buffer[] = "hello";
+
+    const char *a = intern_string(pool, "hello");
+    const char *b = intern_string(pool, buffer);
+    const char *c = intern_bytes(pool, "hello world", 5);
+    const char *d = intern_string(pool, "help");
+
+    assert_true(a == b);
+    assert_true(a == c);
+    assert_true(a != d);
+    assert_true(a != buffer);
+    assert_string_equal("hello", a);
+    assert_int_equal(5, intern_length(a));
+    assert_true(intern_hash(a) != intern_hash(d));
+    assert_int_equal(2, intern_pool_size(pool));
+
+    // bytes with a NUL inside are a string of their own
+    const char *e = intern_bytes(pool, "hel\0lo", 6);
+    assert_true(e != a);
+    assert_int_equal(6, intern_length(e));
+
+    const char *empty = intern_string(pool, "");
+    assert_int_equal(0, intern_length(empty));
+    assert_true(empty == intern_bytes(pool, "x", 0));
+
+    intern_pool_destroy(pool);
+}
+
+static void test_order(void **state)
+{
+    InternPool *pool = intern_pool_new(false);
+    const char *words[] =
+    {
+        "", "a", "ab", "abc", "abcdefgh", "abcdefghi", "abcdefgha", "abcdefghij",
+        "abcdefgz", "b", "\xff", "\x7f", "zzzzzzzzzzzzzzzz", "zzzzzzzzzzzzzzzy"
+    };
+    size_t count = sizeof(words) / sizeof(words[0]);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        for (size_t j = 0; j < count; j++)
+        {
+            const char *a = intern_string(pool, words[i]);
+            const char *b = intern_string(pool, words[j]);
+            assert_int_equal(sign(strcmp(words[i], words[j])), sign(intern_compare(a, b)));
+        }
+    }
+
+    srand(1);
+    for (int round = 0; round < 10000; round++)
+    {
+        char x[24], y[24];
+        size_t x_length = rand() % 20, y_length = rand() % 20;
+        for (size_t i = 0; i < x_length; i++)
+        {
+            x[i] = 'a' + rand() % 3;
+        }
+        for (size_t i = 0; i < y_length; i++)
+        {
+            y[i] = i < x_length && rand() % 4 ? x[i] : 'a' + rand() % 3;
+        }
+        x[x_length] = y[y_length] = '\0';
+
+        assert_int_equal(sign(strcmp(x, y)),
+                         sign(intern_compare(intern_string(pool, x), intern_string(pool, y))));
+    }
+
+    intern_pool_destroy(pool);
+}
+
+static void test_rbtree(void **state)
+{
+    InternPool *pool = intern_pool_new(false);
+    RBTree *tree = rbtree_new(NULL, intern_compare, NULL, NULL, NULL, NULL);
+    char key[32];
+
+    for (int i = 0; i < 1000; i++)
+    {
+        snprintf(key, sizeof(key), "common-prefix-%04d", (i * 7) % 1000);
+        rbtree_put(tree, intern_string(pool, key), NULL);
+    }
+    assert_int_equal(1000, rbtree_size(tree));
+
+    snprintf(key, sizeof(key), "common-prefix-%04d", 123);
+    const char *handle = intern_string(pool, key);
+    assert_true(rbtree_get(tree, handle) == NULL);
+    assert_true(rbtree_remove(tree, handle));
+
+    RBTreeIterator *iter = rbtree_iterator_new(tree);
+    void *k;
+    const char *previous = NULL;
+    while (rbtree_iterator_next(iter, &k, NULL))
+    {
+        assert_true(previous == NULL || strcmp(previous, k) < 0);
+        previous = k;
+    }
+    rbtree_iterator_destroy(iter);
+
+    rbtree_destroy(tree);
+    intern_pool_destroy(pool);
+}
+
+static void test_refcount(void **state)
+{
+    InternPool *pool = intern_pool_new(true);
+
+    const char *a = intern_string(pool, "shared");
+    const char *b = intern_string(pool, "shared");
+    intern_string(pool, "other");
+    assert_true(a == b);
+    assert_int_equal(2, intern_pool_size(pool));
+
+    intern_release(pool, a);
+    assert_int_equal(2, intern_pool_size(pool));
+    intern_release(pool, b);
+    assert_int_equal(1, intern_pool_size(pool));
+
+    // many strings so that buckets split, then release them all
+    const char *handles[5000];
+    char key[16];
+    for (int i = 0; i < 5000; i++)
+    {
+        snprintf(key, sizeof(key), "k%d", i);
+        handles[i] = intern_string(pool, key);
+    }
+    assert_int_equal(5001, intern_pool_size(pool));
+    for (int i = 0; i < 5000; i++)
+    {
+        intern_release(pool, handles[i]);
+    }
+    assert_int_equal(1, intern_pool_size(pool));
+
+    intern_pool_destroy(pool);
+}
+
+#define THREADS 4
+#define STRINGS 20000
+
+typedef struct
+{
+    InternPool *pool;
+    const char **handles;
+} Job;
+
+static void *intern_all(void *arg)
+{
+    Job *job = arg;
+    char key[16];
+    for (int i = 0; i < STRINGS; i++)
+    {
+        snprintf(key, sizeof(key), "s%d", i);
+        job->handles[i] = intern_string(job->pool, key);
+    }
+    return NULL;
+}
+
+static void test_threads(void **state)
+{
+    InternPool *pool = intern_pool_new(false);
+    pthread_t threads[THREADS];
+    Job jobs[THREADS];
+
+    for (int t = 0; t < THREADS; t++)
+    {
+        jobs[t].pool = pool;
+        jobs[t].handles = malloc(sizeof(const char *) * STRINGS);
+        pthread_create(&threads[t], NULL, intern_all, &jobs[t]);
+    }
+    for (int t = 0; t < THREADS; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+
+    assert_int_equal(STRINGS, intern_pool_size(pool));
+    for (int t = 1; t < THREADS; t++)
+    {
+        assert_memory_equal(jobs[0].handles, jobs[t].handles, sizeof(const char *) * STRINGS);
+    }
+    for (int t = 0; t < THREADS; t++)
+    {
+        free(jobs[t].handles);
+    }
+
+    intern_pool_destroy(pool);
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_canonical),
+        unit_test(test_order),
+        unit_test(test_rbtree),
+        unit_test(test_refcount),
+        unit_test(test_threads)
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,229 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "lsm-map.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+
+static char dir[64];
+
+static void remove_dir(void)
+{
+    DIR *d = opendir(dir);
+    if (!d)
+    {
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(d)))
+    {
+        char path[512];
+        if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, ".."))
+        {
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(d);
+    rmdir(dir);
+}
+
+static void put_number(LSMMap *map, int i, int value)
+{
+    char key[16];
+    snprintf(key, sizeof(key), "k%08d", i);
+    assert_true(lsm_map_put(map, key, strlen(key), &value, sizeof(value)));
+}
+
+static void remove_number(LSMMap *map, int i)
+{
+    char key[16];
+    snprintf(key, sizeof(key), "k%08d", i);
+    assert_true(lsm_map_remove(map, key, strlen(key)));
+}
+
+// values in runs are not aligned, so copy them out
+static const int *get_number(LSMMap *map, int i)
+{
+    static int value;
+    char key[16];
+    size_t size = 0;
+    snprintf(key, sizeof(key), "k%08d", i);
+    const void *v = lsm_map_get(map, key, strlen(key), &size);
+    if (!v)
+    {
+        return NULL;
+    }
+
+    assert_int_equal(sizeof(int), size);
+    memcpy(&value, v, sizeof(value));
+    return &value;
+}
+
+static void test_put_get_remove(void **state)
+{
+    LSMMap *map = lsm_map_open(dir, 4096);
+    assert_true(map != NULL);
+
+    for (int i = 0; i < 20000; i++)
+    {
+        put_number(map, (i * 7919) % 20000, i);
+        assert_true(lsm_map_run_count(map) <= 9);
+    }
+    assert_true(lsm_map_run_count(map) > 1);
+
+    for (int i = 0; i < 20000; i += 3)
+    {
+        remove_number(map, i);
+    }
+    for (int i = 0; i < 20000; i += 6)
+    {
+        put_number(map, i, -i);
+    }
+
+    for (int i = 0; i < 20000; i++)
+    {
+        const int *v = get_number(map, i);
+        if (i % 6 == 0)
+        {
+            assert_int_equal(-i, *v);
+        }
+        else if (i % 3 == 0)
+        {
+            assert_true(v == NULL);
+        }
+        else
+        {
+            assert_true(v != NULL);
+        }
+    }
+
+    assert_true(lsm_map_close(map));
+    remove_dir();
+}
+
+static void test_reopen(void **state)
+{
+    LSMMap *map = lsm_map_open(dir, 1024);
+    for (int i = 0; i < 1000; i++)
+    {
+        put_number(map, i, i);
+    }
+    remove_number(map, 10);
+    assert_true(lsm_map_close(map));
+
+    map = lsm_map_open(dir, 1024);
+    assert_true(map != NULL);
+    for (int i = 0; i < 1000; i++)
+    {
+        const int *v = get_number(map, i);
+        if (i == 10)
+        {
+            assert_true(v == NULL);
+        }
+        else
+        {
+            assert_int_equal(i, *v);
+        }
+    }
+    assert_true(lsm_map_close(map));
+
+    // a run whose write was cut short is dropped on open
+    char path[512];
+    snprintf(path, sizeof(path), "%s/run-%016x-%016x.map.tmp", dir, 99, 99);
+    FILE *out = fopen(path, "wb");
+    fputs("partial", out);
+    fclose(out);
+
+    map = lsm_map_open(dir, 1024);
+    assert_true(map != NULL);
+    assert_true(access(path, F_OK) != 0);
+    assert_int_equal(0, *get_number(map, 0));
+    assert_true(lsm_map_close(map));
+    remove_dir();
+}
+
+static void test_iterate(void **state)
+{
+    LSMMap *map = lsm_map_open(dir, 2048);
+    for (int i = 999; i >= 0; i--)
+    {
+        put_number(map, i, i);
+    }
+    for (int i = 0; i < 1000; i += 2)
+    {
+        remove_number(map, i);
+    }
+    put_number(map, 500, 1);
+
+    LSMMapIterator *it = lsm_map_iterator_new(map);
+    const void *key, *value;
+    size_t key_size, value_size;
+    int expected = 1, n = 0;
+    while (lsm_map_iterator_next(it, &key, &key_size, &value, &value_size))
+    {
+        char k[16];
+        snprintf(k, sizeof(k), "k%08d", expected);
+        assert_int_equal(strlen(k), key_size);
+        assert_memory_equal(k, key, key_size);
+        assert_int_equal(sizeof(int), value_size);
+        n++;
+
+        expected += (expected == 499) ? 1 : (expected == 500) ? 1 : 2;
+    }
+    lsm_map_iterator_destroy(it);
+    assert_int_equal(501, n);
+
+    assert_true(lsm_map_close(map));
+    remove_dir();
+}
+
+static void test_compact(void **state)
+{
+    LSMMap *map = lsm_map_open(dir, 512);
+    for (int i = 0; i < 500; i++)
+    {
+        put_number(map, i, i);
+    }
+    assert_true(lsm_map_compact(map));
+    assert_int_equal(1, lsm_map_run_count(map));
+
+    for (int i = 0; i < 500; i++)
+    {
+        assert_int_equal(i, *get_number(map, i));
+    }
+
+    for (int i = 0; i < 500; i++)
+    {
+        remove_number(map, i);
+    }
+    assert_true(lsm_map_compact(map));
+    assert_int_equal(0, lsm_map_run_count(map));
+    assert_true(get_number(map, 1) == NULL);
+
+    assert_true(lsm_map_close(map));
+    remove_dir();
+}
+
+int main()
+{
+    snprintf(dir, sizeof(dir), "/tmp/lsm-map-test.%ld", (long)getpid());
+
+    const UnitTest tests[] =
+    {
+        unit_test(test_put_get_remove),
+        unit_test(test_reopen),
+        unit_test(test_iterate),
+        unit_test(test_compact)
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,208 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "map-file.h"
+
+#include "alloc.h"
+#include "rb-tree.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char path[64];
+
+static int string_compare(const void *a, const void *b)
+{
+    return strcmp(a, b);
+}
+
+static void *string_copy(const void *s)
+{
+    return xmemdup(s, strlen(s) + 1);
+}
+
+static void string_bytes(const void *s, const void **data, size_t *size)
+{
+    *data = s;
+    *size = strlen(s);
+}
+
+static RBTree *numbers_tree_new(int count)
+{
+    RBTree *t = rbtree_new(string_copy, string_compare, free, string_copy, string_compare, free);
+    for (int i = 0; i < count; i++)
+    {
+        char key[16], value[16];
+        snprintf(key, sizeof(key), "key%06d", i * 2);
+        snprintf(value, sizeof(value), "%d", i);
+        rbtree_put(t, key, value);
+    }
+    return t;
+}
+
+static void test_write_empty(void **state)
+{
+    RBTree *t = numbers_tree_new(0);
+    assert_true(map_file_write(path, t, string_bytes, string_bytes));
+    rbtree_destroy(t);
+
+    MapFile *f = map_file_open(path);
+    assert_true(f != NULL);
+    assert_true(map_file_verify(f));
+    assert_int_equal(0, map_file_size(f));
+    assert_true(map_file_get(f, "a", 1, NULL) == NULL);
+
+    MapFileIterator *it = map_file_iterator_new(f);
+    assert_false(map_file_iterator_next(it, NULL, NULL, NULL, NULL));
+    map_file_iterator_destroy(it);
+
+    map_file_close(f);
+    unlink(path);
+}
+
+static void test_get(void **state)
+{
+    RBTree *t = numbers_tree_new(5000);
+    assert_true(map_file_write(path, t, string_bytes, string_bytes));
+    rbtree_destroy(t);
+
+    MapFile *f = map_file_open(path);
+    assert_true(f != NULL);
+    assert_true(map_file_verify(f));
+    assert_int_equal(5000, map_file_size(f));
+
+    for (int i = 0; i < 10000; i++)
+    {
+        char key[16], value[16];
+        snprintf(key, sizeof(key), "key%06d", i);
+        size_t value_size = 0;
+        const char *v = map_file_get(f, key, strlen(key), &value_size);
+        if (i % 2 == 0)
+        {
+            snprintf(value, sizeof(value), "%d", i / 2);
+            assert_true(v != NULL);
+            assert_int_equal(strlen(value), value_size);
+            assert_memory_equal(value, v, value_size);
+        }
+        else
+        {
+            assert_true(v == NULL);
+        }
+    }
+
+    assert_true(map_file_get(f, "a", 1, NULL) == NULL);
+    assert_true(map_file_get(f, "z", 1, NULL) == NULL);
+
+    map_file_close(f);
+    unlink(path);
+}
+
+static void test_iterate_range(void **state)
+{
+    RBTree *t = numbers_tree_new(3000);
+    assert_true(map_file_write(path, t, string_bytes, string_bytes));
+    rbtree_destroy(t);
+
+    MapFile *f = map_file_open(path);
+
+    MapFileIterator *it = map_file_iterator_new(f);
+    const void *k;
+    size_t ks;
+    int n = 0;
+    while (map_file_iterator_next(it, &k, &ks, NULL, NULL))
+    {
+        char key[16];
+        snprintf(key, sizeof(key), "key%06d", n * 2);
+        assert_memory_equal(key, k, ks);
+        n++;
+    }
+    map_file_iterator_destroy(it);
+    assert_int_equal(3000, n);
+
+    it = map_file_iterator_new_range(f, "key000101", 9, "key004000", 9);
+    n = 51;
+    while (map_file_iterator_next(it, &k, &ks, NULL, NULL))
+    {
+        char key[16];
+        snprintf(key, sizeof(key), "key%06d", n * 2);
+        assert_memory_equal(key, k, ks);
+        n++;
+    }
+    map_file_iterator_destroy(it);
+    assert_int_equal(2000, n);
+
+    it = map_file_iterator_new_range(f, "key9", 4, NULL, 0);
+    assert_false(map_file_iterator_next(it, &k, &ks, NULL, NULL));
+    map_file_iterator_destroy(it);
+
+    map_file_close(f);
+    unlink(path);
+}
+
+static void test_corrupt(void **state)
+{
+    RBTree *t = numbers_tree_new(100);
+    assert_true(map_file_write(path, t, string_bytes, string_bytes));
+    rbtree_destroy(t);
+
+    FILE *out = fopen(path, "r+b");
+    fseek(out, 20, SEEK_SET);
+    fputc('X', out);
+    fclose(out);
+
+    MapFile *f = map_file_open(path);
+    assert_true(f != NULL);
+    assert_false(map_file_verify(f));
+    map_file_close(f);
+
+    out = fopen(path, "wb");
+    fputs("not a map file, not a map file, not a map file, not a map file, not a map file", out);
+    fclose(out);
+    assert_true(map_file_open(path) == NULL);
+
+    unlink(path);
+    assert_true(map_file_open(path) == NULL);
+}
+
+static int reverse_compare(const void *a, const void *b)
+{
+    return strcmp(b, a);
+}
+
+static void test_key_order(void **state)
+{
+    MapFileWriter *writer = map_file_writer_new(path);
+    assert_true(map_file_writer_add(writer, "b", 1, "", 0));
+    assert_false(map_file_writer_add(writer, "a", 1, "", 0));
+    assert_false(map_file_writer_close(writer));
+    assert_true(map_file_open(path) == NULL);
+
+    // the tree order has to agree with the bytes
+    RBTree *t = rbtree_new(string_copy, reverse_compare, free, string_copy, string_compare, free);
+    rbtree_put(t, "a", "1");
+    rbtree_put(t, "b", "2");
+    assert_false(map_file_write(path, t, string_bytes, string_bytes));
+    assert_true(map_file_open(path) == NULL);
+    rbtree_destroy(t);
+}
+
+int main()
+{
+    snprintf(path, sizeof(path), "/tmp/map-file-test.%ld", (long)getpid());
+
+    const UnitTest tests[] =
+    {
+        unit_test(test_write_empty),
+        unit_test(test_get),
+        unit_test(test_iterate_range),
+        unit_test(test_corrupt),
+        unit_test(test_key_order)
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,153 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "mapped-seq.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct
+{
+    uint64_t id;
+    double amount;
+    char tag[12];
+} Record;
+
+static char path[64];
+
+static Record make_record(size_t i)
+{
+    Record r = { i * 7, i / 4.0, "" };
+    snprintf(r.tag, sizeof(r.tag), "r%zu", i);
+    return r;
+}
+
+static void check_record(const Record *r, size_t i)
+{
+    Record expected = make_record(i);
+    assert_true(r->id == expected.id);
+    assert_true(r->amount == expected.amount);
+    assert_string_equal(expected.tag, r->tag);
+}
+
+static void test_reopen(void **state)
+{
+    const size_t count = 10000;
+
+    MappedSeq *seq = mapped_seq_open(path, sizeof(Record));
+    assert_true(seq != NULL);
+    assert_int_equal(0, mapped_seq_length(seq));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        Record r = make_record(i);
+        assert_true(mapped_seq_append(seq, &r));
+    }
+    assert_int_equal(count, mapped_seq_length(seq));
+    assert_true(mapped_seq_capacity(seq) >= count);
+    assert_true(mapped_seq_sync(seq));
+    mapped_seq_close(seq);
+
+    seq = mapped_seq_open(path, sizeof(Record));
+    assert_true(seq != NULL);
+    assert_int_equal(count, mapped_seq_length(seq));
+    for (size_t i = 0; i < count; i++)
+    {
+        check_record(mapped_seq_at(seq, i), i);
+    }
+
+    // unsynced appends still reach the file through the page cache
+    Record r = make_record(count);
+    assert_true(mapped_seq_append(seq, &r));
+    mapped_seq_close(seq);
+
+    seq = mapped_seq_open_readonly(path, sizeof(Record));
+    assert_int_equal(count + 1, mapped_seq_length(seq));
+    check_record(mapped_seq_at(seq, count), count);
+    mapped_seq_close(seq);
+
+    assert_true(mapped_seq_open(path, sizeof(Record) + 1) == NULL);
+
+    unlink(path);
+}
+
+static void test_concurrent_reader(void **state)
+{
+    MappedSeq *writer = mapped_seq_open(path, sizeof(uint32_t));
+    uint32_t value = 0;
+    assert_true(mapped_seq_append(writer, &value));
+
+    MappedSeq *reader = mapped_seq_open_readonly(path, sizeof(uint32_t));
+    assert_true(reader != NULL);
+    assert_int_equal(1, mapped_seq_length(reader));
+
+    // the writer grows the file; the reader only sees what it has mapped
+    for (value = 1; value < 5000; value++)
+    {
+        assert_true(mapped_seq_append(writer, &value));
+    }
+    assert_true(mapped_seq_length(reader) < 5000);
+
+    assert_true(mapped_seq_refresh(reader));
+    assert_int_equal(5000, mapped_seq_length(reader));
+    for (uint32_t i = 0; i < 5000; i++)
+    {
+        assert_int_equal(i, *(uint32_t *)mapped_seq_at(reader, i));
+    }
+
+    mapped_seq_close(reader);
+    mapped_seq_close(writer);
+    unlink(path);
+}
+
+static void test_reserve(void **state)
+{
+    MappedSeq *seq = mapped_seq_open(path, 3);
+
+    assert_true(mapped_seq_reserve(seq, 100000));
+    assert_true(mapped_seq_capacity(seq) >= 100000);
+    assert_int_equal(0, mapped_seq_length(seq));
+    assert_int_equal(3, mapped_seq_elem_size(seq));
+
+    assert_true(mapped_seq_append(seq, "abc"));
+    mapped_seq_close(seq);
+
+    seq = mapped_seq_open(path, 3);
+    assert_true(mapped_seq_capacity(seq) >= 100000);
+    assert_int_equal(1, mapped_seq_length(seq));
+    mapped_seq_close(seq);
+
+    unlink(path);
+}
+
+static void test_corrupt(void **state)
+{
+    FILE *out = fopen(path, "wb");
+    fputs("not a mapped seq, not a mapped seq, not a mapped seq, not a mapped seq", out);
+    fclose(out);
+    assert_true(mapped_seq_open(path, 4) == NULL);
+    assert_true(mapped_seq_open_readonly(path, 4) == NULL);
+
+    unlink(path);
+    assert_true(mapped_seq_open_readonly(path, 4) == NULL);
+}
+
+int main()
+{
+    snprintf(path, sizeof(path), "/tmp/mapped-seq-test.%ld", (long)getpid());
+
+    const UnitTest tests[] =
+    {
+        unit_test(test_reopen),
+        unit_test(test_concurrent_reader),
+        unit_test(test_reserve),
+        unit_test(test_corrupt)
+    };
+
+    return run_tests(tests);
+}
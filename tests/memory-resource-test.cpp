@@ -0,0 +1,189 @@
+#include "memory-resource.hpp"
+
+#include <cstdarg>
+#include <cstddef>
+#include <csetjmp>
+extern "C"
+{
+#include <cmockery.h>
+#include "rb-tree.h"
+#include "seq.h"
+}
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+class counting_resource : public std::pmr::memory_resource
+{
+public:
+    std::size_t outstanding = 0;
+    std::size_t allocations = 0;
+
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        outstanding += bytes;
+        allocations++;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override
+    {
+        outstanding -= bytes;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+static size_t libutils_allocations;
+
+static void *counting_allocate(void *context, size_t size)
+{
+    libutils_allocations++;
+    return malloc(size);
+}
+
+static void *counting_reallocate(void *context, void *ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void counting_deallocate(void *context, void *ptr)
+{
+    free(ptr);
+}
+
+static void *int_copy(const void *p)
+{
+    return xmemdup(p, sizeof(int));
+}
+
+static int int_compare(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+static void test_libutils_resource(void **state)
+{
+    Allocator counting = { counting_allocate, counting_reallocate, counting_deallocate, NULL };
+    alloc_set_allocator(&counting);
+    libutils_allocations = 0;
+
+    {
+        std::pmr::vector<std::pmr::string> v(lu::libutils_resource());
+        for (int i = 0; i < 100; i++)
+        {
+            v.emplace_back(std::to_string(i) + " long enough to leave the small string buffer");
+        }
+        assert_string_equal("42 long enough to leave the small string buffer", v[42].c_str());
+    }
+
+    alloc_set_allocator(NULL);
+    assert_true(libutils_allocations >= 100);
+    assert_true(lu::libutils_resource()->is_equal(*lu::libutils_resource()));
+    assert_false(lu::libutils_resource()->is_equal(*std::pmr::new_delete_resource()));
+}
+
+static void test_allocator_scope(void **state)
+{
+    counting_resource counting;
+
+    {
+        lu::allocator_scope scope(&counting);
+
+        RBTree *tree = rbtree_new(int_copy, int_compare, xfree, int_copy, int_compare, xfree);
+        Seq *seq = seq_new(2, xfree);
+        for (int i = 0; i < 1000; i++)
+        {
+            rbtree_put(tree, &i, &i);
+            seq_append(seq, xmemdup(&i, sizeof(int)));
+        }
+        for (int i = 0; i < 1000; i += 2)
+        {
+            rbtree_remove(tree, &i);
+        }
+        rbtree_compact(tree);
+
+        assert_true(counting.allocations >= 3000);
+        assert_int_equal(500, rbtree_size(tree));
+        assert_int_equal(999, *(int *)seq_at(seq, 999));
+
+        rbtree_destroy(tree);
+        seq_destroy(seq);
+    }
+    assert_int_equal(0, counting.outstanding);
+
+    size_t before = counting.allocations;
+    void *p = xmalloc(16);
+    xfree(p);
+    assert_int_equal(before, counting.allocations);
+}
+
+static void test_request_arena(void **state)
+{
+    static std::max_align_t buffer[4096];
+    std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+    lu::allocator_scope scope(&arena);
+
+    Seq *seq = seq_new(4, xfree);
+    std::pmr::vector<int> v(&arena);
+    for (int i = 0; i < 64; i++)
+    {
+        seq_append(seq, xmemdup(&i, sizeof(int)));
+        v.push_back(i);
+    }
+
+    uintptr_t lo = (uintptr_t)buffer;
+    uintptr_t hi = lo + sizeof(buffer);
+    assert_true((uintptr_t)seq_at(seq, 63) >= lo && (uintptr_t)seq_at(seq, 63) < hi);
+    assert_true((uintptr_t)v.data() >= lo && (uintptr_t)v.data() < hi);
+    assert_int_equal(63, *(int *)seq_at(seq, 63));
+
+    // No destroy calls: the whole request goes away with the arena
+}
+
+static void test_container_outlives_scope(void **state)
+{
+    counting_resource counting;
+    Seq *outer = seq_new_sized(sizeof(int), 0, NULL);
+    Seq *inner;
+
+    {
+        lu::allocator_scope scope(&counting);
+        inner = seq_new_sized(sizeof(int), 0, NULL);
+        for (int i = 0; i < 1000; i++)
+        {
+            seq_append(outer, &i);
+        }
+    }
+    // the outer Seq grew through malloc while the scope was active
+    assert_int_equal(1, counting.allocations);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        seq_append(inner, &i);
+    }
+    seq_destroy(outer);
+    seq_destroy(inner);
+    assert_int_equal(0, counting.outstanding);
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_libutils_resource),
+        unit_test(test_allocator_scope),
+        unit_test(test_request_arena),
+        unit_test(test_container_outlives_scope)
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,140 @@
+#include "packed-seq.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+
+#include <stdlib.h>
+
+static uint64_t random_bits(unsigned int width)
+{
+    uint64_t value = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+    value ^= (uint64_t)rand() << 63;
+    return width == 64 ? value : value & ((UINT64_C(1) << width) - 1);
+}
+
+static void test_every_width(void **state)
+{
+    srand(1);
+    for (unsigned int width = 0; width <= 64; width++)
+    {
+        PackedSeq *seq = packed_seq_new();
+        uint64_t values[3 * 128 + 17];
+        size_t length = sizeof(values) / sizeof(values[0]);
+
+        for (size_t i = 0; i < length; i++)
+        {
+            values[i] = random_bits(width);
+            packed_seq_append(seq, values[i]);
+        }
+        assert_int_equal(length, packed_seq_length(seq));
+
+        for (size_t i = 0; i < length; i++)
+        {
+            assert_true(packed_seq_get(seq, i) == values[i]);
+        }
+
+        PackedSeqIterator *iter = packed_seq_iterator_new(seq, 0);
+        uint64_t value;
+        for (size_t i = 0; i < length; i++)
+        {
+            assert_true(packed_seq_iterator_next(iter, &value));
+            assert_true(value == values[i]);
+        }
+        assert_false(packed_seq_iterator_next(iter, &value));
+        packed_seq_iterator_destroy(iter);
+
+        packed_seq_destroy(seq);
+    }
+}
+
+static void test_sorted_ids(void **state)
+{
+    PackedSeq *seq = packed_seq_new();
+    const size_t length = 100000;
+    uint64_t id = UINT64_C(1) << 40;
+
+    srand(2);
+    for (size_t i = 0; i < length; i++)
+    {
+        id += 1 + rand() % 100;
+        packed_seq_append(seq, id);
+    }
+
+    // deltas below 128 pack into 7 bits each
+    assert_true(packed_seq_memory(seq) < length * 2);
+
+    for (size_t i = 1; i < length; i += 997)
+    {
+        uint64_t value = packed_seq_get(seq, i);
+        assert_int_equal(i, packed_seq_lower_bound(seq, value));
+        if (value - 1 > packed_seq_get(seq, i - 1))
+        {
+            assert_int_equal(i, packed_seq_lower_bound(seq, value - 1));
+        }
+        assert_int_equal(i + 1, packed_seq_lower_bound(seq, value + 1));
+    }
+    assert_int_equal(0, packed_seq_lower_bound(seq, 0));
+    assert_int_equal(length - 1, packed_seq_lower_bound(seq, id));
+    assert_int_equal(length, packed_seq_lower_bound(seq, id + 1));
+
+    packed_seq_destroy(seq);
+}
+
+static void test_iterator_start(void **state)
+{
+    PackedSeq *seq = packed_seq_new();
+    const size_t length = 1000;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        // alternate unsorted and sorted blocks
+        packed_seq_append(seq, (i / 128) % 2 ? i * 3 : (i * 7919) % 1000);
+    }
+
+    size_t starts[] = { 0, 1, 127, 128, 500, 895, 896, 999, 1000, 5000 };
+    for (size_t s = 0; s < sizeof(starts) / sizeof(starts[0]); s++)
+    {
+        PackedSeqIterator *iter = packed_seq_iterator_new(seq, starts[s]);
+        uint64_t value;
+        size_t i = starts[s];
+        while (packed_seq_iterator_next(iter, &value))
+        {
+            assert_true(value == packed_seq_get(seq, i));
+            i++;
+        }
+        assert_int_equal(starts[s] < length ? length : starts[s], i);
+        packed_seq_iterator_destroy(iter);
+    }
+
+    packed_seq_destroy(seq);
+}
+
+static void test_empty(void **state)
+{
+    PackedSeq *seq = packed_seq_new();
+    uint64_t value;
+
+    assert_int_equal(0, packed_seq_length(seq));
+    assert_int_equal(0, packed_seq_lower_bound(seq, 42));
+
+    PackedSeqIterator *iter = packed_seq_iterator_new(seq, 0);
+    assert_false(packed_seq_iterator_next(iter, &value));
+    packed_seq_iterator_destroy(iter);
+
+    packed_seq_destroy(seq);
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_every_width),
+        unit_test(test_sorted_ids),
+        unit_test(test_iterator_start),
+        unit_test(test_empty)
+    };
+
+    return run_tests(tests);
+}
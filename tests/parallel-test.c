@@ -0,0 +1,160 @@
+#include "parallel.h"
+
+#include "alloc.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+static void *int_copy(const void *p)
+{
+    return xmemdup(p, sizeof(int));
+}
+
+static int int_compare(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+static void square(void *item, size_t index, void *context)
+{
+    *(long *)item = (long)index * (long)index;
+}
+
+static void test_parallel_for(void **state)
+{
+    TaskPool *pool = task_pool_new(4);
+    Seq *seq = seq_new_sized(sizeof(long), 0, NULL);
+    long zero = 0;
+
+    for (int i = 0; i < 100000; i++)
+    {
+        seq_append(seq, &zero);
+    }
+
+    seq_parallel_for(pool, seq, 0, square, NULL);
+    for (size_t i = 0; i < seq_length(seq); i++)
+    {
+        assert_true(*(long *)seq_at(seq, i) == (long)(i * i));
+    }
+
+    Seq *empty = seq_new_sized(sizeof(long), 0, NULL);
+    seq_parallel_for(pool, empty, 16, square, NULL);
+    seq_destroy(empty);
+
+    seq_destroy(seq);
+    task_pool_destroy(pool);
+}
+
+// order-sensitive fold: remembers the first and last index and whether they stayed contiguous
+typedef struct
+{
+    long first;
+    long last;
+    long sum;
+    int contiguous;
+} Span;
+
+static void span_map(void *acc, const void *item, void *context)
+{
+    Span *span = acc;
+    long value = *(const long *)item;
+
+    if (span->first < 0)
+    {
+        span->first = value;
+    }
+    else if (value != span->last + 1)
+    {
+        span->contiguous = 0;
+    }
+    span->last = value;
+    span->sum += value;
+}
+
+static void span_combine(void *acc, const void *other, void *context)
+{
+    Span *a = acc;
+    const Span *b = other;
+
+    if (b->first < 0)
+    {
+        return;
+    }
+    if (a->first < 0)
+    {
+        *a = *b;
+        return;
+    }
+    a->contiguous = a->contiguous && b->contiguous && b->first == a->last + 1;
+    a->last = b->last;
+    a->sum += b->sum;
+}
+
+static void test_map_reduce(void **state)
+{
+    TaskPool *pool = task_pool_new(4);
+    Seq *seq = seq_new_sized(sizeof(long), 0, NULL);
+
+    for (long i = 0; i < 100000; i++)
+    {
+        seq_append(seq, &i);
+    }
+
+    Span identity = { -1, -1, 0, 1 };
+    size_t grains[] = { 0, 1, 7, 1000, 1000000 };
+    for (size_t g = 0; g < sizeof(grains) / sizeof(grains[0]); g++)
+    {
+        Span result;
+        seq_parallel_map_reduce(pool, seq, grains[g], span_map, span_combine,
+                                &identity, &result, sizeof(result), NULL);
+        assert_int_equal(0, result.first);
+        assert_int_equal(99999, result.last);
+        assert_true(result.sum == 99999L * 100000L / 2);
+        assert_true(result.contiguous);
+    }
+
+    seq_destroy(seq);
+    task_pool_destroy(pool);
+}
+
+static void tree_sum(void *key, void *value, void *context)
+{
+    __atomic_add_fetch((int64_t *)context, *(int *)value, __ATOMIC_RELAXED);
+}
+
+static void test_rbtree_parallel_for(void **state)
+{
+    TaskPool *pool = task_pool_new(3);
+    RBTree *tree = rbtree_new(int_copy, int_compare, free, int_copy, int_compare, free);
+    int64_t sum = 0;
+
+    rbtree_parallel_for(pool, tree, tree_sum, &sum);
+    assert_int_equal(0, sum);
+
+    for (int i = 1; i <= 50000; i++)
+    {
+        rbtree_put(tree, &i, &i);
+    }
+    rbtree_parallel_for(pool, tree, tree_sum, &sum);
+    assert_true(sum == 50000LL * 50001LL / 2);
+
+    rbtree_destroy(tree);
+    task_pool_destroy(pool);
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_parallel_for),
+        unit_test(test_map_reduce),
+        unit_test(test_rbtree_parallel_for)
+    };
+
+    return run_tests(tests);
+}
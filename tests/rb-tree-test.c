@@ -156,6 +156,262 @@ static void test_put_remove_random(void **state)
     rbtree_destroy(t);
 }
 
+static void test_compact(void **state)
+{
+    RBTree *t = int_tree_new();
+    srand(0);
+    for (int i = 0; i < 5000; i++)
+    {
+        int k = rand() % 10000;
+        rbtree_put(t, &k, &k);
+    }
+
+    for (int i = 0; i < 10000; i += 3)
+    {
+        rbtree_remove(t, &i);
+    }
+
+    unsigned int size = rbtree_size(t);
+    rbtree_compact(t);
+    assert_int_equal(size, rbtree_size(t));
+
+    RBTreeIterator *it = rbtree_iterator_new(t);
+    int last = -1;
+    void *_k = NULL, *_v = NULL;
+    unsigned int n = 0;
+    while (rbtree_iterator_next(it, &_k, &_v))
+    {
+        int *k = _k, *v = _v;
+        assert_true(*k > last);
+        assert_int_equal(*k, *v);
+        assert_true(*k % 3 != 0);
+        last = *k;
+        n++;
+    }
+    rbtree_iterator_destroy(it);
+    assert_int_equal(size, n);
+
+    for (int i = 0; i < 10000; i++)
+    {
+        int *r = rbtree_get(t, &i);
+        if (r)
+        {
+            assert_int_equal(i, *r);
+        }
+    }
+
+    for (int i = 0; i < 10000; i += 2)
+    {
+        rbtree_remove(t, &i);
+    }
+    for (int i = 0; i < 10000; i += 5)
+    {
+        rbtree_put(t, &i, &i);
+    }
+
+    rbtree_compact(t);
+
+    for (int i = 0; i < 10000; i += 5)
+    {
+        int *r = rbtree_get(t, &i);
+        assert_int_equal(i, *r);
+    }
+
+    rbtree_destroy(t);
+}
+
+static void test_compact_empty(void **state)
+{
+    RBTree *t = int_tree_new();
+    rbtree_compact(t);
+    assert_int_equal(0, rbtree_size(t));
+
+    int a = 1;
+    rbtree_put(t, &a, &a);
+    rbtree_compact(t);
+    rbtree_remove(t, &a);
+    rbtree_compact(t);
+    assert_int_equal(0, rbtree_size(t));
+
+    rbtree_destroy(t);
+}
+
+static void test_clear(void **state)
+{
+    RBTree *t = int_tree_new();
+    for (int i = 0; i < 100; i++)
+    {
+        rbtree_put(t, &i, &i);
+    }
+    rbtree_compact(t);
+
+    rbtree_clear(t);
+    assert_int_equal(0, rbtree_size(t));
+
+    int a = 7;
+    assert_true(rbtree_get(t, &a) == NULL);
+    assert_false(rbtree_put(t, &a, &a));
+    assert_int_equal(1, rbtree_size(t));
+
+    rbtree_destroy(t);
+}
+
+static void test_get_many(void **state)
+{
+    RBTree *t = int_tree_new();
+    for (int i = 0; i < 1000; i += 2)
+    {
+        rbtree_put(t, &i, &i);
+    }
+
+    int keys[300];
+    const void *key_ptrs[300];
+    void *values[300];
+    for (int i = 0; i < 300; i++)
+    {
+        keys[i] = i * 7 - 50;
+        key_ptrs[i] = &keys[i];
+    }
+
+    rbtree_get_many(t, key_ptrs, 300, values);
+
+    for (int i = 0; i < 300; i++)
+    {
+        assert_true(values[i] == rbtree_get(t, &keys[i]));
+        if (values[i])
+        {
+            assert_int_equal(keys[i], *(int *)values[i]);
+        }
+    }
+
+    rbtree_destroy(t);
+}
+
+static void test_cursor(void **state)
+{
+    RBTree *t = int_tree_new();
+    assert_true(rbtree_first(t) == NULL);
+    assert_true(rbtree_last(t) == NULL);
+
+    for (int i = 0; i < 1000; i += 3)
+    {
+        rbtree_put(t, &i, &i);
+    }
+
+    int expected = 0;
+    for (RBNode *n = rbtree_first(t); n; n = rbtree_next(t, n), expected += 3)
+    {
+        assert_int_equal(expected, *(int *)rbtree_node_key(n));
+        assert_int_equal(expected, *(int *)rbtree_node_value(n));
+    }
+    assert_int_equal(1002, expected);
+
+    for (RBNode *n = rbtree_last(t); n; n = rbtree_prev(t, n))
+    {
+        expected -= 3;
+        assert_int_equal(expected, *(int *)rbtree_node_key(n));
+    }
+    assert_int_equal(0, expected);
+
+    int k = 300, missing = 301;
+    assert_int_equal(300, *(int *)rbtree_node_key(rbtree_find(t, &k)));
+    assert_true(rbtree_find(t, &missing) == NULL);
+
+    rbtree_destroy(t);
+}
+
+static void test_split(void **state)
+{
+    RBTree *t = int_tree_new();
+    RBNode *starts[16];
+
+    assert_int_equal(0, rbtree_split(t, 16, starts));
+
+    for (int i = 0; i < 10000; i++)
+    {
+        rbtree_put(t, &i, &i);
+    }
+
+    size_t sizes[] = { 1, 2, 3, 7, 8, 16 };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        size_t parts = rbtree_split(t, sizes[s], starts);
+        assert_true(parts >= 1 && parts <= sizes[s]);
+        assert_true(starts[0] == rbtree_first(t));
+
+        // ranges cover every key once, in order, and none is much bigger than its share
+        int expected = 0;
+        for (size_t i = 0; i < parts; i++)
+        {
+            RBNode *end = i + 1 < parts ? starts[i + 1] : NULL;
+            int count = 0;
+            for (RBNode *n = starts[i]; n != end; n = rbtree_next(t, n), count++)
+            {
+                assert_int_equal(expected++, *(int *)rbtree_node_key(n));
+            }
+            assert_true(count > 0 && count < 4 * 10000 / (int)parts);
+        }
+        assert_int_equal(10000, expected);
+    }
+
+    rbtree_destroy(t);
+}
+
+static void test_insert(void **state)
+{
+    RBTree *t = int_tree_new();
+    bool inserted;
+
+    int a = 1, b = 2;
+    RBNode *n = rbtree_insert(t, &a, &a, 0, &inserted);
+    assert_true(inserted);
+    assert_true(n == rbtree_insert(t, &a, &b, 0, &inserted));
+    assert_false(inserted);
+    assert_int_equal(1, *(int *)rbtree_node_value(n));
+    rbtree_destroy(t);
+
+    // entries built in the node storage, next to plain nodes
+    t = rbtree_new(NULL, int_compare, NULL, NULL, NULL, NULL);
+    int keys[1000];
+    srand(1);
+    for (int i = 0; i < 1000; i++)
+    {
+        keys[i] = rand() % 500;
+        if (i % 3 == 0)
+        {
+            rbtree_insert(t, &keys[i], &keys[i], 0, &inserted);
+            continue;
+        }
+
+        int key = keys[i];
+        n = rbtree_insert(t, &key, NULL, sizeof(int), &inserted);
+        if (inserted)
+        {
+            int *data = rbtree_node_data(n);
+            *data = key;
+            rbtree_node_set(n, data, data);
+        }
+        assert_int_equal(key, *(int *)rbtree_node_key(n));
+    }
+
+    rbtree_compact(t);
+
+    size_t size = rbtree_size(t);
+    rbtree_remove_node(t, rbtree_first(t));
+    rbtree_remove_node(t, rbtree_last(t));
+    assert_int_equal(size - 2, rbtree_size(t));
+
+    int prev = -1;
+    for (n = rbtree_first(t); n; n = rbtree_next(t, n))
+    {
+        int key = *(int *)rbtree_node_key(n);
+        assert_true(key > prev);
+        assert_true(rbtree_find(t, &key) == n);
+        prev = key;
+    }
+
+    rbtree_destroy(t);
+}
 
 int main()
 {
@@ -166,7 +422,14 @@ int main()
         unit_test(test_put_remove),
         unit_test(test_put_remove_inorder),
         unit_test(test_iterate),
-        unit_test(test_put_remove_random)
+        unit_test(test_put_remove_random),
+        unit_test(test_compact),
+        unit_test(test_compact_empty),
+        unit_test(test_clear),
+        unit_test(test_get_many),
+        unit_test(test_cursor),
+        unit_test(test_split),
+        unit_test(test_insert)
     };
 
     return run_tests(tests);
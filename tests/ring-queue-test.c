@@ -0,0 +1,226 @@
+#include "ring-queue.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define TRANSFERS 200000
+#define PRODUCERS 3
+#define CONSUMERS 3
+
+static void test_spsc_single_thread(void **state)
+{
+    SPSCQueue *queue = spsc_queue_new(5, false);
+    assert_int_equal(8, spsc_queue_capacity(queue));
+    assert_int_equal(0, (uintptr_t)queue % 64);
+
+    void *item;
+    assert_false(spsc_queue_pop(queue, &item));
+
+    // wrap around the ring a few times
+    for (uintptr_t round = 0; round < 5; round++)
+    {
+        for (uintptr_t i = 0; i < 8; i++)
+        {
+            assert_true(spsc_queue_push(queue, (void *)(round * 8 + i)));
+        }
+        assert_false(spsc_queue_push(queue, NULL));
+
+        for (uintptr_t i = 0; i < 5; i++)
+        {
+            assert_true(spsc_queue_pop(queue, &item));
+            assert_int_equal(round * 8 + i, (uintptr_t)item);
+        }
+        assert_true(spsc_queue_pop(queue, &item));
+        assert_true(spsc_queue_pop(queue, &item));
+        assert_true(spsc_queue_pop(queue, &item));
+        assert_false(spsc_queue_pop(queue, &item));
+    }
+
+    void *in[12];
+    void *out[12];
+    for (uintptr_t i = 0; i < 12; i++)
+    {
+        in[i] = (void *)(i + 100);
+    }
+    assert_int_equal(3, spsc_queue_push_many(queue, in, 3));
+    assert_int_equal(2, spsc_queue_pop_many(queue, out, 2));
+    assert_int_equal(7, spsc_queue_push_many(queue, in + 3, 12));
+    assert_int_equal(8, spsc_queue_pop_many(queue, out + 2, 12));
+    for (uintptr_t i = 0; i < 10; i++)
+    {
+        assert_int_equal(i + 100, (uintptr_t)out[i]);
+    }
+
+    spsc_queue_destroy(queue);
+}
+
+static void test_mpmc_single_thread(void **state)
+{
+    MPMCQueue *queue = mpmc_queue_new(4, false);
+    assert_int_equal(0, (uintptr_t)queue % 64);
+    void *item;
+
+    for (uintptr_t round = 0; round < 5; round++)
+    {
+        for (uintptr_t i = 1; i <= 4; i++)
+        {
+            assert_true(mpmc_queue_push(queue, (void *)i));
+        }
+        assert_false(mpmc_queue_push(queue, NULL));
+        for (uintptr_t i = 1; i <= 4; i++)
+        {
+            assert_true(mpmc_queue_pop(queue, &item));
+            assert_int_equal(i, (uintptr_t)item);
+        }
+        assert_false(mpmc_queue_pop(queue, &item));
+    }
+
+    void *batch[6] = { (void *)1, (void *)2, (void *)3, (void *)4, (void *)5, (void *)6 };
+    void *out[6];
+    assert_int_equal(4, mpmc_queue_push_many(queue, batch, 6));
+    assert_int_equal(4, mpmc_queue_pop_many(queue, out, 6));
+    assert_memory_equal(batch, out, sizeof(void *) * 4);
+
+    mpmc_queue_destroy(queue);
+}
+
+static void *spsc_producer(void *arg)
+{
+    SPSCQueue *queue = arg;
+    void *batch[16];
+    uintptr_t next = 1;
+
+    while (next <= TRANSFERS)
+    {
+        size_t n = 0;
+        while (n < 16 && next + n <= TRANSFERS)
+        {
+            batch[n] = (void *)(next + n);
+            n++;
+        }
+
+        size_t pushed = 0;
+        while (pushed < n)
+        {
+            size_t k = spsc_queue_push_many(queue, batch + pushed, n - pushed);
+            if (k == 0)
+            {
+                spsc_queue_push_wait(queue, batch[pushed]);
+                k = 1;
+            }
+            pushed += k;
+        }
+        next += n;
+    }
+    return NULL;
+}
+
+static void test_spsc_threads(void **state)
+{
+    SPSCQueue *queue = spsc_queue_new(64, true);
+    pthread_t producer;
+    pthread_create(&producer, NULL, spsc_producer, queue);
+
+    for (uintptr_t expected = 1; expected <= TRANSFERS; expected++)
+    {
+        uintptr_t item = (uintptr_t)spsc_queue_pop_wait(queue);
+        assert_int_equal(expected, item);
+    }
+
+    pthread_join(producer, NULL);
+    spsc_queue_destroy(queue);
+}
+
+typedef struct
+{
+    MPMCQueue *queue;
+    uintptr_t first;
+    uint64_t sum;
+} Worker;
+
+static void *mpmc_producer(void *arg)
+{
+    Worker *worker = arg;
+    for (uintptr_t i = 0; i < TRANSFERS; i++)
+    {
+        mpmc_queue_push_wait(worker->queue, (void *)(worker->first + i));
+    }
+    return NULL;
+}
+
+static void *mpmc_consumer(void *arg)
+{
+    Worker *worker = arg;
+    for (;;)
+    {
+        uintptr_t item = (uintptr_t)mpmc_queue_pop_wait(worker->queue);
+        if (item == 0)
+        {
+            return NULL;
+        }
+        worker->sum += item;
+    }
+}
+
+static void test_mpmc_threads(void **state)
+{
+    MPMCQueue *queue = mpmc_queue_new(32, true);
+    pthread_t producers[PRODUCERS];
+    pthread_t consumers[CONSUMERS];
+    Worker workers[PRODUCERS + CONSUMERS];
+    uint64_t expected = 0;
+
+    for (int i = 0; i < PRODUCERS; i++)
+    {
+        workers[i] = (Worker){ queue, 1 + (uintptr_t)i * TRANSFERS, 0 };
+        for (uintptr_t k = 0; k < TRANSFERS; k++)
+        {
+            expected += workers[i].first + k;
+        }
+        pthread_create(&producers[i], NULL, mpmc_producer, &workers[i]);
+    }
+    for (int i = 0; i < CONSUMERS; i++)
+    {
+        workers[PRODUCERS + i] = (Worker){ queue, 0, 0 };
+        pthread_create(&consumers[i], NULL, mpmc_consumer, &workers[PRODUCERS + i]);
+    }
+
+    for (int i = 0; i < PRODUCERS; i++)
+    {
+        pthread_join(producers[i], NULL);
+    }
+    for (int i = 0; i < CONSUMERS; i++)
+    {
+        // one stop marker per consumer
+        mpmc_queue_push_wait(queue, NULL);
+    }
+
+    uint64_t sum = 0;
+    for (int i = 0; i < CONSUMERS; i++)
+    {
+        pthread_join(consumers[i], NULL);
+        sum += workers[PRODUCERS + i].sum;
+    }
+    assert_true(sum == expected);
+
+    mpmc_queue_destroy(queue);
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_spsc_single_thread),
+        unit_test(test_mpmc_single_thread),
+        unit_test(test_spsc_threads),
+        unit_test(test_mpmc_threads)
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,229 @@
+#include "roaring-set.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+// Values the tests draw from: a sparse group, a dense one and a tail
+#define SPAN (4 * 65536)
+
+static uint32_t random_value(void)
+{
+    uint32_t r = (uint32_t)rand();
+    switch (r % 3)
+    {
+    case 0:
+        return (r / 3) % 65536 * 17 % 65536;
+    case 1:
+        return 65536 + (r / 3) % 20000;
+    default:
+        return UINT32_MAX - (r / 3) % SPAN;
+    }
+}
+
+static size_t model_index(uint32_t value)
+{
+    return value < 2 * 65536 ? value : 2 * 65536 + (UINT32_MAX - value);
+}
+
+static void check_against(const RoaringSet *set, const bool *model)
+{
+    size_t count = 0;
+    for (uint32_t v = 0; v < 2 * 65536; v++)
+    {
+        assert_int_equal(model[model_index(v)], roaring_set_contains(set, v));
+        count += model[model_index(v)];
+    }
+    for (uint32_t v = UINT32_MAX - SPAN + 1; v != 0; v++)
+    {
+        assert_int_equal(model[model_index(v)], roaring_set_contains(set, v));
+        count += model[model_index(v)];
+    }
+    assert_int_equal(count, roaring_set_size(set));
+
+    RoaringSetIterator *iter = roaring_set_iterator_new(set);
+    uint32_t value, previous = 0;
+    size_t seen = 0;
+    while (roaring_set_iterator_next(iter, &value))
+    {
+        assert_true(seen == 0 || value > previous);
+        assert_true(model[model_index(value)]);
+        previous = value;
+        seen++;
+    }
+    assert_int_equal(count, seen);
+    roaring_set_iterator_destroy(iter);
+}
+
+static void test_add_remove(void **state)
+{
+    RoaringSet *set = roaring_set_new();
+    bool *model = calloc(2 * 65536 + SPAN, sizeof(bool));
+
+    srand(1);
+    for (int round = 0; round < 4; round++)
+    {
+        for (int i = 0; i < 60000; i++)
+        {
+            uint32_t v = random_value();
+            assert_int_equal(!model[model_index(v)], roaring_set_add(set, v));
+            model[model_index(v)] = true;
+        }
+        check_against(set, model);
+
+        for (int i = 0; i < 50000; i++)
+        {
+            uint32_t v = random_value();
+            assert_int_equal(model[model_index(v)], roaring_set_remove(set, v));
+            model[model_index(v)] = false;
+        }
+        check_against(set, model);
+
+        roaring_set_optimize(set);
+        check_against(set, model);
+    }
+
+    roaring_set_clear(set);
+    assert_int_equal(0, roaring_set_size(set));
+    assert_false(roaring_set_contains(set, 65536));
+
+    free(model);
+    roaring_set_destroy(set);
+}
+
+static void test_runs(void **state)
+{
+    RoaringSet *set = roaring_set_new();
+
+    for (uint32_t v = 1000; v < 1000000; v++)
+    {
+        roaring_set_add(set, v);
+    }
+    size_t before = roaring_set_memory(set);
+    roaring_set_optimize(set);
+    assert_true(roaring_set_memory(set) < before / 100);
+    assert_int_equal(999000, roaring_set_size(set));
+
+    // changing a group of runs turns it back into a bitmap
+    assert_false(roaring_set_add(set, 5000));
+    assert_true(roaring_set_remove(set, 5000));
+    assert_false(roaring_set_contains(set, 5000));
+    assert_true(roaring_set_contains(set, 5001));
+    assert_true(roaring_set_add(set, 5000));
+    assert_true(roaring_set_add(set, 999));
+    assert_int_equal(999001, roaring_set_size(set));
+
+    RoaringSetIterator *iter = roaring_set_iterator_new(set);
+    uint32_t value;
+    for (uint32_t v = 999; v < 1000000; v++)
+    {
+        assert_true(roaring_set_iterator_next(iter, &value));
+        assert_int_equal(v, value);
+    }
+    assert_false(roaring_set_iterator_next(iter, &value));
+    roaring_set_iterator_destroy(iter);
+
+    roaring_set_destroy(set);
+}
+
+static void test_dense_memory(void **state)
+{
+    RoaringSet *set = roaring_set_new();
+
+    srand(2);
+    // half of the first 2^21 integers
+    for (uint32_t v = 0; v < 1u << 21; v++)
+    {
+        if (rand() % 2)
+        {
+            roaring_set_add(set, v);
+        }
+    }
+
+    // Set spends about 48 bytes per value
+    assert_true(roaring_set_memory(set) * 10 < roaring_set_size(set) * 48);
+
+    roaring_set_destroy(set);
+}
+
+static RoaringSet *random_set(bool *model, int count, bool optimize)
+{
+    RoaringSet *set = roaring_set_new();
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t v = random_value();
+        roaring_set_add(set, v);
+        model[model_index(v)] = true;
+    }
+    if (optimize)
+    {
+        roaring_set_optimize(set);
+    }
+    return set;
+}
+
+static void test_union_intersection(void **state)
+{
+    const int counts[] = { 0, 100, 10000, 200000 };
+    size_t model_size = 2 * 65536 + SPAN;
+    bool *a_model = malloc(model_size);
+    bool *b_model = malloc(model_size);
+    bool *expected = malloc(model_size);
+
+    srand(3);
+    for (int x = 0; x < 4; x++)
+    {
+        for (int y = 0; y < 4; y++)
+        {
+            memset(a_model, 0, model_size);
+            memset(b_model, 0, model_size);
+            RoaringSet *a = random_set(a_model, counts[x], x % 2);
+            RoaringSet *b = random_set(b_model, counts[y], y % 2 == 0);
+
+            RoaringSet *u = roaring_set_union(a, b);
+            for (size_t i = 0; i < model_size; i++)
+            {
+                expected[i] = a_model[i] || b_model[i];
+            }
+            check_against(u, expected);
+
+            RoaringSet *n = roaring_set_intersection(a, b);
+            for (size_t i = 0; i < model_size; i++)
+            {
+                expected[i] = a_model[i] && b_model[i];
+            }
+            check_against(n, expected);
+
+            RoaringSet *again = roaring_set_intersection(u, a);
+            assert_true(roaring_set_equal(again, a));
+            assert_int_equal(counts[x] == 0 && counts[y] == 0, roaring_set_equal(a, b));
+
+            roaring_set_destroy(again);
+            roaring_set_destroy(u);
+            roaring_set_destroy(n);
+            roaring_set_destroy(a);
+            roaring_set_destroy(b);
+        }
+    }
+
+    free(a_model);
+    free(b_model);
+    free(expected);
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_add_remove),
+        unit_test(test_runs),
+        unit_test(test_dense_memory),
+        unit_test(test_union_intersection)
+    };
+
+    return run_tests(tests);
+}
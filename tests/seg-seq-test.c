@@ -0,0 +1,187 @@
+#include "seg-seq.h"
+
+#include "alloc.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+
+#include <stdlib.h>
+
+static size_t allocations;
+
+static void *counting_allocate(void *context, size_t size)
+{
+    allocations++;
+    return malloc(size);
+}
+
+static void *counting_reallocate(void *context, void *ptr, size_t size)
+{
+    if (!ptr)
+    {
+        allocations++;
+    }
+    return realloc(ptr, size);
+}
+
+static void counting_deallocate(void *context, void *ptr)
+{
+    free(ptr);
+}
+
+static void test_push_pop_both_ends(void **state)
+{
+    SegSeq *seq = seg_seq_new_sized(sizeof(int), NULL);
+    // model: values lo .. hi - 1 in order
+    int lo = 0;
+    int hi = 0;
+
+    srand(3);
+    for (int step = 0; step < 200000; step++)
+    {
+        int value;
+        switch (rand() % 4)
+        {
+        case 0:
+            value = hi++;
+            seg_seq_push_back(seq, &value);
+            break;
+        case 1:
+            value = --lo;
+            seg_seq_push_front(seq, &value);
+            break;
+        case 2:
+            if (seg_seq_pop_back(seq, &value))
+            {
+                assert_int_equal(--hi, value);
+            }
+            else
+            {
+                assert_int_equal(lo, hi);
+            }
+            break;
+        default:
+            if (seg_seq_pop_front(seq, &value))
+            {
+                assert_int_equal(lo++, value);
+            }
+            else
+            {
+                assert_int_equal(lo, hi);
+            }
+            break;
+        }
+
+        assert_int_equal(hi - lo, seg_seq_length(seq));
+        if (step % 1000 == 0)
+        {
+            for (size_t i = 0; i < seg_seq_length(seq); i++)
+            {
+                assert_int_equal(lo + (int)i, *(int *)seg_seq_at(seq, i));
+            }
+        }
+    }
+
+    seg_seq_destroy(seq);
+}
+
+static void test_stable_addresses(void **state)
+{
+    SegSeq *seq = seg_seq_new_sized(sizeof(double), NULL);
+    double *addresses[1000];
+
+    for (int i = 0; i < 1000; i++)
+    {
+        double value = i;
+        seg_seq_push_back(seq, &value);
+        addresses[i] = seg_seq_at(seq, i);
+    }
+    for (int i = 0; i < 100000; i++)
+    {
+        double value = -i;
+        seg_seq_push_back(seq, &value);
+        seg_seq_push_front(seq, &value);
+    }
+
+    for (int i = 0; i < 1000; i++)
+    {
+        assert_true(addresses[i] == seg_seq_at(seq, 100000 + i));
+        assert_true(*addresses[i] == i);
+    }
+
+    seg_seq_destroy(seq);
+}
+
+static void test_steady_state_queue(void **state)
+{
+    Allocator counting = { counting_allocate, counting_reallocate, counting_deallocate, NULL };
+    SegSeq *seq = seg_seq_new_sized(sizeof(long), NULL);
+    long value = 0;
+
+    for (int i = 0; i < 10000; i++)
+    {
+        seg_seq_push_back(seq, &value);
+    }
+    // let the directory settle on its size
+    for (int i = 0; i < 100000; i++)
+    {
+        seg_seq_push_back(seq, &value);
+        seg_seq_pop_front(seq, NULL);
+    }
+
+    alloc_set_allocator(&counting);
+    allocations = 0;
+    for (int i = 0; i < 100000; i++)
+    {
+        seg_seq_push_back(seq, &value);
+        assert_true(seg_seq_pop_front(seq, NULL));
+    }
+    alloc_set_allocator(NULL);
+
+    // chunks recycle through the spare
+    assert_int_equal(0, allocations);
+    assert_int_equal(10000, seg_seq_length(seq));
+    seg_seq_destroy(seq);
+}
+
+static void test_pointers(void **state)
+{
+    SegSeq *seq = seg_seq_new(free);
+
+    for (int i = 0; i < 5000; i++)
+    {
+        seg_seq_push_front(seq, xmemdup(&i, sizeof(int)));
+    }
+    assert_int_equal(4999, *(int *)seg_seq_at(seq, 0));
+    assert_int_equal(0, *(int *)seg_seq_at(seq, 4999));
+
+    int *out;
+    assert_true(seg_seq_pop_back(seq, &out));
+    assert_int_equal(0, *out);
+    free(out);
+    assert_true(seg_seq_pop_back(seq, NULL));
+
+    seg_seq_clear(seq);
+    assert_int_equal(0, seg_seq_length(seq));
+    assert_false(seg_seq_pop_front(seq, NULL));
+
+    seg_seq_push_back(seq, xmemdup(&(int){ 7 }, sizeof(int)));
+    assert_int_equal(7, *(int *)seg_seq_at(seq, 0));
+
+    seg_seq_destroy(seq);
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_push_pop_both_ends),
+        unit_test(test_stable_addresses),
+        unit_test(test_steady_state_queue),
+        unit_test(test_pointers)
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,335 @@
+#include "seq-sort.h"
+
+#include "alloc.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct
+{
+    uint32_t key;
+    uint32_t order;
+    char payload[24];
+} Record;
+
+static int int_compare(const void *a, const void *b)
+{
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+static int record_compare(const void *a, const void *b)
+{
+    const Record *x = a;
+    const Record *y = b;
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+static uint64_t record_key(const void *item)
+{
+    return ((const Record *)item)->key;
+}
+
+static uint64_t signed_key(const void *item)
+{
+    return (uint64_t)*(const int64_t *)item ^ (UINT64_C(1) << 63);
+}
+
+static Seq *random_ints(size_t n, int range)
+{
+    Seq *seq = seq_new_sized(sizeof(int), n, NULL);
+    for (size_t i = 0; i < n; i++)
+    {
+        int value = rand() % range;
+        seq_append(seq, &value);
+    }
+    return seq;
+}
+
+static void assert_same_as_qsort(Seq *seq, const int *expected)
+{
+    for (size_t i = 0; i < seq_length(seq); i++)
+    {
+        assert_int_equal(expected[i], *(int *)seq_at(seq, i));
+    }
+}
+
+static void check_sort(size_t n, int range, void (*sort)(Seq *))
+{
+    Seq *seq = random_ints(n, range);
+    int *expected = xmemdup(seq_data(seq), sizeof(int) * (n ? n : 1));
+    qsort(expected, n, sizeof(int), int_compare);
+
+    sort(seq);
+    assert_same_as_qsort(seq, expected);
+
+    free(expected);
+    seq_destroy(seq);
+}
+
+static void sort_serial(Seq *seq)
+{
+    seq_sort(seq, int_compare);
+}
+
+static void sort_parallel(Seq *seq)
+{
+    seq_sort_parallel(seq, int_compare, 5);
+}
+
+static void test_sort(void **state)
+{
+    size_t sizes[] = { 0, 1, 2, 3, 15, 16, 17, 100, 1000, 50000 };
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        check_sort(sizes[i], 1000000, sort_serial);
+        check_sort(sizes[i], 3, sort_serial);
+    }
+}
+
+static void test_sort_patterns(void **state)
+{
+    const size_t n = 10000;
+    Seq *seq = seq_new_sized(sizeof(int), n, NULL);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        // organ pipe: ascending then descending
+        int value = i < n / 2 ? (int)i : (int)(n - i);
+        seq_append(seq, &value);
+    }
+    seq_sort(seq, int_compare);
+    for (size_t i = 1; i < n; i++)
+    {
+        assert_true(*(int *)seq_at(seq, i - 1) <= *(int *)seq_at(seq, i));
+    }
+
+    seq_sort(seq, int_compare);
+    for (size_t i = 1; i < n; i++)
+    {
+        assert_true(*(int *)seq_at(seq, i - 1) <= *(int *)seq_at(seq, i));
+    }
+
+    seq_destroy(seq);
+}
+
+static int string_compare(const void *a, const void *b)
+{
+    return strcmp(a, b);
+}
+
+static void test_sort_pointers(void **state)
+{
+    Seq *seq = seq_new(0, free);
+    char buf[16];
+
+    for (int i = 999; i >= 0; i--)
+    {
+        snprintf(buf, sizeof(buf), "%04d", (i * 7) % 1000);
+        seq_append(seq, xmemdup(buf, strlen(buf) + 1));
+    }
+
+    seq_sort(seq, string_compare);
+    for (int i = 0; i < 1000; i++)
+    {
+        snprintf(buf, sizeof(buf), "%04d", i);
+        assert_string_equal(buf, seq_at(seq, i));
+    }
+
+    seq_destroy(seq);
+}
+
+static void test_sort_parallel(void **state)
+{
+    check_sort(100, 1000, sort_parallel);
+    check_sort(200003, 1000000, sort_parallel);
+    check_sort(200003, 10, sort_parallel);
+
+    Seq *seq = random_ints(100000, 1000000);
+    seq_sort_parallel(seq, int_compare, 0);
+    for (size_t i = 1; i < seq_length(seq); i++)
+    {
+        assert_true(*(int *)seq_at(seq, i - 1) <= *(int *)seq_at(seq, i));
+    }
+    seq_destroy(seq);
+}
+
+static void test_radix_sort(void **state)
+{
+    const size_t n = 100000;
+    Seq *seq = seq_new_sized(sizeof(Record), n, NULL);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        Record r = { (uint32_t)rand() % 5000, i, "payload" };
+        seq_append(seq, &r);
+    }
+
+    seq_radix_sort_by_key(seq, record_key);
+    for (size_t i = 1; i < n; i++)
+    {
+        const Record *prev = seq_at(seq, i - 1);
+        const Record *curr = seq_at(seq, i);
+        assert_true(record_compare(prev, curr) <= 0);
+        if (prev->key == curr->key)
+        {
+            // stable
+            assert_true(prev->order < curr->order);
+        }
+        assert_string_equal("payload", curr->payload);
+    }
+
+    seq_destroy(seq);
+}
+
+static void test_radix_sort_signed(void **state)
+{
+    int64_t values[] = { 5, -1, INT64_MIN, 0, INT64_MAX, -1000, 42 };
+    int64_t expected[] = { INT64_MIN, -1000, -1, 0, 5, 42, INT64_MAX };
+
+    Seq *seq = seq_new_sized(sizeof(int64_t), 0, NULL);
+    seq_append_n(seq, values, 7);
+    seq_radix_sort_by_key(seq, signed_key);
+    assert_memory_equal(expected, seq_data(seq), sizeof(expected));
+    seq_destroy(seq);
+}
+
+static uint64_t int_key(const void *item)
+{
+    return (uint64_t)*(const int *)item;
+}
+
+static void test_search(void **state)
+{
+    Seq *seq = seq_new_sized(sizeof(int), 0, NULL);
+    for (int i = 0; i < 1000; i++)
+    {
+        int value = i * 2;
+        seq_append(seq, &value);
+    }
+
+    for (int probe = -1; probe <= 2000; probe++)
+    {
+        size_t expected = probe < 0 ? 0 : (size_t)(probe + 1) / 2;
+        size_t index;
+
+        assert_int_equal(expected, seq_lower_bound(seq, &probe, int_compare));
+        assert_int_equal(probe >= 0 && probe < 2000 && probe % 2 == 0,
+                         seq_binary_search(seq, &probe, int_compare, &index));
+        assert_int_equal(expected, index);
+        if (probe >= 0)
+        {
+            assert_int_equal(expected, seq_interpolation_search(seq, (uint64_t)probe, int_key));
+        }
+    }
+
+    Seq *empty = seq_new_sized(sizeof(int), 0, NULL);
+    int zero = 0;
+    assert_int_equal(0, seq_lower_bound(empty, &zero, int_compare));
+    assert_false(seq_binary_search(empty, &zero, int_compare, NULL));
+    assert_int_equal(0, seq_interpolation_search(empty, 0, int_key));
+    seq_destroy(empty);
+
+    seq_destroy(seq);
+}
+
+static void test_interpolation_skewed(void **state)
+{
+    Seq *seq = seq_new_sized(sizeof(int), 0, NULL);
+    for (int i = 0; i < 10000; i++)
+    {
+        // mostly tiny keys with a huge tail
+        int value = i < 9990 ? i / 100 : 1000000 + i;
+        seq_append(seq, &value);
+    }
+
+    for (int probe = 0; probe < 120; probe++)
+    {
+        assert_int_equal(seq_lower_bound(seq, &probe, int_compare),
+                         seq_interpolation_search(seq, (uint64_t)probe, int_key));
+    }
+    assert_int_equal(9995, seq_interpolation_search(seq, 1009995, int_key));
+    assert_int_equal(10000, seq_interpolation_search(seq, 2000000, int_key));
+
+    seq_destroy(seq);
+}
+
+static int destroyed;
+
+static void count_destroy(void *item)
+{
+    destroyed++;
+    free(item);
+}
+
+static void test_dedup_sorted(void **state)
+{
+    int values[] = { 1, 1, 2, 3, 3, 3, 4, 5, 5 };
+    int expected[] = { 1, 2, 3, 4, 5 };
+
+    Seq *seq = seq_new_sized(sizeof(int), 0, NULL);
+    seq_append_n(seq, values, 9);
+    assert_int_equal(4, seq_dedup_sorted(seq, int_compare));
+    assert_memory_equal(expected, seq_data(seq), sizeof(expected));
+    assert_int_equal(0, seq_dedup_sorted(seq, int_compare));
+    seq_destroy(seq);
+
+    Seq *boxed = seq_new(0, count_destroy);
+    for (int i = 0; i < 9; i++)
+    {
+        seq_append(boxed, xmemdup(&values[i], sizeof(int)));
+    }
+    destroyed = 0;
+    assert_int_equal(4, seq_dedup_sorted(boxed, int_compare));
+    assert_int_equal(4, destroyed);
+    for (int i = 0; i < 5; i++)
+    {
+        assert_int_equal(expected[i], *(int *)seq_at(boxed, i));
+    }
+    seq_destroy(boxed);
+}
+
+static int mod_compare(const void *a, const void *b, void *context)
+{
+    int m = *(const int *)context;
+    return int_compare(&(int){ *(const int *)a % m }, &(int){ *(const int *)b % m });
+}
+
+static void test_sort_r(void **state)
+{
+    int m = 10;
+    Seq *seq = random_ints(1000, 1000);
+    seq_sort_r(seq, mod_compare, &m);
+    for (size_t i = 1; i < seq_length(seq); i++)
+    {
+        assert_true(*(int *)seq_at(seq, i - 1) % m <= *(int *)seq_at(seq, i) % m);
+    }
+    seq_destroy(seq);
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_sort),
+        unit_test(test_sort_patterns),
+        unit_test(test_sort_pointers),
+        unit_test(test_sort_parallel),
+        unit_test(test_radix_sort),
+        unit_test(test_radix_sort_signed),
+        unit_test(test_search),
+        unit_test(test_interpolation_skewed),
+        unit_test(test_dedup_sorted),
+        unit_test(test_sort_r)
+    };
+
+    return run_tests(tests);
+}
@@ -1,4 +1,385 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "seq.h"
+
+#include "alloc.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+static size_t allocations;
+
+static void *counting_allocate(void *context, size_t size)
+{
+    allocations++;
+    return malloc(size);
+}
+
+static void *counting_reallocate(void *context, void *ptr, size_t size)
+{
+    if (!ptr)
+    {
+        allocations++;
+    }
+    return realloc(ptr, size);
+}
+
+static void counting_deallocate(void *context, void *ptr)
+{
+    free(ptr);
+}
+
+static void test_append(void **state)
+{
+    Seq *seq = seq_new(0, free);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        seq_append(seq, xmemdup(&i, sizeof(int)));
+    }
+
+    assert_int_equal(1000, seq_length(seq));
+    for (int i = 0; i < 1000; i++)
+    {
+        assert_int_equal(i, *(int *)seq_at(seq, i));
+    }
+
+    seq_destroy(seq);
+}
+
+static void test_inline_storage(void **state)
+{
+    static int items[16];
+    Allocator counting = { counting_allocate, counting_reallocate, counting_deallocate, NULL };
+    alloc_set_allocator(&counting);
+    allocations = 0;
+
+    Seq *seq = seq_new(4, NULL);
+    for (int i = 0; i < 8; i++)
+    {
+        seq_append(seq, &items[i]);
+    }
+    assert_int_equal(1, allocations);
+
+    for (int i = 8; i < 16; i++)
+    {
+        seq_append(seq, &items[i]);
+    }
+    assert_int_equal(2, allocations);
+
+    for (int i = 0; i < 16; i++)
+    {
+        assert_true(seq_at(seq, i) == &items[i]);
+    }
+
+    seq_destroy(seq);
+    alloc_set_allocator(NULL);
+}
+
+typedef struct
+{
+    int id;
+    double weight;
+    char *name;
+} Record;
+
+static void record_destroy(void *item)
+{
+    free(((Record *)item)->name);
+}
+
+static void test_sized(void **state)
+{
+    Seq *seq = seq_new_sized(sizeof(Record), 0, record_destroy);
+    assert_int_equal(sizeof(Record), seq_elem_size(seq));
+
+    for (int i = 0; i < 100; i++)
+    {
+        Record r = { i, i * 0.5, xmemdup("name", 5) };
+        seq_append(seq, &r);
+    }
+
+    assert_int_equal(100, seq_length(seq));
+    for (int i = 0; i < 100; i++)
+    {
+        Record *r = seq_at(seq, i);
+        assert_true(r == seq_at_ptr(seq, i));
+        assert_int_equal(i, r->id);
+        assert_true(r->weight == i * 0.5);
+        assert_string_equal("name", r->name);
+    }
+    assert_true((Record *)seq_data(seq) + 42 == seq_at(seq, 42));
+
+    seq_destroy(seq);
+}
+
+static void test_append_n(void **state)
+{
+    int values[1000];
+    for (int i = 0; i < 1000; i++)
+    {
+        values[i] = i;
+    }
+
+    Seq *seq = seq_new_sized(sizeof(int), 4, NULL);
+    seq_append_n(seq, values, 3);
+    seq_append_n(seq, values + 3, 997);
+    seq_append_n(seq, values, 0);
+
+    assert_int_equal(1000, seq_length(seq));
+    long sum = 0;
+    const int *data = seq_data(seq);
+    for (size_t i = 0; i < seq_length(seq); i++)
+    {
+        sum += data[i];
+    }
+    assert_int_equal(999 * 1000 / 2, sum);
+    seq_destroy(seq);
+
+    void *pointers[3] = { &values[0], &values[1], &values[2] };
+    Seq *boxed = seq_new(0, NULL);
+    seq_append(boxed, &values[5]);
+    seq_append_n(boxed, pointers, 3);
+    assert_int_equal(4, seq_length(boxed));
+    assert_true(seq_at(boxed, 0) == &values[5]);
+    assert_true(seq_at(boxed, 3) == &values[2]);
+    assert_true(*(void **)seq_at_ptr(boxed, 1) == &values[0]);
+    seq_destroy(boxed);
+}
+
+static void test_sized_large_elements(void **state)
+{
+    char big[200] = "large";
+
+    Seq *seq = seq_new_sized(sizeof(big), 0, NULL);
+    for (int i = 0; i < 10; i++)
+    {
+        seq_append(seq, big);
+    }
+    assert_string_equal("large", (char *)seq_at(seq, 9));
+    seq_destroy(seq);
+}
+
+static int destroyed;
+
+static void count_destroy(void *item)
+{
+    destroyed++;
+}
+
+static void test_insert_remove_range(void **state)
+{
+    int values[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    int middle[3] = { 100, 101, 102 };
+
+    Seq *seq = seq_new_sized(sizeof(int), 0, count_destroy);
+    seq_append_n(seq, values, 10);
+    seq_insert_range(seq, 5, middle, 3);
+    seq_insert_range(seq, 0, middle, 1);
+    seq_insert_range(seq, seq_length(seq), middle + 2, 1);
+
+    int expected[] = { 100, 0, 1, 2, 3, 4, 100, 101, 102, 5, 6, 7, 8, 9, 102 };
+    assert_int_equal(15, seq_length(seq));
+    assert_memory_equal(expected, seq_data(seq), sizeof(expected));
+
+    destroyed = 0;
+    seq_remove_range(seq, 6, 3);
+    seq_remove_range(seq, 0, 1);
+    seq_remove_range(seq, 10, 1);
+    seq_remove_range(seq, 3, 0);
+    assert_int_equal(5, destroyed);
+    assert_int_equal(10, seq_length(seq));
+    assert_memory_equal(values, seq_data(seq), sizeof(values));
+
+    seq_destroy(seq);
+}
+
+static void test_capacity(void **state)
+{
+    Allocator counting = { counting_allocate, counting_reallocate, counting_deallocate, NULL };
+
+    Seq *seq = seq_new(0, count_destroy);
+    seq_reserve(seq, 1000);
+    assert_true(seq_capacity(seq) >= 1000);
+
+    alloc_set_allocator(&counting);
+    allocations = 0;
+    for (int round = 0; round < 3; round++)
+    {
+        destroyed = 0;
+        for (int i = 0; i < 1000; i++)
+        {
+            seq_append(seq, NULL);
+        }
+        seq_clear(seq);
+        assert_int_equal(1000, destroyed);
+        assert_int_equal(0, seq_length(seq));
+    }
+    assert_int_equal(0, allocations);
+    alloc_set_allocator(NULL);
+
+    seq_append(seq, NULL);
+    seq_shrink_to_fit(seq);
+    assert_int_equal(1, seq_capacity(seq));
+    seq_append(seq, NULL);
+    assert_int_equal(2, seq_length(seq));
+
+    seq_destroy(seq);
+}
+
+static void reserve_too_much(void)
+{
+    Seq *seq = seq_new_sized(8, 0, NULL);
+    seq_reserve(seq, SIZE_MAX / 4 + 2);
+}
+
+static void append_too_much(void)
+{
+    Seq *seq = seq_new_sized(8, 0, NULL);
+    seq_append_n(seq, NULL, SIZE_MAX / 8 + 1);
+}
+
+static bool aborts(void (*f)(void))
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        // cmockery catches SIGABRT itself
+        signal(SIGABRT, SIG_DFL);
+        f();
+        _exit(0);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+}
+
+static void test_overflow(void **state)
+{
+    // hard errors, also in NDEBUG builds
+    assert_true(aborts(reserve_too_much));
+    assert_true(aborts(append_too_much));
+}
+
+/*
+ * Hands out big blocks as the same small file region mapped over and over,
+ * so a Seq of several GiB only takes ALIAS_BYTES of memory.
+ */
+#define ALIAS_BYTES ((size_t)1 << 20)
+
+typedef struct
+{
+    char *base;
+    size_t size;
+} AliasedBlock;
+
+static void *aliased_allocate(void *context, size_t size)
+{
+    AliasedBlock *block = context;
+    if (size < ALIAS_BYTES)
+    {
+        return malloc(size);
+    }
+    assert_true(block->base == NULL);
+
+    FILE *file = tmpfile();
+    assert_true(file != NULL);
+    int fd = fileno(file);
+    assert_int_equal(0, ftruncate(fd, ALIAS_BYTES));
+
+    // Map past the end of the file to claim the address range, then
+    // overlay it with copies of the region
+    block->size = (size + ALIAS_BYTES - 1) / ALIAS_BYTES * ALIAS_BYTES;
+    block->base = mmap(NULL, block->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    assert_true(block->base != MAP_FAILED);
+    for (size_t offset = ALIAS_BYTES; offset < block->size; offset += ALIAS_BYTES)
+    {
+        void *p = mmap(block->base + offset, ALIAS_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+        assert_true(p == block->base + offset);
+    }
+
+    fclose(file);
+    return block->base;
+}
+
+static void *aliased_reallocate(void *context, void *ptr, size_t size)
+{
+    assert_true(ptr != ((AliasedBlock *)context)->base);
+    return realloc(ptr, size);
+}
+
+static void aliased_deallocate(void *context, void *ptr)
+{
+    AliasedBlock *block = context;
+    if (ptr && ptr == block->base)
+    {
+        munmap(block->base, block->size);
+        block->base = NULL;
+    }
+    else
+    {
+        free(ptr);
+    }
+}
+
+static void test_past_32_bits(void **state)
+{
+    static char chunk[ALIAS_BYTES];
+    const size_t target = ((size_t)1 << 32) + sizeof(chunk);
+
+    AliasedBlock block = { NULL, 0 };
+    Allocator aliased = { aliased_allocate, aliased_reallocate, aliased_deallocate, &block };
+    alloc_set_allocator(&aliased);
+    Seq *seq = seq_new_sized(1, 0, NULL);
+    alloc_set_allocator(NULL);
+
+    seq_reserve(seq, target + 1);
+    assert_true(block.base != NULL);
+    while (seq_length(seq) < target)
+    {
+        seq_append_n(seq, chunk, sizeof(chunk));
+    }
+    char marker = 'x';
+    seq_append(seq, &marker);
+
+    assert_true(seq_length(seq) == target + 1);
+    assert_true(seq_capacity(seq) >= target + 1);
+    assert_int_equal('x', *(char *)seq_at(seq, target));
+    assert_int_equal(0, *(char *)seq_at(seq, ((size_t)1 << 32) + 1));
+
+    // shifting by ALIAS_BYTES moves every byte onto itself
+    seq_remove_range(seq, 0, sizeof(chunk));
+    assert_int_equal('x', *(char *)seq_at(seq, target - sizeof(chunk)));
+
+    seq_destroy(seq);
+    assert_true(block.base == NULL);
+}
+
 int main()
 {
-    return 0;
+    const UnitTest tests[] =
+    {
+        unit_test(test_append),
+        unit_test(test_inline_storage),
+        unit_test(test_sized),
+        unit_test(test_append_n),
+        unit_test(test_sized_large_elements),
+        unit_test(test_insert_remove_range),
+        unit_test(test_capacity),
+        unit_test(test_overflow),
+        unit_test(test_past_32_bits)
+    };
+
+    return run_tests(tests);
 }
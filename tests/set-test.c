@@ -1,4 +1,151 @@
+#include "set.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static size_t compares;
+
+static int string_compare(const void *a, const void *b)
+{
+    return strcmp(a, b);
+}
+
+static int int_compare(const void *a, const void *b)
+{
+    compares++;
+    return (*(const int *)a > *(const int *)b) - (*(const int *)a < *(const int *)b);
+}
+
+static uint64_t int_hash(const void *a)
+{
+    uint64_t h = (uint32_t)*(const int *)a * 0x9e3779b97f4a7c15ULL;
+    return h ^ (h >> 29);
+}
+
+static void test_contains_many(void **state)
+{
+    char *words[] = { "alpha", "beta", "gamma", "delta", "epsilon" };
+
+    Set *s = set_new(NULL, string_compare, NULL);
+    for (int i = 0; i < 5; i += 2)
+    {
+        set_add(s, words[i]);
+    }
+
+    const void *probe[7] = { words[0], words[1], words[2], words[3], words[4], "zeta", words[0] };
+    bool found[7];
+    assert_int_equal(4, set_contains_many(s, probe, 7, found));
+
+    for (int i = 0; i < 7; i++)
+    {
+        assert_int_equal(set_contains(s, probe[i]), found[i]);
+    }
+
+    assert_int_equal(4, set_contains_many(s, probe, 7, NULL));
+
+    set_destroy(s);
+}
+
+static void test_filtered(void **state)
+{
+    enum { RANGE = 20000 };
+    static int values[RANGE];
+    bool present[RANGE] = { false };
+
+    Set *s = set_new_filtered(NULL, int_compare, NULL, int_hash);
+    for (int i = 0; i < RANGE; i++)
+    {
+        values[i] = i;
+    }
+
+    // churn: the filter is rebuilt as the set grows and as removals pile up
+    srand(1);
+    for (int step = 0; step < 200000; step++)
+    {
+        int v = rand() % RANGE;
+        if (rand() % 3)
+        {
+            set_add(s, &values[v]);
+            present[v] = true;
+        }
+        else
+        {
+            assert_int_equal(present[v], set_remove(s, &values[v]));
+            present[v] = false;
+        }
+    }
+
+    size_t size = 0;
+    for (int v = 0; v < RANGE; v++)
+    {
+        assert_int_equal(present[v], set_contains(s, &values[v]));
+        size += present[v];
+    }
+    assert_int_equal(size, set_size(s));
+
+    const void *probe[RANGE];
+    bool found[RANGE];
+    for (int v = 0; v < RANGE; v++)
+    {
+        probe[v] = &values[v];
+    }
+    assert_int_equal(size, set_contains_many(s, probe, RANGE, found));
+    for (int v = 0; v < RANGE; v++)
+    {
+        assert_int_equal(present[v], found[v]);
+    }
+
+    // misses mostly stop at the filter
+    int missing[10000];
+    compares = 0;
+    for (int i = 0; i < 10000; i++)
+    {
+        missing[i] = RANGE + i;
+        assert_false(set_contains(s, &missing[i]));
+    }
+    assert_true(compares < 10000);
+
+    set_clear(s);
+    assert_false(set_contains(s, &values[0]));
+    set_add(s, &values[0]);
+    assert_true(set_contains(s, &values[0]));
+
+    set_destroy(s);
+}
+
+static void test_equal(void **state)
+{
+    Set *a = set_new(NULL, string_compare, NULL);
+    Set *b = set_new(NULL, string_compare, NULL);
+
+    assert_true(set_equal(NULL, NULL));
+    assert_false(set_equal(NULL, a));
+    assert_false(set_equal(a, NULL));
+    assert_true(set_equal(a, a));
+    assert_true(set_equal(a, b));
+
+    set_add(a, "x");
+    assert_false(set_equal(a, b));
+    set_add(b, "x");
+    assert_true(set_equal(a, b));
+
+    set_destroy(a);
+    set_destroy(b);
+}
+
 int main()
 {
-    return 0;
+    const UnitTest tests[] =
+    {
+        unit_test(test_contains_many),
+        unit_test(test_filtered),
+        unit_test(test_equal)
+    };
+
+    return run_tests(tests);
 }
@@ -0,0 +1,143 @@
+#include "task-pool.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+
+#include <pthread.h>
+
+typedef struct
+{
+    TaskPool *pool;
+    int n;
+    long result;
+} Fib;
+
+static void fib(void *arg)
+{
+    Fib *f = arg;
+
+    if (f->n < 2)
+    {
+        f->result = f->n;
+        return;
+    }
+
+    Fib a = { f->pool, f->n - 1, 0 };
+    Fib b = { f->pool, f->n - 2, 0 };
+    TaskGroup group = TASK_GROUP_INIT;
+
+    task_pool_spawn(f->pool, &group, fib, &a);
+    fib(&b);
+    task_pool_sync(f->pool, &group);
+
+    f->result = a.result + b.result;
+}
+
+static void test_fork_join(void **state)
+{
+    TaskPool *pool = task_pool_new(4);
+    assert_int_equal(4, task_pool_workers(pool));
+
+    Fib f = { pool, 24, 0 };
+    TaskGroup group = TASK_GROUP_INIT;
+    task_pool_spawn(pool, &group, fib, &f);
+    task_pool_sync(pool, &group);
+    assert_int_equal(46368, f.result);
+
+    // again from the calling thread directly
+    f.n = 20;
+    fib(&f);
+    assert_int_equal(6765, f.result);
+
+    task_pool_destroy(pool);
+}
+
+static void increment(void *arg)
+{
+    __atomic_add_fetch((long *)arg, 1, __ATOMIC_RELAXED);
+}
+
+static void test_many_external_spawns(void **state)
+{
+    TaskPool *pool = task_pool_new(3);
+    long counter = 0;
+    TaskGroup group = TASK_GROUP_INIT;
+
+    // more than fit in the injection queue, the rest run inline
+    for (int i = 0; i < 20000; i++)
+    {
+        task_pool_spawn(pool, &group, increment, &counter);
+    }
+    task_pool_sync(pool, &group);
+    assert_int_equal(20000, counter);
+
+    task_pool_destroy(pool);
+}
+
+typedef struct
+{
+    TaskPool *pool;
+    long counter;
+} Shared;
+
+static void *external_thread(void *arg)
+{
+    Shared *shared = arg;
+    TaskGroup group = TASK_GROUP_INIT;
+
+    for (int i = 0; i < 1000; i++)
+    {
+        task_pool_spawn(shared->pool, &group, increment, &shared->counter);
+    }
+    task_pool_sync(shared->pool, &group);
+    return NULL;
+}
+
+static void test_concurrent_groups(void **state)
+{
+    Shared shared = { task_pool_new(2), 0 };
+    pthread_t threads[4];
+
+    for (int i = 0; i < 4; i++)
+    {
+        pthread_create(&threads[i], NULL, external_thread, &shared);
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    assert_int_equal(4000, shared.counter);
+
+    task_pool_destroy(shared.pool);
+}
+
+static void test_destroy_drains(void **state)
+{
+    TaskPool *pool = task_pool_new(1);
+    long counter = 0;
+    TaskGroup group = TASK_GROUP_INIT;
+
+    for (int i = 0; i < 100; i++)
+    {
+        task_pool_spawn(pool, &group, increment, &counter);
+    }
+    task_pool_destroy(pool);
+
+    assert_int_equal(100, counter);
+    assert_int_equal(0, group.pending);
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_fork_join),
+        unit_test(test_many_external_spawns),
+        unit_test(test_concurrent_groups),
+        unit_test(test_destroy_drains)
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,113 @@
+#include "typed-rb-tree.h"
+
+#include "rb-tree.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define INT_CMP(a, b) (((a) > (b)) - ((a) < (b)))
+
+LU_RBTREE_DEFINE(IntMap, int64_t, int64_t, INT_CMP)
+
+// named like the locals the macro used to declare
+static int cmp(int a, int b)
+{
+    return INT_CMP(a, b);
+}
+
+LU_RBTREE_DEFINE(CmpMap, int, int, cmp)
+
+static void test_put_get_remove(void **state)
+{
+    IntMap *m = IntMap_new();
+
+    assert_false(IntMap_put(m, 42, 1));
+    assert_int_equal(1, *IntMap_get(m, 42));
+    assert_true(IntMap_put(m, 42, 2));
+    assert_int_equal(2, *IntMap_get(m, 42));
+    assert_int_equal(1, IntMap_size(m));
+
+    *IntMap_get(m, 42) = 3;
+    assert_int_equal(3, *IntMap_get(m, 42));
+
+    assert_true(IntMap_get(m, 41) == NULL);
+    assert_true(IntMap_remove(m, 42));
+    assert_false(IntMap_remove(m, 42));
+    assert_int_equal(0, IntMap_size(m));
+
+    IntMap_destroy(m);
+
+    CmpMap *c = CmpMap_new();
+    CmpMap_put(c, 2, 20);
+    CmpMap_put(c, 1, 10);
+    assert_int_equal(10, *CmpMap_get(c, 1));
+    assert_true(CmpMap_remove(c, 2));
+    CmpMap_destroy(c);
+}
+
+static void test_random(void **state)
+{
+    IntMap *m = IntMap_new();
+    static int64_t present[5000];
+
+    srand(0);
+    for (int i = 0; i < 50000; i++)
+    {
+        int64_t k = rand() % 5000;
+        if (rand() % 3 == 0)
+        {
+            assert_int_equal(present[k] != 0, IntMap_remove(m, k));
+            present[k] = 0;
+        }
+        else
+        {
+            assert_int_equal(present[k] != 0, IntMap_put(m, k, i + 1));
+            present[k] = i + 1;
+        }
+    }
+
+    size_t count = 0;
+    for (int64_t k = 0; k < 5000; k++)
+    {
+        int64_t *v = IntMap_get(m, k);
+        if (present[k])
+        {
+            assert_int_equal(present[k], *v);
+            count++;
+        }
+        else
+        {
+            assert_true(v == NULL);
+        }
+    }
+    assert_int_equal(count, IntMap_size(m));
+
+    IntMapIterator it = IntMap_iterator(m);
+    int64_t k, v, last = -1;
+    size_t n = 0;
+    while (IntMap_iterator_next(&it, &k, &v))
+    {
+        assert_true(k > last);
+        assert_int_equal(present[k], v);
+        last = k;
+        n++;
+    }
+    assert_int_equal(count, n);
+
+    IntMap_destroy(m);
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_put_get_remove),
+        unit_test(test_random)
+    };
+
+    return run_tests(tests);
+}
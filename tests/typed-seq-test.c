@@ -0,0 +1,66 @@
+#include "typed-seq.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmockery.h>
+#include <stdint.h>
+
+LU_SEQ_DEFINE(U64Seq, uint64_t)
+
+typedef struct
+{
+    int x;
+    double y;
+} Point;
+
+LU_SEQ_DEFINE(PointSeq, Point)
+
+static void test_append_at(void **state)
+{
+    U64Seq *s = U64Seq_new(0);
+    for (uint64_t i = 0; i < 10000; i++)
+    {
+        U64Seq_append(s, i * i);
+    }
+
+    assert_int_equal(10000, U64Seq_length(s));
+    uint64_t sum = 0;
+    for (size_t i = 0; i < U64Seq_length(s); i++)
+    {
+        assert_int_equal(i * i, U64Seq_at(s, i));
+        sum += U64Seq_data(s)[i];
+    }
+    assert_true(sum == 333283335000ULL);
+
+    *U64Seq_at_ptr(s, 3) = 7;
+    assert_int_equal(7, U64Seq_at(s, 3));
+
+    U64Seq_destroy(s);
+}
+
+static void test_structs(void **state)
+{
+    PointSeq *s = PointSeq_new(4);
+    for (int i = 0; i < 100; i++)
+    {
+        Point p = { i, i / 2.0 };
+        PointSeq_append(s, p);
+    }
+
+    assert_int_equal(42, PointSeq_at(s, 42).x);
+    assert_true(PointSeq_at_ptr(s, 99)->y == 49.5);
+
+    PointSeq_destroy(s);
+}
+
+int main()
+{
+    const UnitTest tests[] =
+    {
+        unit_test(test_append_at),
+        unit_test(test_structs)
+    };
+
+    return run_tests(tests);
+}
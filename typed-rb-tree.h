@@ -0,0 +1,447 @@
+#ifndef LIBUTILS_TYPED_RB_TREE_H
+#define LIBUTILS_TYPED_RB_TREE_H
+
+#include "alloc.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+/*
+ * LU_RBTREE_DEFINE(Name, K, V, CMP) defines a red-black tree map Name
+ * storing keys of type K and values of type V by value. CMP(a, b) is a
+ * function or macro ordering two K like strcmp; it is expanded into the
+ * search and insertion loops, so it can be inlined. Names in scope there
+ * start with lu_, so CMP may refer to anything else.
+ *
+ * Defines Name_new, Name_destroy, Name_put, Name_get (a pointer to the
+ * stored value, or NULL), Name_remove, Name_size and a non-allocating
+ * Name_iterator / Name_iterator_next pair. Keys and values are not
+ * destroyed, so K and V should be plain value types.
+ */
+
+#define LU_RBTREE_DEFINE(Name, K, V, CMP)                                      \
+                                                                               \
+typedef struct Name##Node_ Name##Node;                                         \
+                                                                               \
+struct Name##Node_                                                             \
+{                                                                              \
+    K key;                                                                     \
+    V value;                                                                   \
+    bool red;                                                                  \
+    Name##Node *parent;                                                        \
+    Name##Node *left;                                                          \
+    Name##Node *right;                                                         \
+};                                                                             \
+                                                                               \
+typedef struct                                                                 \
+{                                                                              \
+    Name##Node root;                                                           \
+    Name##Node nil;                                                            \
+    size_t size;                                                               \
+    Allocator allocator;                                                       \
+} Name;                                                                        \
+                                                                               \
+typedef struct                                                                 \
+{                                                                              \
+    const Name *tree;                                                          \
+    const Name##Node *curr;                                                    \
+} Name##Iterator;                                                              \
+                                                                               \
+static inline Name *Name##_new(void)                                           \
+{                                                                              \
+    Allocator allocator = alloc_get_allocator();                               \
+    Name *t = alloc_calloc(&allocator, 1, sizeof(Name));                       \
+    t->allocator = allocator;                                                  \
+                                                                               \
+    t->nil.red = false;                                                        \
+    t->nil.parent = t->nil.left = t->nil.right = &t->nil;                      \
+                                                                               \
+    t->root.red = false;                                                       \
+    t->root.parent = t->root.left = t->root.right = &t->nil;                   \
+                                                                               \
+    t->size = 0;                                                               \
+                                                                               \
+    return t;                                                                  \
+}                                                                              \
+                                                                               \
+static inline void Name##_destroy_recursive(Name *tree, Name##Node *x)         \
+{                                                                              \
+    if (x != &tree->nil)                                                       \
+    {                                                                          \
+        Name##_destroy_recursive(tree, x->left);                               \
+        Name##_destroy_recursive(tree, x->right);                              \
+        alloc_free(&tree->allocator, x);                                       \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static inline void Name##_destroy(Name *tree)                                  \
+{                                                                              \
+    if (tree)                                                                  \
+    {                                                                          \
+        Name##_destroy_recursive(tree, tree->root.left);                       \
+        Allocator allocator = tree->allocator;                                 \
+        alloc_free(&allocator, tree);                                          \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static inline size_t Name##_size(const Name *tree)                             \
+{                                                                              \
+    return tree->size;                                                         \
+}                                                                              \
+                                                                               \
+static inline void Name##_rotate_left(Name *tree, Name##Node *x)               \
+{                                                                              \
+    Name##Node *y = x->right;                                                  \
+    x->right = y->left;                                                        \
+                                                                               \
+    if (y->left != &tree->nil)                                                 \
+    {                                                                          \
+        y->left->parent = x;                                                   \
+    }                                                                          \
+                                                                               \
+    y->parent = x->parent;                                                     \
+                                                                               \
+    if (x == x->parent->left)                                                  \
+    {                                                                          \
+        x->parent->left = y;                                                   \
+    }                                                                          \
+    else                                                                       \
+    {                                                                          \
+        x->parent->right = y;                                                  \
+    }                                                                          \
+                                                                               \
+    y->left = x;                                                               \
+    x->parent = y;                                                             \
+}                                                                              \
+                                                                               \
+static inline void Name##_rotate_right(Name *tree, Name##Node *y)              \
+{                                                                              \
+    Name##Node *x = y->left;                                                   \
+    y->left = x->right;                                                        \
+                                                                               \
+    if (x->right != &tree->nil)                                                \
+    {                                                                          \
+        x->right->parent = y;                                                  \
+    }                                                                          \
+                                                                               \
+    x->parent = y->parent;                                                     \
+                                                                               \
+    if (y == y->parent->left)                                                  \
+    {                                                                          \
+        y->parent->left = x;                                                   \
+    }                                                                          \
+    else                                                                       \
+    {                                                                          \
+        y->parent->right = x;                                                  \
+    }                                                                          \
+                                                                               \
+    x->right = y;                                                              \
+    y->parent = x;                                                             \
+}                                                                              \
+                                                                               \
+static inline void Name##_put_fix(Name *tree, Name##Node *z)                   \
+{                                                                              \
+    while (z->parent->red)                                                     \
+    {                                                                          \
+        if (z->parent == z->parent->parent->left)                              \
+        {                                                                      \
+            Name##Node *y = z->parent->parent->right;                          \
+            if (y->red)                                                        \
+            {                                                                  \
+                z->parent->red = false;                                        \
+                y->red = false;                                                \
+                z->parent->parent->red = true;                                 \
+                z = z->parent->parent;                                         \
+            }                                                                  \
+            else                                                               \
+            {                                                                  \
+                if (z == z->parent->right)                                     \
+                {                                                              \
+                    z = z->parent;                                             \
+                    Name##_rotate_left(tree, z);                               \
+                }                                                              \
+                                                                               \
+                z->parent->red = false;                                        \
+                z->parent->parent->red = true;                                 \
+                Name##_rotate_right(tree, z->parent->parent);                  \
+            }                                                                  \
+        }                                                                      \
+        else                                                                   \
+        {                                                                      \
+            Name##Node *y = z->parent->parent->left;                           \
+            if (y->red)                                                        \
+            {                                                                  \
+                z->parent->red = false;                                        \
+                y->red = false;                                                \
+                z->parent->parent->red = true;                                 \
+                z = z->parent->parent;                                         \
+            }                                                                  \
+            else                                                               \
+            {                                                                  \
+                if (z == z->parent->left)                                      \
+                {                                                              \
+                    z = z->parent;                                             \
+                    Name##_rotate_right(tree, z);                              \
+                }                                                              \
+                                                                               \
+                z->parent->red = false;                                        \
+                z->parent->parent->red = true;                                 \
+                Name##_rotate_left(tree, z->parent->parent);                   \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    tree->root.left->red = false;                                              \
+}                                                                              \
+                                                                               \
+static inline bool Name##_put(Name *lu_tree_, K lu_key_, V lu_value_)          \
+{                                                                              \
+    Name##Node *lu_y_ = &lu_tree_->root;                                       \
+    Name##Node *lu_x_ = lu_tree_->root.left;                                   \
+    int lu_cmp_ = 0;                                                           \
+                                                                               \
+    while (lu_x_ != &lu_tree_->nil)                                            \
+    {                                                                          \
+        lu_y_ = lu_x_;                                                         \
+        lu_cmp_ = CMP(lu_key_, lu_x_->key);                                    \
+        if (lu_cmp_ == 0)                                                      \
+        {                                                                      \
+            lu_x_->value = lu_value_;                                          \
+            return true;                                                       \
+        }                                                                      \
+        lu_x_ = (lu_cmp_ < 0) ? lu_x_->left : lu_x_->right;                    \
+    }                                                                          \
+                                                                               \
+    Name##Node *lu_z_ = alloc_malloc(&lu_tree_->allocator,                     \
+                                     sizeof(Name##Node));                      \
+    lu_z_->key = lu_key_;                                                      \
+    lu_z_->value = lu_value_;                                                  \
+    lu_z_->red = true;                                                         \
+    lu_z_->parent = lu_y_;                                                     \
+    lu_z_->left = lu_z_->right = &lu_tree_->nil;                               \
+                                                                               \
+    if (lu_y_ == &lu_tree_->root || lu_cmp_ < 0)                               \
+    {                                                                          \
+        lu_y_->left = lu_z_;                                                   \
+    }                                                                          \
+    else                                                                       \
+    {                                                                          \
+        lu_y_->right = lu_z_;                                                  \
+    }                                                                          \
+                                                                               \
+    Name##_put_fix(lu_tree_, lu_z_);                                           \
+    lu_tree_->size++;                                                          \
+                                                                               \
+    return false;                                                              \
+}                                                                              \
+                                                                               \
+static inline Name##Node *Name##_node_get(const Name *lu_tree_, K lu_key_)     \
+{                                                                              \
+    Name##Node *lu_curr_ = lu_tree_->root.left;                                \
+                                                                               \
+    while (lu_curr_ != &lu_tree_->nil)                                         \
+    {                                                                          \
+        int lu_cmp_ = CMP(lu_key_, lu_curr_->key);                             \
+        if (lu_cmp_ == 0)                                                      \
+        {                                                                      \
+            return lu_curr_;                                                   \
+        }                                                                      \
+        lu_curr_ = (lu_cmp_ < 0) ? lu_curr_->left : lu_curr_->right;           \
+    }                                                                          \
+                                                                               \
+    return NULL;                                                               \
+}                                                                              \
+                                                                               \
+static inline V *Name##_get(const Name *lu_tree_, K lu_key_)                   \
+{                                                                              \
+    Name##Node *lu_node_ = Name##_node_get(lu_tree_, lu_key_);                 \
+    return lu_node_ ? &lu_node_->value : NULL;                                 \
+}                                                                              \
+                                                                               \
+static inline const Name##Node *Name##_node_next(const Name *tree, const Name##Node *node) \
+{                                                                              \
+    if (node->right != &tree->nil)                                             \
+    {                                                                          \
+        const Name##Node *curr;                                                \
+        for (curr = node->right; curr->left != &tree->nil; curr = curr->left); \
+        return curr;                                                           \
+    }                                                                          \
+    else                                                                       \
+    {                                                                          \
+        const Name##Node *curr;                                                \
+        for (curr = node->parent; node == curr->right; node = curr, curr = curr->parent); \
+        return (curr != &tree->root) ? curr : &tree->nil;                      \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static inline void Name##_remove_fix(Name *tree, Name##Node *x)                \
+{                                                                              \
+    Name##Node *root = tree->root.left;                                        \
+    Name##Node *w;                                                             \
+                                                                               \
+    while (x != root && !x->red)                                               \
+    {                                                                          \
+        if (x == x->parent->left)                                              \
+        {                                                                      \
+            w = x->parent->right;                                              \
+            if (w->red)                                                        \
+            {                                                                  \
+                w->red = false;                                                \
+                x->parent->red = true;                                         \
+                Name##_rotate_left(tree, x->parent);                           \
+                w = x->parent->right;                                          \
+            }                                                                  \
+                                                                               \
+            if (!w->left->red && !w->right->red)                               \
+            {                                                                  \
+                w->red = true;                                                 \
+                x = x->parent;                                                 \
+            }                                                                  \
+            else                                                               \
+            {                                                                  \
+                if (!w->right->red)                                            \
+                {                                                              \
+                    w->left->red = false;                                      \
+                    w->red = true;                                             \
+                    Name##_rotate_right(tree, w);                              \
+                    w = x->parent->right;                                      \
+                }                                                              \
+                w->red = x->parent->red;                                       \
+                x->parent->red = false;                                        \
+                w->right->red = false;                                         \
+                Name##_rotate_left(tree, x->parent);                           \
+                x = root;                                                      \
+            }                                                                  \
+        }                                                                      \
+        else                                                                   \
+        {                                                                      \
+            w = x->parent->left;                                               \
+            if (w->red)                                                        \
+            {                                                                  \
+                w->red = false;                                                \
+                x->parent->red = true;                                         \
+                Name##_rotate_right(tree, x->parent);                          \
+                w = x->parent->left;                                           \
+            }                                                                  \
+                                                                               \
+            if (!w->left->red && !w->right->red)                               \
+            {                                                                  \
+                w->red = true;                                                 \
+                x = x->parent;                                                 \
+            }                                                                  \
+            else                                                               \
+            {                                                                  \
+                if (!w->left->red)                                             \
+                {                                                              \
+                    w->right->red = false;                                     \
+                    w->red = true;                                             \
+                    Name##_rotate_left(tree, w);                               \
+                    w = x->parent->left;                                       \
+                }                                                              \
+                                                                               \
+                w->red = x->parent->red;                                       \
+                x->parent->red = false;                                        \
+                w->left->red = false;                                          \
+                Name##_rotate_right(tree, x->parent);                          \
+                x = root;                                                      \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    x->red = false;                                                            \
+}                                                                              \
+                                                                               \
+static inline bool Name##_remove(Name *tree, K key)                            \
+{                                                                              \
+    Name##Node *z = Name##_node_get(tree, key);                                \
+    if (!z)                                                                    \
+    {                                                                          \
+        return false;                                                          \
+    }                                                                          \
+                                                                               \
+    Name##Node *y = ((z->left == &tree->nil) || (z->right == &tree->nil))      \
+        ? z : (Name##Node *)Name##_node_next(tree, z);                         \
+    Name##Node *x = (y->left == &tree->nil) ? y->right : y->left;              \
+                                                                               \
+    x->parent = y->parent;                                                     \
+    if (&tree->root == x->parent)                                              \
+    {                                                                          \
+        tree->root.left = x;                                                   \
+    }                                                                          \
+    else if (y == y->parent->left)                                             \
+    {                                                                          \
+        y->parent->left = x;                                                   \
+    }                                                                          \
+    else                                                                       \
+    {                                                                          \
+        y->parent->right = x;                                                  \
+    }                                                                          \
+                                                                               \
+    if (!y->red)                                                               \
+    {                                                                          \
+        Name##_remove_fix(tree, x);                                            \
+    }                                                                          \
+                                                                               \
+    if (z != y)                                                                \
+    {                                                                          \
+        y->left = z->left;                                                     \
+        y->right = z->right;                                                   \
+        y->parent = z->parent;                                                 \
+        y->red = z->red;                                                       \
+        z->left->parent = y;                                                   \
+        z->right->parent = y;                                                  \
+                                                                               \
+        if (z == z->parent->left)                                              \
+        {                                                                      \
+            z->parent->left = y;                                               \
+        }                                                                      \
+        else                                                                   \
+        {                                                                      \
+            z->parent->right = y;                                              \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    alloc_free(&tree->allocator, z);                                           \
+    tree->nil.red = false;                                                     \
+    tree->nil.parent = &tree->nil;                                             \
+    tree->size--;                                                              \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline Name##Iterator Name##_iterator(const Name *tree)                 \
+{                                                                              \
+    Name##Iterator iter;                                                       \
+    const Name##Node *curr = tree->root.left;                                  \
+                                                                               \
+    if (curr != &tree->nil)                                                    \
+    {                                                                          \
+        for (; curr->left != &tree->nil; curr = curr->left);                   \
+    }                                                                          \
+                                                                               \
+    iter.tree = tree;                                                          \
+    iter.curr = curr;                                                          \
+    return iter;                                                               \
+}                                                                              \
+                                                                               \
+static inline bool Name##_iterator_next(Name##Iterator *iter, K *key, V *value) \
+{                                                                              \
+    if (iter->curr == &iter->tree->nil)                                        \
+    {                                                                          \
+        return false;                                                          \
+    }                                                                          \
+                                                                               \
+    if (key)                                                                   \
+    {                                                                          \
+        *key = iter->curr->key;                                                \
+    }                                                                          \
+    if (value)                                                                 \
+    {                                                                          \
+        *value = iter->curr->value;                                            \
+    }                                                                          \
+                                                                               \
+    iter->curr = Name##_node_next(iter->tree, iter->curr);                     \
+    return true;                                                               \
+}
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef LIBUTILS_TYPED_SEQ_H
+#define LIBUTILS_TYPED_SEQ_H
+
+#include "alloc.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*
+ * LU_SEQ_DEFINE(Name, T) defines a Seq storing elements of type T by
+ * value, with functions Name_new, Name_destroy, Name_length, Name_at,
+ * Name_at_ptr, Name_data and Name_append. Elements are not destroyed, so
+ * T should be a plain value type.
+ */
+
+#define LU_SEQ_DEFINE(Name, T)                                          \
+                                                                        \
+typedef struct                                                          \
+{                                                                       \
+    T *data;                                                            \
+    size_t length;                                                      \
+    size_t capacity;                                                    \
+    Allocator allocator;                                                \
+} Name;                                                                 \
+                                                                        \
+static inline Name *Name##_new(size_t initial_capacity)                 \
+{                                                                       \
+    Allocator allocator = alloc_get_allocator();                        \
+    Name *seq = alloc_malloc(&allocator, sizeof(Name));                 \
+    seq->allocator = allocator;                                         \
+                                                                        \
+    seq->capacity = initial_capacity ? initial_capacity : 1;            \
+    seq->length = 0;                                                    \
+    seq->data = alloc_malloc(&allocator, sizeof(T) * seq->capacity);    \
+                                                                        \
+    return seq;                                                         \
+}                                                                       \
+                                                                        \
+static inline void Name##_destroy(Name *seq)                            \
+{                                                                       \
+    if (seq)                                                            \
+    {                                                                   \
+        Allocator allocator = seq->allocator;                           \
+        alloc_free(&allocator, seq->data);                              \
+        alloc_free(&allocator, seq);                                    \
+    }                                                                   \
+}                                                                       \
+                                                                        \
+static inline size_t Name##_length(const Name *seq)                     \
+{                                                                       \
+    return seq->length;                                                 \
+}                                                                       \
+                                                                        \
+static inline T Name##_at(const Name *seq, size_t index)                \
+{                                                                       \
+    assert(index < seq->length);                                        \
+    return seq->data[index];                                            \
+}                                                                       \
+                                                                        \
+static inline T *Name##_at_ptr(Name *seq, size_t index)                 \
+{                                                                       \
+    assert(index < seq->length);                                        \
+    return &seq->data[index];                                           \
+}                                                                       \
+                                                                        \
+static inline T *Name##_data(Name *seq)                                 \
+{                                                                       \
+    return seq->data;                                                   \
+}                                                                       \
+                                                                        \
+static inline void Name##_append(Name *seq, T item)                     \
+{                                                                       \
+    if (seq->length == seq->capacity)                                   \
+    {                                                                   \
+        seq->capacity *= 2;                                             \
+        seq->data = alloc_realloc(&seq->allocator, seq->data,           \
+                                  sizeof(T) * seq->capacity);           \
+    }                                                                   \
+                                                                        \
+    seq->data[seq->length++] = item;                                    \
+}
+
+#endif